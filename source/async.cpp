@@ -0,0 +1,113 @@
+#include "async.h"
+#include <QVariant>
+
+namespace Async {
+
+/*######## Scope ########*/
+struct Scope::Root
+{/* The detached frame spawn() creates around a Task. It starts suspended so it can be registered first,
+    and at the end it unregisters and frees itself. */
+    struct promise_type
+    {
+        Scope *scope = nullptr;
+
+        Root get_return_object() noexcept { return Root{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept
+        {
+            struct Final {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    h.promise().scope->m_roots.erase(h.address());
+                    h.destroy();
+                }
+                void await_resume() noexcept {}
+            };
+            return Final{};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+Scope::Root Scope::run(Scope *, Task<void> task)
+{
+    co_await task;
+}
+
+void Scope::spawn(Task<void> task)
+{
+    const Root root = run(this, std::move(task));
+    root.handle.promise().scope = this;
+    m_roots.insert(root.handle.address());
+    root.handle.resume();
+}
+
+void Scope::cancel()
+{/* Destroying a root destroys the Task it awaits and so on down the chain; each suspended awaiter
+    cleans up in its destructor */
+    const std::unordered_set<void *> roots = std::exchange(m_roots, {});
+    for (void *frame : roots)
+        std::coroutine_handle<>::from_address(frame).destroy();
+}
+
+/*######## ReplyAwaiter ########*/
+ReplyAwaiter::ReplyAwaiter(ReplyAwaiter &&o) noexcept
+    : m_reply(o.m_reply), m_timeoutMs(o.m_timeoutMs)
+{
+    o.m_reply = nullptr;
+}
+
+ReplyAwaiter::~ReplyAwaiter()
+{
+    disconnectAll();
+    if (!m_reply) return;
+    if (!m_reply->isFinished()) m_reply->abort();   // the awaiting flow was cancelled
+    m_reply->deleteLater();
+}
+
+void ReplyAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    m_finished = QObject::connect(m_reply.data(), &QNetworkReply::finished, m_reply.data(), [this, h]() {
+        disconnectAll();
+        h.resume();
+    });
+    if (m_timeoutMs > 0)
+        m_timer = detail::startTimer(m_timeoutMs, [this]() {
+            m_timedOut = true;
+            if (m_reply) m_reply->abort();   // emits finished, which resumes
+        });
+}
+
+HttpResult ReplyAwaiter::await_resume()
+{
+    HttpResult r;
+    if (!m_reply) {
+        r.error = QNetworkReply::OperationCanceledError;
+        r.errorString = QStringLiteral("reply deleted");
+        return r;
+    }
+    r.error       = m_reply->error();
+    r.timedOut    = m_timedOut;
+    r.status      = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    r.errorString = m_timedOut ? QStringLiteral("timed out after %1 ms").arg(m_timeoutMs) : m_reply->errorString();
+    r.body        = m_reply->readAll();
+    return r;
+}
+
+void ReplyAwaiter::disconnectAll()
+{
+    QObject::disconnect(m_finished);
+    if (m_timer) m_timer->stop();
+}
+
+/*######## SleepAwaiter ########*/
+void SleepAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    m_timer = detail::startTimer(m_ms, [h]() { h.resume(); });
+}
+
+} // namespace Async
@@ -0,0 +1,259 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QByteArray>
+#include <QString>
+#include <QNetworkReply>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+/* A small coroutine layer over the Qt event loop, for flows that used to be chains of slots and reply
+   lambdas (session, Socket.IO handshake, uploads). Everything runs on the thread of the event loop that
+   delivers the awaited signals; a coroutine resumes right inside the signal emission, like a slot would.
+
+     Async::Task<T>   lazily started coroutine, co_await it from another Task to run it
+     Async::Scope     owns detached root tasks; cancel() (and its destructor) destroys the suspended ones,
+                      which disconnects whatever they wait on and aborts their network replies
+     co_await Async::reply(reply, ms)           a QNetworkReply, aborted after ms
+     co_await Async::signal(obj, &C::sig, ms)   the next emission of a signal, nullopt on timeout
+     co_await Async::sleep(ms)
+
+   There are no exceptions in this tree, so a coroutine that throws terminates. */
+namespace Async {
+
+template <typename T> class Task;
+
+namespace detail {
+struct DeleteLater
+{/* Timers are stopped and released from inside their own timeout emission, so never delete them there */
+    void operator()(QObject *o) const { o->deleteLater(); }
+};
+using TimerPtr = std::unique_ptr<QTimer, DeleteLater>;
+
+template <typename F>
+TimerPtr startTimer(int ms, F &&onTimeout)
+{
+    TimerPtr timer(new QTimer);
+    timer->setSingleShot(true);
+    QObject::connect(timer.get(), &QTimer::timeout, std::forward<F>(onTimeout));
+    timer->start(ms);
+    return timer;
+}
+
+struct FinalAwaiter
+{/* Symmetric transfer back to whoever awaited the task, so long chains do not grow the stack */
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+    {
+        const std::coroutine_handle<> next = h.promise().continuation;
+        return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase
+{
+    std::optional<T> value;
+    Task<T> get_return_object() noexcept;
+    template <typename U> void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+    void take() noexcept {}
+};
+}
+
+template <typename T = void>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle h) : m_h(h) {}
+    Task(Task &&o) noexcept : m_h(std::exchange(o.m_h, {})) {}
+    Task &operator=(Task &&o) noexcept
+    {
+        if (this != &o) { reset(); m_h = std::exchange(o.m_h, {}); }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() { reset(); }
+
+    bool await_ready() const noexcept { return !m_h || m_h.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        m_h.promise().continuation = awaiter;
+        return m_h;
+    }
+    T await_resume() { return m_h.promise().take(); }
+
+private:
+    void reset() { if (m_h) { m_h.destroy(); m_h = {}; } }
+    Handle m_h;
+};
+
+namespace detail {
+template <typename T>
+Task<T> Promise<T>::get_return_object() noexcept { return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this)); }
+inline Task<void> Promise<void>::get_return_object() noexcept { return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this)); }
+}
+
+class Scope
+{/* Owner of fire-and-forget flows. Declare it as the last member of the object whose members the flows
+    use: it is then destroyed first, while everything the suspended flows refer to still exists.
+    cancel() must not be called from inside one of its own flows. */
+public:
+    Scope() = default;
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    ~Scope() { cancel(); }
+
+    void spawn(Task<void> task);   // starts it right away, up to its first suspension
+    void cancel();
+    int running() const { return int(m_roots.size()); }
+
+private:
+    struct Root;
+    static Root run(Scope *scope, Task<void> task);
+    std::unordered_set<void *> m_roots;   // frame addresses of the suspended roots
+};
+
+/*######## Awaitables ########*/
+struct HttpResult
+{
+    QNetworkReply::NetworkError error = QNetworkReply::NoError;
+    bool       timedOut = false;
+    int        status = 0;          // HTTP status code, 0 when there was no response
+    QString    errorString;
+    QByteArray body;
+
+    bool ok() const { return error == QNetworkReply::NoError && !timedOut; }
+};
+
+class ReplyAwaiter
+{/* Takes ownership of the reply (deleteLater once finished). The timeout aborts it. If the awaiting
+    coroutine is destroyed first, the reply is aborted and nothing is resumed. */
+public:
+    ReplyAwaiter(QNetworkReply *reply, int timeoutMs) : m_reply(reply), m_timeoutMs(timeoutMs) {}
+    ReplyAwaiter(ReplyAwaiter &&o) noexcept;
+    ~ReplyAwaiter();
+
+    bool await_ready() const noexcept { return !m_reply || m_reply->isFinished(); }
+    void await_suspend(std::coroutine_handle<> h);
+    HttpResult await_resume();
+
+private:
+    void disconnectAll();
+
+    QPointer<QNetworkReply> m_reply;
+    int  m_timeoutMs;
+    bool m_timedOut = false;
+    detail::TimerPtr m_timer;
+    QMetaObject::Connection m_finished;
+};
+
+inline ReplyAwaiter reply(QNetworkReply *reply, int timeoutMs = 0) { return ReplyAwaiter(reply, timeoutMs); }
+
+class SleepAwaiter
+{
+public:
+    explicit SleepAwaiter(int ms) : m_ms(ms) {}
+    ~SleepAwaiter() { if (m_timer) m_timer->stop(); }   // a cancelled flow: the frame goes, the timer must not fire
+    bool await_ready() const noexcept { return m_ms <= 0; }
+    void await_suspend(std::coroutine_handle<> h);
+    void await_resume() noexcept {}
+
+private:
+    int m_ms;
+    detail::TimerPtr m_timer;
+};
+
+inline SleepAwaiter sleep(int ms) { return SleepAwaiter(ms); }
+
+template <typename Sender, typename... Args>
+class SignalAwaiter
+{/* Resumes on the next emission with a copy of its arguments, or with nullopt when the timeout
+    (0 = none) expires or the sender is destroyed first. */
+public:
+    using Result = std::optional<std::tuple<std::decay_t<Args>...>>;
+
+    SignalAwaiter(Sender *sender, void (Sender::*signal)(Args...), int timeoutMs)
+        : m_sender(sender), m_signal(signal), m_timeoutMs(timeoutMs) {}
+    SignalAwaiter(SignalAwaiter &&o) noexcept
+        : m_sender(o.m_sender), m_signal(o.m_signal), m_timeoutMs(o.m_timeoutMs) {}
+    ~SignalAwaiter() { disconnectAll(); }
+
+    bool await_ready() const noexcept { return !m_sender; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        m_fired = QObject::connect(m_sender.data(), m_signal, m_sender.data(), [this, h](Args... args) {
+            m_result.emplace(args...);
+            disconnectAll();
+            h.resume();
+        }, Qt::DirectConnection);
+        m_gone = QObject::connect(m_sender.data(), &QObject::destroyed, [this, h]() {
+            disconnectAll();
+            h.resume();
+        });
+        if (m_timeoutMs > 0)
+            m_timer = detail::startTimer(m_timeoutMs, [this, h]() {
+                disconnectAll();
+                h.resume();
+            });
+    }
+    Result await_resume() { return std::move(m_result); }
+
+private:
+    void disconnectAll()
+    {
+        QObject::disconnect(m_fired);
+        QObject::disconnect(m_gone);
+        if (m_timer) m_timer->stop();
+    }
+
+    QPointer<Sender> m_sender;
+    void (Sender::*m_signal)(Args...);
+    int m_timeoutMs;
+    Result m_result;
+    detail::TimerPtr m_timer;
+    QMetaObject::Connection m_fired;
+    QMetaObject::Connection m_gone;
+};
+
+template <typename Sender, typename Base, typename... Args>
+SignalAwaiter<Base, Args...> signal(Sender *sender, void (Base::*sig)(Args...), int timeoutMs = 0)
+{
+    return SignalAwaiter<Base, Args...>(sender, sig, timeoutMs);
+}
+
+} // namespace Async
+
+#endif // ASYNC_H
@@ -0,0 +1,123 @@
+#include "alloccounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local std::uint64_t t_allocs = 0;   // trivially constructed, safe to touch from inside malloc
+
+#if defined(__GLIBC__)
+constexpr bool kMallocCounted = true;      // operator new below goes through the counting malloc
+#else
+constexpr bool kMallocCounted = false;
+#endif
+
+void *allocate(std::size_t size)
+{
+    if (size == 0) size = 1;
+    for (;;) {
+        if (void *p = std::malloc(size)) {
+            if (!kMallocCounted) ++t_allocs;
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *allocateAligned(std::size_t size, std::align_val_t align)
+{
+    const std::size_t a = std::size_t(align);
+    size = (size + a - 1) / a * a;   // aligned_alloc wants a multiple of the alignment
+    if (size == 0) size = a;
+    for (;;) {
+        if (void *p = std::aligned_alloc(a, size)) {
+            if (!kMallocCounted) ++t_allocs;
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+}
+
+#if defined(__GLIBC__)
+/* Qt's containers and strings (QArrayData::allocate) call malloc/realloc directly, from libQt6Core.so,
+   which -Wl,--wrap would not reach. Defining the allocator in the executable does: the dynamic linker
+   binds every malloc of the process to the first definition, this one, and glibc exports the real
+   allocator as __libc_*. */
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+void *__libc_memalign(std::size_t align, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    void *p = __libc_malloc(size);
+    if (p) ++t_allocs;
+    return p;
+}
+
+void *calloc(std::size_t n, std::size_t size)
+{
+    void *p = __libc_calloc(n, size);
+    if (p) ++t_allocs;
+    return p;
+}
+
+void *realloc(void *old, std::size_t size)
+{// growing in place still counts: the caller asked the heap, which is what a hot path must not do
+    void *p = __libc_realloc(old, size);
+    if (p) ++t_allocs;
+    return p;
+}
+
+void *aligned_alloc(std::size_t align, std::size_t size)
+{
+    void *p = __libc_memalign(align, size);
+    if (p) ++t_allocs;
+    return p;
+}
+}
+#endif
+
+std::uint64_t AllocCounter::thisThread()
+{
+    return t_allocs;
+}
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void *operator new(std::size_t size, std::align_val_t align) { return allocateAligned(size, align); }
+void *operator new[](std::size_t size, std::align_val_t align) { return allocateAligned(size, align); }
+void *operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    try { return allocateAligned(size, align); } catch (...) { return nullptr; }
+}
+void *operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    try { return allocateAligned(size, align); } catch (...) { return nullptr; }
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
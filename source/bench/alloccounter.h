@@ -0,0 +1,16 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <cstdint>
+
+/* Heap allocation counter for the benchmarks: alloccounter.cpp replaces the global operator new/delete of
+   QtAlp_bench (and only there) and, on glibc, malloc/calloc/realloc/aligned_alloc too, so the buffers Qt
+   allocates itself are seen. Every successful allocation bumps a counter of the allocating thread.
+   Measure a steady state by taking thisThread() before and after, warm up first so that buffers, hash
+   buckets and caches have grown to size. */
+namespace AllocCounter
+{
+std::uint64_t thisThread();   // allocations made by the calling thread so far
+}
+
+#endif // ALLOCCOUNTER_H
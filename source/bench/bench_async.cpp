@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+#include "async.h"
+#include <QWebSocket>
+#include <functional>
+#include <memory>
+
+/*######## Coroutine layer overhead ########*/
+/* What the ERP link and upload flows pay for being coroutines (async.h) instead of slots and reply lambdas:
+   one wait on a signal (a Socket.IO frame during the handshake), and one call into a sub-flow that finishes
+   without suspending (openSession's result, postLogBody refusing a busy slot). */
+namespace {
+const QString kFrame = QStringLiteral("42[\"m\",{\"f\":\"send_logs\"}]");
+
+Async::Task<> frameLoop(QWebSocket *socket, long *seen, int timeoutMs)
+{
+    for (;;) {
+        const auto msg = co_await Async::signal(socket, &QWebSocket::textMessageReceived, timeoutMs);
+        if (!msg) co_return;
+        *seen += std::get<0>(*msg).size();
+    }
+}
+
+Async::Task<int> addOne(int v)
+{
+    co_return v + 1;
+}
+
+Async::Task<> callLoop(benchmark::State &state)
+{
+    int v = 0;
+    for (auto _ : state) {
+        v = co_await addOne(v);
+        benchmark::DoNotOptimize(v);
+    }
+}
+}
+
+static void BM_AsyncSignalSlot(benchmark::State &state)
+{/* Lower bound: a connection made once, like onSocketTextMessageReceived */
+    QWebSocket socket;
+    long seen = 0;
+    QObject::connect(&socket, &QWebSocket::textMessageReceived, &socket, [&seen](const QString &m) { seen += m.size(); });
+    for (auto _ : state)
+        emit socket.textMessageReceived(kFrame);
+    benchmark::DoNotOptimize(seen);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncSignalSlot);
+
+static void BM_AsyncSignalCallback(benchmark::State &state)
+{/* The callback version of one wait: connect for a single answer and disconnect inside it */
+    QWebSocket socket;
+    long seen = 0;
+    for (auto _ : state) {
+        auto conn = std::make_shared<QMetaObject::Connection>();
+        *conn = QObject::connect(&socket, &QWebSocket::textMessageReceived, &socket, [&seen, conn](const QString &m) {
+            seen += m.size();
+            QObject::disconnect(*conn);
+        });
+        emit socket.textMessageReceived(kFrame);
+    }
+    benchmark::DoNotOptimize(seen);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncSignalCallback);
+
+static void BM_AsyncSignalCoroutine(benchmark::State &state)
+{/* co_await Async::signal per frame; range(0) is the timeout, each wait with one arms its own QTimer */
+    QWebSocket socket;
+    long seen = 0;
+    Async::Scope scope;
+    scope.spawn(frameLoop(&socket, &seen, int(state.range(0))));
+    for (auto _ : state)
+        emit socket.textMessageReceived(kFrame);
+    scope.cancel();
+    benchmark::DoNotOptimize(seen);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncSignalCoroutine)->Arg(0)->Arg(10000);
+
+static void BM_AsyncCallCallback(benchmark::State &state)
+{
+    const std::function<void(int, const std::function<void(int)> &)> addOneCb = [](int v, const std::function<void(int)> &done) {
+        done(v + 1);
+    };
+    int v = 0;
+    for (auto _ : state) {
+        addOneCb(v, [&v](int r) { v = r; });
+        benchmark::DoNotOptimize(v);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncCallCallback);
+
+static void BM_AsyncCallTask(benchmark::State &state)
+{/* co_await of a Task that completes at once: one frame allocation and two symmetric transfers */
+    Async::Scope scope;
+    scope.spawn(callLoop(state));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncCallTask);
@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+#include "heartbeat.h"
+#include <QJsonObject>
+#include <random>
+
+/*######## Adaptive heartbeat ########*/
+static void BM_HeartbeatAdapt(benchmark::State &state)
+{/* Two simulated hours against the default [heartbeat] settings: the first on a steady 40 ms link, the
+    second per range(0): 0 the same, 1 jittery (40 + 0..600 ms), 2 no pongs for 2 minutes then steady again.
+    pings_h1/pings_h2 compare with the 720 per hour of the old fixed 5 s ping; detect_ms is how long after
+    the change the link was seen as degraded or lost. Time per iteration is the estimator's own cost. */
+    const int regime = int(state.range(0));
+    constexpr qint64 kHourUs = 3600LL * 1000000;
+    constexpr qint64 kOutageUs = 120LL * 1000000;
+    const HeartbeatConfig cfg;
+    double pingsH1 = 0, pingsH2 = 0, detectMs = -1, endInterval = 0;
+    for (auto _ : state) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> wobble(-2000, 2000), jitter(0, 600000);
+        Heartbeat hb(cfg);
+        hb.reset();
+        qint64 t = 0, detectedUs = -1;
+        long pings[2] = { 0, 0 };
+        while (t < 2 * kHourUs) {
+            const bool second = t >= kHourUs;
+            if (hb.expire(t) > 0 && second && detectedUs < 0) detectedUs = t - kHourUs;
+            benchmark::DoNotOptimize(hb.ping(t));
+            ++pings[second ? 1 : 0];
+            qint64 next = t + qint64(qMin(hb.intervalMs(), cfg.timeoutMs)) * 1000;   // as DvClient arms it
+            const bool lost = regime == 2 && second && t < kHourUs + kOutageUs;
+            if (!lost) {
+                const qint64 rtt = 40000 + (second && regime == 1 ? jitter(rng) : wobble(rng));
+                hb.pong(QJsonObject(), t + rtt);
+                next = t + qint64(hb.intervalMs()) * 1000;
+                if (second && detectedUs < 0 && hb.degraded()) detectedUs = t + rtt - kHourUs;
+            }
+            t = next;
+        }
+        pingsH1 = double(pings[0]);
+        pingsH2 = double(pings[1]);
+        detectMs = detectedUs < 0 ? -1 : double(detectedUs) / 1000.0;
+        endInterval = hb.intervalMs();
+    }
+    static const char *const kLabels[] = { "steady", "jitter", "outage" };
+    state.SetLabel(kLabels[regime]);
+    state.counters["pings_h1"] = pingsH1;
+    state.counters["pings_h2"] = pingsH2;
+    state.counters["detect_ms"] = detectMs;
+    state.counters["end_interval_ms"] = endInterval;
+}
+BENCHMARK(BM_HeartbeatAdapt)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,26 @@
+#include <benchmark/benchmark.h>
+#ifdef QTALP_BENCH_UI
+#include <QApplication>
+#else
+#include <QCoreApplication>
+#endif
+
+/* Benchmarks need an application object for the SQL driver and, with the UI built, the OpenGL widget;
+   default to the offscreen platform so the binary runs on headless gateways and CI runners. */
+int main(int argc, char *argv[])
+{
+#ifdef QTALP_BENCH_UI
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+#else
+    QCoreApplication app(argc, argv);
+#endif
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <benchmark/benchmark.h>
+#include "frameparser.h"
+#include "warningclassifier.h"
+#include "socketioframe.h"
+#include "warningdetector.h"
+#include "warningstore.h"
+#include "samplesource.h"
+#include "alloccounter.h"
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QVector>
+
+/*######## Framing ########*/
+static QByteArray makeSerialChunk(int lines)
+{
+    QByteArray chunk;
+    QRandomGenerator rng(42);
+    for (int i = 0; i < lines; ++i)
+        chunk += QByteArray::number(rng.generateDouble() * 190.0 + 10.0, 'f', 2) + "\r\n";
+    return chunk;
+}
+
+static void BM_FrameParser(benchmark::State &state)
+{/* One waitForReadyRead() worth of bytes per iteration, lines per chunk is the argument */
+    const QByteArray chunk = makeSerialChunk(int(state.range(0)));
+    FrameParser parser;
+    float sink = 0;
+    for (auto _ : state) {
+        parser.feed(chunk, [&sink](int, float v){ sink += v; }, [](const QByteArray &){});
+        benchmark::DoNotOptimize(sink);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * chunk.size());
+}
+BENCHMARK(BM_FrameParser)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_FrameParserSplitLines(benchmark::State &state)
+{/* Worst case for the carry-over buffer: every line arrives in two halves */
+    const QByteArray chunk = makeSerialChunk(64);
+    const QByteArray a = chunk.left(chunk.size() / 2 + 3);
+    const QByteArray b = chunk.mid(a.size());
+    FrameParser parser;
+    float sink = 0;
+    for (auto _ : state) {
+        parser.feed(a, [&sink](int, float v){ sink += v; }, [](const QByteArray &){});
+        parser.feed(b, [&sink](int, float v){ sink += v; }, [](const QByteArray &){});
+        benchmark::DoNotOptimize(sink);
+    }
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_FrameParserSplitLines);
+
+static void BM_FrameParserChannels(benchmark::State &state)
+{/* 256 values per chunk from range(0) sensors on one port: tagged text lines with one "ch:value" per sensor
+    (range(1) = 0) or binary frames (range(1) = 1). Bytes/s should not move with the channel count. */
+    const int channels = int(state.range(0));
+    const bool binary = state.range(1) != 0;
+    QRandomGenerator rng(42);
+    QByteArray chunk;
+    for (int i = 0; i < 256; i += channels) {
+        for (int ch = 0; ch < channels; ++ch) {
+            const float v = float(rng.generateDouble() * 190.0 + 10.0);
+            if (binary) chunk += FrameParser::binaryFrame(ch, v);
+            else        chunk += (ch ? "," : "") + QByteArray::number(ch) + ':' + QByteArray::number(v, 'f', 2);
+        }
+        if (!binary) chunk += "\r\n";
+    }
+    FrameParser parser(binary ? FrameParser::Framing::Binary : FrameParser::Framing::Text);
+    float sink[FrameParser::kMaxChannels] = {};
+    long errors = 0;
+    for (auto _ : state) {
+        parser.feed(chunk, [&sink](int ch, float v){ sink[ch] += v; }, [&errors](const QByteArray &){ ++errors; });
+        benchmark::DoNotOptimize(sink);
+    }
+    if (errors) state.SkipWithError("parse errors");
+    state.SetLabel(binary ? "binary" : "text");
+    state.SetItemsProcessed(state.iterations() * 256);
+    state.SetBytesProcessed(state.iterations() * chunk.size());
+}
+BENCHMARK(BM_FrameParserChannels)->ArgsProduct({ { 1, 4, 8, 64 }, { 0, 1 } });
+
+/*######## Classification ########*/
+static void BM_Classify(benchmark::State &state)
+{
+    QVector<double> distances(1024);
+    QRandomGenerator rng(7);
+    for (double &d : distances) d = rng.generateDouble() * 190.0 + 10.0;
+    int i = 0;
+    for (auto _ : state) {
+        const double xn = WarningClassifier::xn(distances[i++ & 1023]);
+        QString level = WarningClassifier::level(xn);
+        benchmark::DoNotOptimize(level);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Classify);
+
+static QVector<float> noisyBoundary(int n)
+{/* A target parked right on the WARNING-2/3 edge (Xn = 2.1 near 1 m) with noise of +-0.1 Xn, the case
+    that used to flap. Xn = (70 * d + 3) mod 4, so that is +-1.5 um of distance. */
+    const double edge = (2.1 - 3.0 + 4.0 * 1750) / 70.0;
+    QVector<float> v(n);
+    QRandomGenerator rng(7);
+    for (int i = 0; i < n; ++i)
+        v[i] = float(edge + (rng.generateDouble() * 2.0 - 1.0) * 0.0015);
+    return v;
+}
+
+static void BM_DetectorFeed(benchmark::State &state)
+{/* Cost per sample of the detector in the sample path (classify, debounce, rate limit) */
+    const QVector<float> distances = noisyBoundary(1024);
+    const QString sensor = QStringLiteral("COM3");
+    WarningDetector det;
+    WarningDetector::Event ev;
+    qint64 ms = 0;
+    int i = 0;
+    for (auto _ : state) {
+        const bool row = det.feed(sensor, ms += 10, distances[i++ & 1023], ev);
+        benchmark::DoNotOptimize(row);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DetectorFeed);
+
+static void BM_DetectorRowsPer100k(benchmark::State &state)
+{/* 100k samples at 100 Hz (~17 min) on the noisy edge; rows = what reaches the DB.
+    range(0) = debounce samples, range(1) = hysteresis in 1/100 Xn; 1/0 is the undamped classifier. */
+    const QVector<float> distances = noisyBoundary(100000);
+    DetectorConfig cfg;
+    cfg.debounceSamples = int(state.range(0));
+    cfg.hysteresis      = double(state.range(1)) / 100.0;
+    quint64 rows = 0, transitions = 0;
+    for (auto _ : state) {
+        WarningDetector det(cfg);
+        WarningDetector::Event ev;
+        rows = transitions = 0;
+        for (int i = 0; i < distances.size(); ++i)
+            if (det.feed(QStringLiteral("COM3"), qint64(i) * 10, distances[i], ev)) {
+                ++rows;
+                if (ev.transition) ++transitions;
+            }
+    }
+    state.counters["rows"] = double(rows);
+    state.counters["transitions"] = double(transitions);
+    state.SetItemsProcessed(state.iterations() * distances.size());
+}
+BENCHMARK(BM_DetectorRowsPer100k)->Args({1, 0})->Args({3, 0})->Args({3, 5})->Unit(benchmark::kMillisecond);
+
+/*######## Allocations ########*/
+static void BM_HotPathAllocations(benchmark::State &state)
+{/* The steady state of a serial port: a chunk of 16 lines parsed into the reused batch, through the ingest
+    queue into the reused drain buffer (ComThread::processBuffer, ComPortManager::drain), then the detector
+    and the row DvClient::detect would build. The distance holds its level and reemit is off, so no row is
+    due and nothing may reach the heap; the run fails otherwise. */
+    const QByteArray chunk = QByteArray("123.45\r\n").repeated(16);
+    FrameParser parser;
+    SampleQueue queue(QStringLiteral("bench_hotpath"), QueueConfig{ 4096, QueuePolicy::DropOldest }, false);
+    QVector<SourceSample> batch, drained;
+    DetectorConfig cfg;
+    cfg.reemitMs = 0;
+    WarningDetector det(cfg);
+    WarningDetector::Event ev;
+    QVector<WarningRow> rows;
+    const QString sensor = QStringLiteral("ttyUSB0");
+    qint64 ms = 0;
+    auto pass = [&]() {
+        batch.resize(0);
+        const qint64 tsUs = sampleClockUs();
+        parser.feed(chunk, [&batch, tsUs](int channel, float v){ batch.append({ v, channel, tsUs }); }, [](const QByteArray &){});
+        bool wake = false, more = false;
+        queue.push(batch.constData(), int(batch.size()), &wake);
+        drained.resize(0);
+        queue.take(drained, 1024, &more);
+        for (const SourceSample &s : std::as_const(drained)) {
+            if (!det.feed(sensor, ms += 10, s.distance, ev)) continue;
+            WarningRow row;
+            row.xn        = ev.xn;
+            row.level     = WarningClassifier::levelName(ev.level);
+            row.distance  = ev.distance;
+            row.sensor    = sensor;
+            row.timestamp = WarningStore::tsFromMSecs(ms);
+            rows.append(row);
+        }
+    };
+    for (int i = 0; i < 1000; ++i) pass();   // buffers, hash buckets and the first level row
+    rows.clear();
+    const std::uint64_t before = AllocCounter::thisThread();
+    for (auto _ : state) {
+        pass();
+        benchmark::DoNotOptimize(drained.constData());
+    }
+    const double perSample = double(AllocCounter::thisThread() - before) / double(state.iterations() * 16);
+    state.counters["allocs_per_sample"] = perSample;
+    if (perSample > 0) state.SkipWithError("heap allocation in the steady-state sample path");
+    state.SetItemsProcessed(state.iterations() * 16);
+}
+BENCHMARK(BM_HotPathAllocations);
+
+static void BM_EventAllocations(benchmark::State &state)
+{/* What turning a detector event into a row costs on the heap, reported rather than asserted: the level
+    is interned and the sensor name shared, the timestamp string is made once per second and shared by
+    the rows within it. Events at 100 Hz, so about 0.01 per row. */
+    const QString sensor = QStringLiteral("ttyUSB0");
+    QVector<WarningRow> rows;
+    qint64 ms = 1700000000000;
+    std::uint64_t allocs = 0;
+    for (auto _ : state) {
+        const std::uint64_t before = AllocCounter::thisThread();
+        WarningRow row;
+        row.xn        = 2.5;
+        row.level     = WarningClassifier::levelName(3);
+        row.distance  = 123.45;
+        row.sensor    = sensor;
+        row.timestamp = WarningStore::tsFromMSecs(ms += 10);
+        rows.append(row);
+        allocs += AllocCounter::thisThread() - before;
+        if (rows.size() == 1024) rows.resize(0);
+    }
+    state.counters["allocs_per_row"] = double(allocs) / double(state.iterations());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EventAllocations);
+
+/*######## Socket.IO ########*/
+static void BM_SocketIoParsePong(benchmark::State &state)
+{
+    const QString msg = QStringLiteral("42[\"pong\",{}]");
+    for (auto _ : state) {
+        SocketIoFrame f = SocketIoFrame::parse(msg);
+        benchmark::DoNotOptimize(f);
+    }
+}
+BENCHMARK(BM_SocketIoParsePong);
+
+static void BM_SocketIoParseCommand(benchmark::State &state)
+{/* "m" event with the command JSON nested as text, parsed twice like the real handler does */
+    const QString msg = QStringLiteral("42[\"m\",{\"t\":\"{\\\"f\\\":\\\"send_msg_log\\\",\\\"msg\\\":\\\"hello from ERP\\\"}\"}]");
+    for (auto _ : state) {
+        SocketIoFrame f = SocketIoFrame::parse(msg);
+        QString cmd = f.command();
+        benchmark::DoNotOptimize(cmd);
+    }
+}
+BENCHMARK(BM_SocketIoParseCommand);
@@ -0,0 +1,149 @@
+#include <benchmark/benchmark.h>
+#include "ptyloopback.h"
+#include "comthread.h"
+#include "sourcedrain.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+
+/*######## ComThread over a pseudo-terminal ########*/
+/* End to end through QSerialPort, the same code path as a real adapter, without one.
+   All hooks are direct connections, so no event loop is needed and the timings are the thread's own. */
+namespace {
+constexpr qint64 kTimeoutNs = 5LL * 1000 * 1000 * 1000;
+
+struct PtyRig
+{
+    PtyLoopback pty;
+    ComThread  *thread = nullptr;
+    std::atomic<int>  opened{0};
+    std::atomic<long> received{0};
+
+    bool start()
+    {
+        if (!pty.open()) return false;
+        thread = new ComThread(pty.slaveName());
+        QObject::connect(thread, &SampleSource::portOpened, thread, [this](const QString &){ opened.fetch_add(1); }, Qt::DirectConnection);
+        drainInline(thread, &received);
+        thread->start();
+        return true;
+    }
+
+    ~PtyRig()
+    {
+        if (thread) { thread->stop(); thread->wait(); delete thread; }
+    }
+};
+
+template <typename Pred>
+bool spinUntil(Pred done)
+{/* Busy wait with a yield, the latencies measured here are far below a sleep quantum */
+    QElapsedTimer t;
+    t.start();
+    while (!done()) {
+        if (t.nsecsElapsed() > kTimeoutNs) return false;
+        QThread::yieldCurrentThread();
+    }
+    return true;
+}
+}
+
+static void BM_PtyParseThroughput(benchmark::State &state)
+{/* Lines per second from master write to samplesReady, written in 4 KiB chunks */
+    PtyRig rig;
+    if (!rig.start() || !spinUntil([&]{ return rig.opened.load() > 0; })) {
+        state.SkipWithError("pty or QSerialPort open failed");
+        return;
+    }
+    const int lines = int(state.range(0));
+    QByteArray stream;
+    for (int i = 0; i < lines; ++i)
+        stream += QByteArray::number(10.0 + (i % 19000) / 100.0, 'f', 2) + "\r\n";
+
+    for (auto _ : state) {
+        const long target = rig.received.load() + lines;
+        for (qsizetype off = 0; off < stream.size(); off += 4096)
+            rig.pty.write(stream.mid(off, 4096));
+        if (!spinUntil([&]{ return rig.received.load() >= target; })) {
+            state.SkipWithError("lines lost");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * lines);
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+BENCHMARK(BM_PtyParseThroughput)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+static void BM_PtyLatency(benchmark::State &state)
+{/* One line at a time, write() to samplesReady: pty hop + poll wakeup inside waitForReadyRead + framing */
+    PtyRig rig;
+    if (!rig.start() || !spinUntil([&]{ return rig.opened.load() > 0; })) {
+        state.SkipWithError("pty or QSerialPort open failed");
+        return;
+    }
+    const QByteArray line("123.45\r\n");
+    QElapsedTimer t;
+    for (auto _ : state) {
+        const long target = rig.received.load() + 1;
+        t.start();
+        rig.pty.write(line);
+        if (!spinUntil([&]{ return rig.received.load() >= target; })) {
+            state.SkipWithError("line lost");
+            return;
+        }
+        state.SetIterationTime(double(t.nsecsElapsed()) / 1e9);
+    }
+}
+BENCHMARK(BM_PtyLatency)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+static void BM_PtyUnplugDetect(benchmark::State &state)
+{/* Master closed (cable pulled) until the ComThread has noticed through errorOccurred and finished */
+    for (auto _ : state) {
+        PtyRig rig;
+        if (!rig.start() || !spinUntil([&]{ return rig.opened.load() > 0; })) {
+            state.SkipWithError("pty or QSerialPort open failed");
+            return;
+        }
+        QElapsedTimer t;
+        t.start();
+        rig.pty.closeMaster();
+        if (!spinUntil([&]{ return rig.thread->isFinished(); })) {
+            state.SkipWithError("unplug not detected");
+            return;
+        }
+        state.SetIterationTime(double(t.nsecsElapsed()) / 1e9);
+    }
+}
+BENCHMARK(BM_PtyUnplugDetect)->UseManualTime()->Unit(benchmark::kMillisecond)->Iterations(20);
+
+static void BM_PtyReconnect(benchmark::State &state)
+{/* After an unplug: new ComThread on the re-appeared port until its first reading, i.e. open + termios setup
+    + first frame. The "sensor" keeps writing a line every 200 µs, as a real one would after power-up. */
+    for (auto _ : state) {
+        PtyLoopback pty;
+        if (!pty.open()) {
+            state.SkipWithError("openpty failed");
+            return;
+        }
+        std::atomic<long> received{0};
+        ComThread thread(pty.slaveName());
+        drainInline(&thread, &received);
+
+        QElapsedTimer t;
+        t.start();
+        thread.start();
+        while (received.load() == 0 && t.nsecsElapsed() < kTimeoutNs) {
+            pty.write("55.00\r\n");
+            QThread::usleep(200);
+        }
+        const qint64 ns = t.nsecsElapsed();
+        thread.stop();
+        thread.wait();
+        if (received.load() == 0) {
+            state.SkipWithError("no reading after reconnect");
+            return;
+        }
+        state.SetIterationTime(double(ns) / 1e9);
+    }
+}
+BENCHMARK(BM_PtyReconnect)->UseManualTime()->Unit(benchmark::kMillisecond)->Iterations(20);
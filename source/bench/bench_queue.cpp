@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+#include "boundedqueue.h"
+#include <QVector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*######## Bounded stage queues ########*/
+static void BM_QueuePushTake(benchmark::State &state)
+{/* Cost per sample of the ingest hand-off with nothing full: one push of a parsed chunk, one take */
+    BoundedQueue<float> queue(QStringLiteral("bench"), QueueConfig());
+    const QVector<float> chunk(int(state.range(0)), 105.0f);
+    QVector<float> out;
+    out.reserve(chunk.size());
+    bool flag = false;
+    for (auto _ : state) {
+        queue.push(chunk.constData(), int(chunk.size()), &flag);
+        out.resize(0);
+        queue.take(out, int(chunk.size()), &flag);
+        benchmark::DoNotOptimize(out.constData());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QueuePushTake)->Arg(1)->Arg(64);
+
+static void BM_QueueStalledConsumer(benchmark::State &state)
+{/* A 1 M sample burst into a 65536 slot queue whose consumer only manages 4096 samples per 10 ms and
+    stops completely for 200 ms (an upload or DB reset on the GUI thread). range(0) is the policy.
+    dropped + delivered = 1 M for the dropping policies; Block delivers everything and the producer
+    time shows how long the source was held back. */
+    constexpr int kBurst = 1000000;
+    constexpr int kChunk = 64;
+    const QueuePolicy policy = QueuePolicy(state.range(0));
+    double producerMs = 0, delivered = 0, dropped = 0;
+    for (auto _ : state) {
+        BoundedQueue<float> queue(QStringLiteral("bench"), QueueConfig{ 65536, policy });
+        std::atomic<bool> done{false};
+        long taken = 0;
+        std::thread consumer([&]() {
+            QVector<float> out;
+            bool more = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            while (!done.load() || more) {
+                out.resize(0);
+                taken += queue.take(out, 4096, &more);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+        const QVector<float> chunk(kChunk, 105.0f);
+        long lost = 0;
+        bool wake = false;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int n = 0; n < kBurst; n += kChunk)
+            lost += queue.push(chunk.constData(), kChunk, &wake);
+        producerMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        done = true;
+        consumer.join();
+        delivered = double(taken);
+        dropped = double(lost);
+    }
+    state.SetLabel(QueueConfig::policyName(policy).toStdString());
+    state.counters["producer_ms"] = producerMs;
+    state.counters["delivered"] = delivered;
+    state.counters["dropped"] = dropped;
+}
+BENCHMARK(BM_QueueStalledConsumer)
+    ->Arg(int(QueuePolicy::Block))->Arg(int(QueuePolicy::DropOldest))
+    ->Arg(int(QueuePolicy::DropNewest))->Arg(int(QueuePolicy::Decimate))
+    ->Unit(benchmark::kMillisecond)->Iterations(1)->UseRealTime();
@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+#include "capturefile.h"
+#include "replaysource.h"
+#include "sourcedrain.h"
+#include <QTemporaryDir>
+#include <QRandomGenerator>
+
+/*######## Capture replay ########*/
+static QString writeCapture(const QString &dir, int chunks, int linesPerChunk)
+{/* 10 ms between chunks, like a 100 Hz sensor read in one waitForReadyRead() each */
+    const QString path = dir + "/bench.qacap";
+    CaptureWriter w;
+    w.open(path, QStringLiteral("BENCH0"));
+    QRandomGenerator rng(42);
+    for (int c = 0; c < chunks; ++c) {
+        QByteArray chunk;
+        for (int i = 0; i < linesPerChunk; ++i)
+            chunk += QByteArray::number(rng.generateDouble() * 190.0 + 10.0, 'f', 2) + "\r\n";
+        w.write(qint64(c) * 10000, chunk);
+    }
+    w.close();
+    return path;
+}
+
+static void BM_ReplayAsFastAsPossible(benchmark::State &state)
+{/* Whole source thread: file read + varint decode + framing + signal emit, no pacing */
+    QTemporaryDir dir;
+    const QString path = writeCapture(dir.path(), 10000, int(state.range(0)));
+    quint64 samples = 0;
+    for (auto _ : state) {
+        ReplaySource source(path, 0.0);
+        drainInline(&source);   // the replay queue blocks, something has to take the samples
+        source.start();
+        source.wait();
+        samples += source.samplesEmitted();
+    }
+    state.SetItemsProcessed(qint64(samples));
+}
+BENCHMARK(BM_ReplayAsFastAsPossible)->Arg(1)->Arg(16)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include "benchdb.h"
+#include "warningscan.h"
+#include <QElapsedTimer>
+#include <map>
+#include <memory>
+
+/*######## Parallel history scan ########*/
+/* HistoryStats over a whole stored history, once as the single loop on the store's connection that every
+   analysis used to be (scanRange), and once through WarningScan with 1..N pool threads. range(0) is the
+   row count; the database is built once per size and shared by every case (WAL, no rollups). */
+namespace {
+WarningStore &historyDb(qint64 rows)
+{
+    static std::map<qint64, std::unique_ptr<BenchDb>> dbs;
+    std::unique_ptr<BenchDb> &db = dbs[rows];
+    if (!db) db = benchDb(QStringLiteral("bench_scan_%1").arg(rows), rows, 5, 7);
+    return *db->store;
+}
+}
+
+static void BM_HistoryScanSerial(benchmark::State &state)
+{
+    WarningStore &store = historyDb(state.range(0));
+    double secs = 0;
+    for (auto _ : state) {
+        QElapsedTimer timer;
+        timer.start();
+        HistoryStats stats;
+        store.scanRange(QString(), QString(), [&stats](const WarningRow &row) { stats.add(row); });
+        secs += double(timer.nsecsElapsed()) / 1e9;
+        benchmark::DoNotOptimize(stats.rows);
+    }
+    baselineSeconds("scan_serial", state.range(0)) = secs / double(state.iterations());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HistoryScanSerial)->Arg(1000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_HistoryScan(benchmark::State &state)
+{/* range(1) pool threads; speedup is against BM_HistoryScanSerial of the same size when that ran first */
+    WarningStore &store = historyDb(state.range(0));
+    WarningScan scan(store, int(state.range(1)));
+    double secs = 0;
+    int ranges = 0;
+    for (auto _ : state) {
+        QElapsedTimer timer;
+        timer.start();
+        const ScanResult<HistoryStats> r = scan.stats(WarningFilter());
+        secs += double(timer.nsecsElapsed()) / 1e9;
+        if (!r.ok() || r.value.rows != state.range(0)) state.SkipWithError("scan incomplete");
+        ranges = r.ranges;
+    }
+    const double serial = baselineSeconds("scan_serial", state.range(0));
+    state.counters["ranges"] = ranges;
+    state.counters["speedup"] = serial > 0 ? serial / (secs / double(state.iterations())) : 0.0;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HistoryScan)->ArgsProduct({ { 1000000 }, { 1, 2, 4 } })->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+#include "ptyloopback.h"
+#include "comthread.h"
+#include "threadscheduling.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+/*######## Acquisition jitter under load ########*/
+/* A 1 kHz "sensor" writes one line per period into a pty, ComThread reads it, and the inter-arrival times
+   at samplesReady are collected. Jitter is |inter-arrival - 1 ms|. The synthetic load is twice as many
+   threads as cores, each serializing a warnings-sized JSON array in a loop (what send_logs does). */
+namespace {
+constexpr int kPeriodUs = 1000;
+constexpr int kSamples  = 2000;
+
+qint64 monoNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void jsonLoad(std::atomic<bool> &stop)
+{
+    QJsonArray rows;
+    for (int i = 0; i < 2000; ++i)
+        rows.append(QJsonObject{ { "timestamp", "2025-08-19T12:00:00ZZ" }, { "level", "WARNING-3" },
+                                 { "distance", 105.25 + i }, { "xn", 2.5 } });
+    while (!stop.load(std::memory_order_relaxed))
+        benchmark::DoNotOptimize(QJsonDocument(rows).toJson(QJsonDocument::Compact).size());
+}
+
+double quantile(std::vector<double> &v, double q)
+{
+    if (v.empty()) return 0;
+    const size_t k = std::min(v.size() - 1, size_t(q * double(v.size())));
+    std::nth_element(v.begin(), v.begin() + qptrdiff(k), v.end());
+    return v[k];
+}
+}
+
+static void BM_AcquisitionJitter(benchmark::State &state)
+{/* range(0): [sched] profile on (fifo/10 on the last core, falling back to nice -10 without permission)
+    or off; range(1): synthetic load on or off. The label shows what the acquisition thread really got. */
+    const bool profile = state.range(0) != 0;
+    const bool load    = state.range(1) != 0;
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (profile) {
+        SchedProfile p;
+        p.policy   = SchedProfile::Policy::Fifo;
+        p.priority = 10;
+        p.nice     = -10;
+        p.cpus     = { cores - 1 };
+        ThreadScheduling::setProfile(ThreadScheduling::Stage::Acquisition, p);
+    } else {
+        ThreadScheduling::setEnabled(false);
+    }
+
+    for (auto _ : state) {
+        PtyLoopback pty;
+        if (!pty.open()) {
+            state.SkipWithError("openpty failed");
+            return;
+        }
+        std::vector<qint64> arrivals;
+        arrivals.reserve(kSamples + 16);
+        QMutex arrivalsMutex;
+        ComThread thread(pty.slaveName());
+        std::atomic<bool> opened{false};
+        QObject::connect(&thread, &SampleSource::portOpened, &thread, [&opened](const QString &){ opened = true; }, Qt::DirectConnection);
+        QObject::connect(&thread, &SampleSource::samplesReady, &thread, [&]() {
+            const qint64 now = monoNs();
+            QVector<SourceSample> batch;
+            bool more = false;
+            thread.queue().take(batch, std::numeric_limits<int>::max(), &more);
+            QMutexLocker lock(&arrivalsMutex);
+            for (qsizetype i = 0; i < batch.size(); ++i) arrivals.push_back(now);
+        }, Qt::DirectConnection);
+        thread.start();
+        while (!opened.load()) QThread::msleep(1);
+
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> loaders;
+        if (load)
+            for (int i = 0; i < 2 * cores; ++i) loaders.emplace_back(jsonLoad, std::ref(stop));
+
+        // The sensor side never runs late in reality, so it gets the same profile as the reader
+        std::thread sensor([&]() {
+            ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Acquisition);
+            timespec next;
+            clock_gettime(CLOCK_MONOTONIC, &next);
+            for (int n = 0; n < kSamples; ++n) {
+                next.tv_nsec += kPeriodUs * 1000;
+                if (next.tv_nsec >= 1000000000) { next.tv_nsec -= 1000000000; ++next.tv_sec; }
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+                pty.write("123.45\r\n");
+            }
+        });
+        sensor.join();
+        QThread::msleep(50);
+        stop = true;
+        for (std::thread &t : loaders) t.join();
+        thread.stop();
+        thread.wait();
+
+        std::vector<double> jitterUs;
+        {
+            QMutexLocker lock(&arrivalsMutex);
+            for (size_t i = 1; i < arrivals.size(); ++i)
+                jitterUs.push_back(std::abs(double(arrivals[i] - arrivals[i - 1]) / 1000.0 - kPeriodUs));
+        }
+        state.counters["samples"]     = double(arrivals.size());
+        state.counters["p50_us"]      = quantile(jitterUs, 0.50);
+        state.counters["p99_us"]      = quantile(jitterUs, 0.99);
+        state.counters["p999_us"]     = quantile(jitterUs, 0.999);
+        state.counters["max_us"]      = jitterUs.empty() ? 0 : *std::max_element(jitterUs.begin(), jitterUs.end());
+    }
+    const QString applied = ThreadScheduling::summaryLines().value(0);
+    state.SetLabel((profile ? applied : QStringLiteral("profile off")).toStdString() + (load ? ", loaded" : ", idle"));
+    ThreadScheduling::setEnabled(false);
+}
+BENCHMARK(BM_AcquisitionJitter)
+    ->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1})
+    ->Unit(benchmark::kMillisecond)->Iterations(1)->UseRealTime();
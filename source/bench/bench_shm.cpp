@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+#include "shmexport.h"
+#include "qtalp_shm.h"
+#include <QString>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*######## Shared-memory live stream ########*/
+namespace {
+const char *kShmName = "/qtalp_bench";
+
+struct ShmReader
+{/* What an outside consumer does: map read-only by name and follow the sample ring through qtalp_shm.h */
+    std::atomic<quint64> delivered{0};
+    std::atomic<quint64> lost{0};
+    std::atomic<quint64> torn{0};   // slot changed under the copy, counted within lost
+    std::thread thread;
+
+    void start(std::atomic<bool> &stop)
+    {
+        thread = std::thread([this, &stop]() {
+            const int fd = shm_open(kShmName, O_RDONLY, 0);
+            if (fd < 0) return;
+            const off_t size = lseek(fd, 0, SEEK_END);
+            void *mem = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mem == MAP_FAILED) return;
+            const auto *h = static_cast<const qtalp_shm_header *>(mem);
+            quint64 pos = qtalp_shm_sample_head(h);
+            qtalp_shm_sample s;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const quint64 head = qtalp_shm_sample_head(h);
+                if (head - pos > h->sample_slots) {
+                    lost += head - h->sample_slots - pos;
+                    pos = head - h->sample_slots;
+                }
+                if (pos == head) { sched_yield(); continue; }
+                while (pos < head) {
+                    const int rc = qtalp_shm_read_sample(h, pos, &s);
+                    if (rc == QTALP_SHM_NOT_YET) break;
+                    if (rc == QTALP_SHM_OK) ++delivered;
+                    else { ++lost; ++torn; }
+                    ++pos;
+                }
+            }
+            munmap(mem, size_t(size));
+        });
+    }
+};
+}
+
+static void BM_ShmPublish(benchmark::State &state)
+{/* Writer cost per sample, unpaced, with range(0) readers spinning on the same ring */
+    ShmExport shm;
+    if (!shm.open(QString::fromLatin1(kShmName), 65536, 1024)) {
+        state.SkipWithError("shm_open failed");
+        return;
+    }
+    const quint16 port = shm.portIndex(QStringLiteral("SIM0"));
+    std::atomic<bool> stop{false};
+    std::vector<ShmReader> readers(size_t(state.range(0)));
+    for (ShmReader &r : readers) r.start(stop);
+    qint64 ts = 0;
+    for (auto _ : state)
+        shm.publishSample(port, ts += 10, 105.0f, 0);
+    stop = true;
+    for (ShmReader &r : readers) r.thread.join();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["readers"] = double(state.range(0));
+}
+BENCHMARK(BM_ShmPublish)->Arg(0)->Arg(4)->UseRealTime();
+
+static void BM_ShmReaders100k(benchmark::State &state)
+{/* 100k samples/s for one second into the ring, range(0) concurrent readers. Every reader should get
+    every sample (lost = 0); max_publish_ns shows the writer is not held up whatever the readers do. */
+    using Clock = std::chrono::steady_clock;
+    constexpr int kRate = 100000;
+    for (auto _ : state) {
+        ShmExport shm;
+        if (!shm.open(QString::fromLatin1(kShmName), 65536, 1024)) {
+            state.SkipWithError("shm_open failed");
+            return;
+        }
+        const quint16 port = shm.portIndex(QStringLiteral("SIM0"));
+        std::atomic<bool> stop{false};
+        std::vector<ShmReader> readers(size_t(state.range(0)));
+        for (ShmReader &r : readers) r.start(stop);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));   // let them map
+
+        const Clock::time_point t0 = Clock::now();
+        qint64 maxNs = 0;
+        for (int n = 0; n < kRate; ++n) {
+            const Clock::time_point due = t0 + std::chrono::microseconds(qint64(n) * 1000000 / kRate);
+            while (Clock::now() < due) {}
+            const Clock::time_point a = Clock::now();
+            shm.publishSample(port, qint64(n) * 10, float(n % 200), 0);
+            maxNs = std::max<qint64>(maxNs, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a).count());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));   // let them drain
+        stop = true;
+        quint64 delivered = 0, lost = 0, torn = 0;
+        for (ShmReader &r : readers) {
+            r.thread.join();
+            delivered += r.delivered;
+            lost += r.lost;
+            torn += r.torn;
+        }
+        state.counters["delivered_per_reader"] = double(delivered) / double(qMax<qint64>(1, state.range(0)));
+        state.counters["lost"] = double(lost);
+        state.counters["torn"] = double(torn);
+        state.counters["max_publish_ns"] = double(maxNs);
+    }
+    state.SetItemsProcessed(state.iterations() * kRate);
+}
+BENCHMARK(BM_ShmReaders100k)->Arg(1)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->Iterations(1)->UseRealTime();
@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+#include "simulationsource.h"
+#include "sourcedrain.h"
+#include <QThread>
+
+/*######## Simulation ########*/
+static void BM_SimulatedSignal(benchmark::State &state)
+{/* Generator cost per value with every waveform feature switched on */
+    SimulationConfig cfg;
+    cfg.rateHz = 100000;
+    cfg.stepEverySec = 1.0;
+    cfg.driftPerSec = 0.5;
+    cfg.dropoutPerSec = 0.2;
+    cfg.stuckPerSec = 0.2;
+    SimulatedSignal wave(cfg, 42);
+    float v = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(wave.next(v));
+        benchmark::DoNotOptimize(v);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SimulatedSignal);
+
+static void BM_SimulationSourceUnpaced(benchmark::State &state)
+{/* Samples per second one virtual port can hand out when not paced, over 200 ms per iteration */
+    SimulationConfig cfg;
+    cfg.rateHz = 0;
+    quint64 samples = 0;
+    for (auto _ : state) {
+        SimulationSource source(cfg, 0);
+        drainInline(&source);
+        source.start();
+        QThread::msleep(200);
+        source.stop();
+        source.wait();
+        samples += source.samplesEmitted();
+    }
+    state.SetItemsProcessed(qint64(samples));
+}
+BENCHMARK(BM_SimulationSourceUnpaced)->Unit(benchmark::kMillisecond)->Iterations(5);
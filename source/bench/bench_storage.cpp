@@ -0,0 +1,276 @@
+#include <benchmark/benchmark.h>
+#include "warningstore.h"
+#include "warningclassifier.h"
+#include "dvclient.h"
+#include "coldarchive.h"
+#include "warningquery.h"
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTimeZone>
+#include <QSqlQuery>
+#include <QRandomGenerator>
+#include <memory>
+
+namespace {
+
+QString nextConnectionName()
+{
+    static int n = 0;
+    return QStringLiteral("bench_%1").arg(++n);
+}
+
+WarningRow makeRow(QRandomGenerator &rng)
+{
+    WarningRow row;
+    row.distance  = rng.generateDouble() * 190.0 + 10.0;
+    row.xn        = WarningClassifier::xn(row.distance);
+    row.level     = WarningClassifier::level(row.xn);
+    row.timestamp = QDateTime::currentDateTimeUtc().toString(Qt::ISODate) + "Z";
+    return row;
+}
+
+struct TempStore
+{/* Fresh file-backed DB per benchmark so journal mode and page cache state are comparable */
+    QTemporaryDir dir;
+    std::unique_ptr<WarningStore> store;
+
+    explicit TempStore(bool wal)
+        : store(new WarningStore(nextConnectionName()))
+    {
+        store->open(dir.filePath("warnings.db"));
+        store->setWal(wal);
+    }
+};
+
+}
+
+static void BM_InsertSingle(benchmark::State &state)
+{/* Today's path: autocommit insert per heartbeat, rollback journal */
+    TempStore t(state.range(0) != 0);
+    QRandomGenerator rng(1);
+    const WarningRow row = makeRow(rng);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(t.store->insert(row));
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(state.range(0) ? "wal" : "delete");
+}
+BENCHMARK(BM_InsertSingle)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+static void BM_InsertBatch(benchmark::State &state)
+{/* One transaction per batch, range(0) rows per batch, range(1) selects WAL */
+    TempStore t(state.range(1) != 0);
+    QRandomGenerator rng(2);
+    QVector<WarningRow> rows;
+    for (int i = 0; i < state.range(0); ++i) rows.append(makeRow(rng));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(t.store->insertBatch(rows));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(state.range(1) ? "wal" : "delete");
+}
+BENCHMARK(BM_InsertBatch)->Args({64, 0})->Args({64, 1})->Args({1024, 0})->Args({1024, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_SerializeLogs(benchmark::State &state)
+{/* uploadLogFile's JSON body for a table of range(0) rows */
+    TempStore t(true);
+    QRandomGenerator rng(3);
+    QVector<WarningRow> rows;
+    for (int i = 0; i < state.range(0); ++i) rows.append(makeRow(rng));
+    t.store->insertBatch(rows);
+
+    qint64 bytes = 0;
+    for (auto _ : state) {
+        QByteArray body = DvClient::serializeLogs(t.store->database());
+        bytes += body.size();
+        benchmark::DoNotOptimize(body);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_SerializeLogs)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/*######## History ########*/
+namespace {
+struct MonthStore
+{/* 30 days of one reading every 10 s (259200 rows), one insertBatch per day so each day is its own partition */
+    TempStore t{true};
+    qint64 fromSecs = 0, toSecs = 0;
+
+    MonthStore()
+    {
+        QRandomGenerator rng(4);
+        const QDateTime start = QDateTime::currentDateTimeUtc().addDays(-30).date().startOfDay(QTimeZone::UTC);
+        fromSecs = start.toSecsSinceEpoch();
+        toSecs = fromSecs + 30LL * 86400;
+        for (int day = 0; day < 30; ++day) {
+            QVector<WarningRow> rows;
+            rows.reserve(8640);
+            for (int i = 0; i < 8640; ++i) {
+                WarningRow row = makeRow(rng);
+                row.sensor = QStringLiteral("ttyUSB0");
+                row.timestamp = start.addSecs(qint64(day) * 86400 + qint64(i) * 10).toString(Qt::ISODate) + "Z";
+                rows.append(row);
+            }
+            t.store->insertBatch(rows);
+        }
+    }
+};
+}
+
+static void BM_HistoryRollup30Days(benchmark::State &state)
+{/* "Last 30 days" for a 1000 px wide plot through the rollups */
+    MonthStore m;
+    int resolution = 0;
+    qint64 points = 0;
+    for (auto _ : state) {
+        const QVector<RollupPoint> rows = m.t.store->history(m.fromSecs, m.toSecs, 1000, QString(), &resolution);
+        points = rows.size();
+        benchmark::DoNotOptimize(rows);
+    }
+    state.counters["points"] = double(points);
+    state.SetLabel(QStringLiteral("%1 s buckets").arg(resolution).toStdString());
+}
+BENCHMARK(BM_HistoryRollup30Days)->Unit(benchmark::kMillisecond);
+
+static void BM_HistoryRaw30Days(benchmark::State &state)
+{/* The same question answered from the raw rows with GROUP BY, for comparison */
+    MonthStore m;
+    QVariantList binds;
+    const QString source = m.t.store->rangeSource(QString(), QString(), binds);
+    qint64 points = 0;
+    for (auto _ : state) {
+        QSqlQuery q(m.t.store->database());
+        q.exec(QStringLiteral(R"(
+            SELECT MIN(distance), MAX(distance) FROM %1
+            GROUP BY CAST(strftime('%s', substr(timestamp, 1, 19)) AS INTEGER) / 3600
+        )").arg(source));
+        points = 0;
+        while (q.next()) ++points;
+    }
+    state.counters["points"] = double(points);
+}
+BENCHMARK(BM_HistoryRaw30Days)->Unit(benchmark::kMillisecond);
+
+/*######## Cold archive ########*/
+namespace {
+QVector<WarningRow> sensorLikeRows(int count)
+{/* What the heartbeat path really stores: one row per 5 s, distances that went through a float "123.45" */
+    QRandomGenerator rng(5);
+    const qint64 start = QDateTime::currentSecsSinceEpoch() - 86400;
+    QVector<WarningRow> rows;
+    rows.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        WarningRow row;
+        row.distance  = double(float(10.0 + double(rng.bounded(19000)) / 100.0));
+        row.xn        = WarningClassifier::xn(row.distance);
+        row.level     = WarningClassifier::level(row.xn);
+        row.sensor    = QStringLiteral("ttyUSB0");
+        row.timestamp = QDateTime::fromSecsSinceEpoch(start + qint64(i) * 5, QTimeZone::UTC).toString(Qt::ISODate) + "Z";
+        rows.append(row);
+    }
+    return rows;
+}
+}
+
+static void BM_ArchiveWrite(benchmark::State &state)
+{
+    const QVector<WarningRow> rows = sensorLikeRows(int(state.range(0)));
+    QTemporaryDir dir;
+    const QString file = dir.filePath("bench.qaarc");
+    for (auto _ : state)
+        benchmark::DoNotOptimize(ColdArchiveWriter::write(file, rows));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["bytes_per_row"] = double(QFileInfo(file).size()) / double(rows.size());
+}
+BENCHMARK(BM_ArchiveWrite)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_ArchiveScan(benchmark::State &state)
+{/* Full sequential scan of the archive, every row materialized as a WarningRow */
+    const QVector<WarningRow> rows = sensorLikeRows(int(state.range(0)));
+    QTemporaryDir dir;
+    const QString file = dir.filePath("bench.qaarc");
+    ColdArchiveWriter::write(file, rows);
+    ColdArchiveReader reader;
+    reader.open(file);
+    double sum = 0;
+    for (auto _ : state)
+        reader.scan(0, 0, [&sum](const WarningRow &r) { sum += r.distance; });
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ArchiveScan)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_SqliteScan(benchmark::State &state)
+{/* The same rows scanned out of their SQLite partition; db_bytes_per_row is the whole file, rollups included */
+    const QVector<WarningRow> rows = sensorLikeRows(int(state.range(0)));
+    TempStore t(false);
+    t.store->insertBatch(rows);
+    WarningPartition active;
+    active.table = t.store->activeTable();
+    double sum = 0;
+    for (auto _ : state)
+        t.store->scanPartition(active, QString(), QString(), [&sum](const WarningRow &r) { sum += r.distance; });
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["db_bytes_per_row"] = double(QFileInfo(t.store->path()).size()) / double(rows.size());
+}
+BENCHMARK(BM_SqliteScan)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/*######## Filtered queries ########*/
+static void BM_QueryLastHourLevel4(benchmark::State &state)
+{/* "WARNING-4 in the last hour" out of range(0) rows, through WarningQuery's covering index */
+    const QVector<WarningRow> rows = sensorLikeRows(int(state.range(0)));
+    TempStore t(true);
+    t.store->insertBatch(rows);
+    WarningFilter f;
+    f.fromTs = rows.at(rows.size() - 720).timestamp;
+    f.levels = { QStringLiteral("WARNING-4") };
+    const WarningQuery query(*t.store);
+    qint64 found = 0;
+    for (auto _ : state) {
+        found = 0;
+        query.stream(f, 1000, [&found](const QVector<WarningRow> &batch) { found += batch.size(); return true; });
+    }
+    state.counters["rows"] = double(found);
+}
+BENCHMARK(BM_QueryLastHourLevel4)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_QueryFullScanFilter(benchmark::State &state)
+{/* The same answer the old way: the whole "warnings" view read, filtered on the client */
+    const QVector<WarningRow> rows = sensorLikeRows(int(state.range(0)));
+    TempStore t(true);
+    t.store->insertBatch(rows);
+    const QString from = rows.at(rows.size() - 720).timestamp;
+    qint64 found = 0;
+    for (auto _ : state) {
+        found = 0;
+        QSqlQuery q(t.store->database());
+        q.setForwardOnly(true);
+        q.exec("SELECT timestamp, level, distance, xn FROM warnings");
+        while (q.next())
+            if (q.value(0).toString() >= from && q.value(1).toString() == QLatin1String("WARNING-4")) ++found;
+    }
+    state.counters["rows"] = double(found);
+}
+BENCHMARK(BM_QueryFullScanFilter)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_QueryKeysetPaging(benchmark::State &state)
+{/* Every row in pages of range(1): with keyset cursors the last page costs what the first one does */
+    const QVector<WarningRow> rows = sensorLikeRows(int(state.range(0)));
+    TempStore t(true);
+    t.store->insertBatch(rows);
+    const WarningQuery query(*t.store);
+    for (auto _ : state) {
+        QString cursor;
+        qint64 total = 0;
+        do {
+            const WarningQuery::Page p = query.page(WarningFilter(), cursor, int(state.range(1)));
+            total += p.rows.size();
+            cursor = p.next;
+        } while (!cursor.isEmpty());
+        if (total != state.range(0)) state.SkipWithError("paging lost or repeated rows");
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QueryKeysetPaging)->Args({100000, 1000})->Unit(benchmark::kMillisecond);
@@ -0,0 +1,25 @@
+#include <benchmark/benchmark.h>
+#include "scatter3dwidget.h"
+#include <QOpenGLContext>
+#include <QRandomGenerator>
+
+static void BM_ScatterPaint(benchmark::State &state)
+{/* Offscreen frame of the 3D scatter with range(0) points; grabFramebuffer() forces a full paintGL */
+    Scatter3DWidget w;
+    w.resize(640, 480);
+    QRandomGenerator rng(5);
+    for (int i = 0; i < state.range(0); ++i)
+        w.addPoint(float(rng.generateDouble() * 200.0), float(rng.generateDouble() * 4.0), float(rng.bounded(1, 5)));
+
+    w.grabFramebuffer();
+    if (!w.context() || !w.context()->isValid()) {
+        state.SkipWithError("no OpenGL context on this platform");
+        return;
+    }
+    for (auto _ : state) {
+        QImage frame = w.grabFramebuffer();
+        benchmark::DoNotOptimize(frame);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScatterPaint)->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
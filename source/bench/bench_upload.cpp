@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+#include "benchdb.h"
+#include "uploadmanifest.h"
+#include "dvclient.h"
+#include <QElapsedTimer>
+#include <memory>
+
+/*######## send_logs: whole body vs. content-addressed chunks ########*/
+/* The same 1M-row history (one row per second, day partitions, none uploaded yet) sent the way send_logs
+   always did, one body of everything, and through UploadManifest after an earlier upload was acknowledged
+   in full, with range(1) rows added since. bytes_sent/bytes_saved are the body bytes of the second case;
+   cpu_ratio is the whole body's build time over the chunk plan's, when BM_SendLogsWhole ran first. */
+namespace {
+std::unique_ptr<BenchDb> uploadDb(qint64 rows)
+{
+    static int n = 0;
+    return benchDb(QStringLiteral("bench_upload_%1").arg(++n), rows, 1, 1);
+}
+
+QVector<WarningPartition> sendLogsParts(const WarningStore &store)
+{// what sendLogs hands over
+    QVector<WarningPartition> p = store.pendingUploads();
+    p.append(store.activePartition());
+    return p;
+}
+}
+
+static void BM_SendLogsWhole(benchmark::State &state)
+{
+    const std::unique_ptr<BenchDb> db = uploadDb(state.range(0));
+    const QVector<WarningPartition> parts = sendLogsParts(*db->store);
+    double secs = 0;
+    qint64 bytes = 0;
+    for (auto _ : state) {
+        QElapsedTimer timer;
+        timer.start();
+        const QByteArray body = DvClient::serializeLogs(*db->store, parts);
+        secs += double(timer.nsecsElapsed()) / 1e9;
+        bytes = body.size();
+    }
+    baselineSeconds("send_logs_whole", state.range(0)) = secs / double(state.iterations());
+    state.counters["bytes_sent"] = double(bytes);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SendLogsWhole)->Arg(1000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_SendLogsChunked(benchmark::State &state)
+{
+    const std::unique_ptr<BenchDb> db = uploadDb(state.range(0));
+    UploadManifest manifest(*db->store);
+    for (const LogChunk &c : manifest.plan(sendLogsParts(*db->store)).chunks)   // the first upload, acknowledged in full
+        manifest.acknowledge(c);
+    db->append(state.range(1));
+    const QVector<WarningPartition> parts = sendLogsParts(*db->store);
+    double secs = 0;
+    UploadManifest::Plan plan;
+    for (auto _ : state) {
+        QElapsedTimer timer;
+        timer.start();
+        plan = manifest.plan(parts);
+        secs += double(timer.nsecsElapsed()) / 1e9;
+        if (!plan.ok) state.SkipWithError("plan failed");
+    }
+    qint64 sent = 0;
+    for (const LogChunk &c : std::as_const(plan.chunks)) sent += c.body.size();
+    const double whole = baselineSeconds("send_logs_whole", state.range(0));
+    state.counters["chunks_sent"] = double(plan.chunks.size());
+    state.counters["chunks_skipped"] = double(plan.chunksAcked);
+    state.counters["bytes_sent"] = double(sent);
+    state.counters["bytes_saved"] = double(plan.bytesAcked);
+    state.counters["rows_serialized"] = double(plan.rowsRead);
+    state.counters["cpu_ratio"] = whole > 0 ? whole / (secs / double(state.iterations())) : 0.0;
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + state.range(1)));
+}
+BENCHMARK(BM_SendLogsChunked)->Args({ 1000000, 0 })->Args({ 1000000, 1000 })->Args({ 1000000, 100000 })
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
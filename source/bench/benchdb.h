@@ -0,0 +1,66 @@
+#ifndef BENCHDB_H
+#define BENCHDB_H
+
+#include "warningstore.h"
+#include "warningclassifier.h"
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <map>
+#include <memory>
+#include <string>
+
+/* A WarningStore in a temporary directory holding the synthetic history the whole-history cases share:
+   one sensor, a row every stepSecs up to an hour ago, distances uniform over 10..200 cm and classified
+   as live rows would be. Rollups are off, the cases are about the raw rows. append() continues the
+   same history, for cases that measure what a later upload or scan adds. */
+struct BenchDb
+{
+    QTemporaryDir dir;
+    std::unique_ptr<WarningStore> store;
+    QRandomGenerator rng;
+    qint64 nextSecs = 0;
+    qint64 stepSecs = 1;
+
+    void append(qint64 rows)
+    {
+        QVector<WarningRow> batch;
+        for (qint64 i = 0; i < rows; ++i) {
+            WarningRow row;
+            row.distance  = double(float(10.0 + double(rng.bounded(19000)) / 100.0));
+            row.xn        = WarningClassifier::xn(row.distance);
+            row.level     = WarningClassifier::level(row.xn);
+            row.sensor    = QStringLiteral("ttyUSB0");
+            row.timestamp = WarningStore::tsFromMSecs(nextSecs * 1000);
+            nextSecs += stepSecs;
+            batch.append(row);
+            if (batch.size() == 100000 || i + 1 == rows) {
+                store->insertBatch(batch);
+                batch.clear();
+            }
+        }
+    }
+};
+
+inline std::unique_ptr<BenchDb> benchDb(const QString &connection, qint64 rows, qint64 stepSecs, quint32 seed)
+{
+    std::unique_ptr<BenchDb> db(new BenchDb);
+    db->rng.seed(seed);
+    db->stepSecs = stepSecs;
+    db->store.reset(new WarningStore(connection));
+    db->store->setRollupsFromInserts(false);
+    db->store->open(db->dir.filePath("warnings.db"));
+    db->nextSecs = QDateTime::currentSecsSinceEpoch() - rows * stepSecs - 3600;
+    db->append(rows);
+    return db;
+}
+
+/* Seconds per iteration of a baseline case (per case name and size), so the cases registered after it
+   can report a ratio against it; 0 when the baseline did not run, e.g. filtered out. */
+inline double &baselineSeconds(const char *name, qint64 rows)
+{
+    static std::map<std::pair<std::string, qint64>, double> secs;
+    return secs[{ name, rows }];
+}
+
+#endif // BENCHDB_H
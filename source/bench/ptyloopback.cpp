@@ -0,0 +1,46 @@
+#include "ptyloopback.h"
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+#include <cerrno>
+
+PtyLoopback::~PtyLoopback()
+{
+    closeMaster();
+    if (m_slave >= 0) ::close(m_slave);
+}
+
+bool PtyLoopback::open()
+{
+    char name[128] = {};
+    struct termios raw = {};
+    ::cfmakeraw(&raw);                 // no echo, no CR/LF translation: bytes arrive as the sensor sent them
+    ::cfsetispeed(&raw, B115200);
+    ::cfsetospeed(&raw, B115200);
+    if (::openpty(&m_master, &m_slave, name, &raw, nullptr) != 0)
+        return false;
+    m_slaveName = QString::fromLocal8Bit(name);
+    return true;
+}
+
+bool PtyLoopback::write(const QByteArray &bytes)
+{
+    const char *p = bytes.constData();
+    qsizetype left = bytes.size();
+    while (left > 0 && m_master >= 0) {
+        const ssize_t n = ::write(m_master, p, size_t(left));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return left == 0;
+}
+
+void PtyLoopback::closeMaster()
+{
+    if (m_master >= 0) ::close(m_master);
+    m_master = -1;
+}
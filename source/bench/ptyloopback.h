@@ -0,0 +1,30 @@
+#ifndef PTYLOOPBACK_H
+#define PTYLOOPBACK_H
+
+#include <QByteArray>
+#include <QString>
+
+class PtyLoopback
+{/* A pseudo-terminal pair standing in for a USB-serial adapter: ComThread opens slaveName() through
+    QSerialPort like any /dev/ttyUSB*, the benchmark plays the ESP32 by writing to the master side.
+    closeMaster() is the cable being pulled. Linux only (openpty). */
+public:
+    PtyLoopback() = default;
+    ~PtyLoopback();
+    PtyLoopback(const PtyLoopback &) = delete;
+    PtyLoopback &operator=(const PtyLoopback &) = delete;
+
+    bool open();
+    QString slaveName() const { return m_slaveName; }
+    bool isOpen() const { return m_master >= 0; }
+
+    bool write(const QByteArray &bytes);   // blocks while the reader is behind, false once closed
+    void closeMaster();
+
+private:
+    int     m_master = -1;
+    int     m_slave  = -1;   // held open so the slave keeps existing between QSerialPort opens
+    QString m_slaveName;
+};
+
+#endif // PTYLOOPBACK_H
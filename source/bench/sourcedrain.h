@@ -0,0 +1,20 @@
+#ifndef SOURCEDRAIN_H
+#define SOURCEDRAIN_H
+
+#include "samplesource.h"
+#include <atomic>
+#include <limits>
+
+/* Consumer for a SampleSource when there is no event loop: the ingest queue is drained right on the
+   source's thread, as soon as samplesReady fires. count (optional) gets the number of samples taken. */
+inline void drainInline(SampleSource *source, std::atomic<long> *count = nullptr)
+{
+    QObject::connect(source, &SampleSource::samplesReady, source, [source, count]() {
+        QVector<SourceSample> batch;
+        bool more = false;
+        source->queue().take(batch, std::numeric_limits<int>::max(), &more);
+        if (count) count->fetch_add(long(batch.size()));
+    }, Qt::DirectConnection);
+}
+
+#endif // SOURCEDRAIN_H
@@ -0,0 +1,34 @@
+#include "boundedqueue.h"
+#include <QSettings>
+#include <QDebug>
+
+QueueConfig QueueConfig::fromSettings(QSettings &cfg, const QString &stage, const QueueConfig &def)
+{
+    QueueConfig c = def;
+    c.capacity = qMax(2, cfg.value(QStringLiteral("queues/%1_capacity").arg(stage), def.capacity).toInt());
+    const QString name = cfg.value(QStringLiteral("queues/%1_policy").arg(stage), policyName(def.policy)).toString();
+    if (!parsePolicy(name, c.policy))
+        qWarning() << "Unknown queue policy" << name << "for" << stage << "- using" << policyName(def.policy);
+    return c;
+}
+
+QString QueueConfig::policyName(QueuePolicy policy)
+{
+    switch (policy) {
+    case QueuePolicy::Block:      return QStringLiteral("block");
+    case QueuePolicy::DropOldest: return QStringLiteral("drop_oldest");
+    case QueuePolicy::DropNewest: return QStringLiteral("drop_newest");
+    case QueuePolicy::Decimate:   return QStringLiteral("decimate");
+    }
+    return QString();
+}
+
+bool QueueConfig::parsePolicy(const QString &name, QueuePolicy &out)
+{
+    const QString n = name.trimmed().toLower();
+    if (n == QLatin1String("block"))       { out = QueuePolicy::Block;      return true; }
+    if (n == QLatin1String("drop_oldest")) { out = QueuePolicy::DropOldest; return true; }
+    if (n == QLatin1String("drop_newest")) { out = QueuePolicy::DropNewest; return true; }
+    if (n == QLatin1String("decimate"))    { out = QueuePolicy::Decimate;   return true; }
+    return false;
+}
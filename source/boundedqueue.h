@@ -0,0 +1,187 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+#include <utility>
+#include "metrics.h"
+
+class QSettings;
+
+/* What a stage does with an item that arrives while its queue is full */
+enum class QueuePolicy {
+    Block,        // the producer waits for room (backpressure up the chain)
+    DropOldest,   // the oldest queued item makes room
+    DropNewest,   // the arriving item is discarded
+    Decimate      // every other queued item is discarded: the backlog keeps its time span at half the rate
+};
+
+struct QueueConfig
+{/* One stage of the [queues] group of qtalp.ini: <stage>_capacity and <stage>_policy */
+    int         capacity = 65536;
+    QueuePolicy policy   = QueuePolicy::DropOldest;
+
+    static QueueConfig fromSettings(QSettings &cfg, const QString &stage, const QueueConfig &def);
+    static QString policyName(QueuePolicy policy);     // "block", "drop_oldest", "drop_newest", "decimate"
+    static bool parsePolicy(const QString &name, QueuePolicy &out);
+};
+
+template <typename T>
+class BoundedQueue
+{/* Fixed ring between two pipeline stages, any number of producers, one consumer. Drops are counted in
+    queue_<stage>_dropped_total and time spent waiting under Block in queue_<stage>_blocked_us_total,
+    so every queue of a stage adds up in the same metrics.
+
+    The consumer is woken edge-triggered: push() reports "wake" only for the first item after the queue
+    was drained, so at most one notification per queue is ever pending in an event loop. A consumer that
+    takes less than everything (take() says "more") has to come back on its own.
+
+    A queue whose consumer runs on the producer's thread must not wait (mayBlock = false): Block then
+    drops the newest like DropNewest, and full() is what the producer side uses to push back instead. */
+public:
+    BoundedQueue(const QString &stage, const QueueConfig &cfg, bool mayBlock = true)
+        : m_dropped(Metrics::counter(QStringLiteral("queue_%1_dropped_total").arg(stage), QStringLiteral("Items the %1 queue discarded").arg(stage)))
+        , m_blockedUs(Metrics::counter(QStringLiteral("queue_%1_blocked_us_total").arg(stage), QStringLiteral("Producer time waiting on a full %1 queue").arg(stage)))
+        , m_mayBlock(mayBlock)
+    {
+        setConfig(cfg);
+    }
+
+    void setConfig(const QueueConfig &cfg)
+    {// Resizing keeps the newest items that still fit
+        QMutexLocker lock(&m_mutex);
+        const int cap = qMax(2, cfg.capacity);
+        QVector<T> buf(cap);
+        const int keep = qMin(m_count, cap);
+        for (int i = 0; i < keep; ++i)
+            buf[i] = std::move(m_buf[index(m_count - keep + i)]);
+        m_dropped.inc(quint64(m_count - keep));
+        m_buf.swap(buf);
+        m_head = 0;
+        m_count = keep;
+        m_policy = cfg.policy;
+        m_notFull.wakeAll();
+    }
+
+    // Returns how many of the n items were discarded, by this push or to make room for it
+    int push(const T *items, int n, bool *wake)
+    {
+        QMutexLocker lock(&m_mutex);
+        int dropped = 0;
+        for (int i = 0; i < n; ++i) {
+            if (m_closed) { dropped += n - i; break; }
+            if (m_count == m_buf.size() && !makeRoom(lock, dropped)) continue;
+            m_buf[index(m_count)] = items[i];
+            ++m_count;
+        }
+        if (dropped) m_dropped.inc(quint64(dropped));
+        *wake = m_count > 0 && !m_signalled;
+        if (*wake) m_signalled = true;
+        return dropped;
+    }
+
+    // Appends up to max items to out, oldest first; more is true when items are left behind
+    int take(QVector<T> &out, int max, bool *more)
+    {
+        QMutexLocker lock(&m_mutex);
+        const int n = qMin(max, m_count);
+        for (int i = 0; i < n; ++i)
+            out.append(std::move(m_buf[index(i)]));
+        m_head = index(n);
+        m_count -= n;
+        *more = m_count > 0;
+        if (!*more) m_signalled = false;
+        if (n) m_notFull.wakeAll();
+        return n;
+    }
+
+    // take() in two steps, for a consumer that only lets go of the items once they are safely handled
+    int peek(QVector<T> &out, int max) const
+    {
+        QMutexLocker lock(&m_mutex);
+        const int n = qMin(max, m_count);
+        for (int i = 0; i < n; ++i)
+            out.append(m_buf[index(i)]);
+        return n;
+    }
+
+    void pop(int n)
+    {
+        QMutexLocker lock(&m_mutex);
+        n = qBound(0, n, m_count);
+        m_head = index(n);
+        m_count -= n;
+        if (m_count == 0) m_signalled = false;
+        if (n) m_notFull.wakeAll();
+    }
+
+    // Wakes a producer waiting under Block; from then on every push is dropped (the source is stopping)
+    void close()
+    {
+        QMutexLocker lock(&m_mutex);
+        m_closed = true;
+        m_notFull.wakeAll();
+    }
+
+    int size() const { QMutexLocker lock(&m_mutex); return m_count; }
+    int capacity() const { QMutexLocker lock(&m_mutex); return int(m_buf.size()); }
+    bool full() const { QMutexLocker lock(&m_mutex); return m_count >= m_buf.size(); }
+    QueuePolicy policy() const { QMutexLocker lock(&m_mutex); return m_policy; }
+
+private:
+    int index(int i) const { return (m_head + i) % int(m_buf.size()); }
+
+    // Called full, with the lock held. False when the arriving item is the one to drop.
+    bool makeRoom(QMutexLocker<QMutex> &lock, int &dropped)
+    {
+        switch (m_policy) {
+        case QueuePolicy::Block:
+            if (m_mayBlock) {
+                QElapsedTimer waited;
+                waited.start();
+                while (m_count == m_buf.size() && !m_closed)
+                    m_notFull.wait(lock.mutex());
+                m_blockedUs.inc(quint64(waited.nsecsElapsed() / 1000));
+                if (!m_closed) return true;
+            }
+            ++dropped;
+            return false;
+        case QueuePolicy::DropNewest:
+            ++dropped;
+            return false;
+        case QueuePolicy::DropOldest:
+            m_head = index(1);
+            --m_count;
+            ++dropped;
+            return true;
+        case QueuePolicy::Decimate: {
+            // keep the newer item of each pair, so the most recent value always survives
+            int kept = 0;
+            for (int i = 1; i < m_count; i += 2)
+                m_buf[index(kept++)] = std::move(m_buf[index(i)]);
+            dropped += m_count - kept;
+            m_count = kept;
+            return true;
+        }
+        }
+        return false;
+    }
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_notFull;
+    QVector<T>  m_buf;
+    int         m_head = 0;
+    int         m_count = 0;
+    QueuePolicy m_policy = QueuePolicy::DropOldest;
+    bool        m_signalled = false;   // a wake was reported and the consumer has not drained yet
+    bool        m_closed = false;
+    Counter    &m_dropped;
+    Counter    &m_blockedUs;
+    const bool  m_mayBlock;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,100 @@
+#include "capturefile.h"
+#include <QDateTime>
+#include <QtEndian>
+
+namespace {
+const char kMagic[6] = { 'Q', 'A', 'C', 'A', 'P', 0 };
+constexpr quint8 kVersion = 1;
+
+void appendVarint(QByteArray &out, quint64 v)
+{
+    while (v >= 0x80) {
+        out.append(char((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.append(char(v));
+}
+}
+
+/*######## CaptureWriter ########*/
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &path, const QString &portName)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray header(kMagic, sizeof(kMagic));
+    header.append(char(kVersion));
+    header.append(char(0));
+    char buf[8];
+    qToLittleEndian<quint64>(quint64(QDateTime::currentMSecsSinceEpoch()), buf);
+    header.append(buf, 8);
+    const QByteArray name = portName.toUtf8();
+    qToLittleEndian<quint16>(quint16(name.size()), buf);
+    header.append(buf, 2);
+    header.append(name);
+    m_file.write(header);
+    m_lastUs = 0;
+    return true;
+}
+
+void CaptureWriter::write(qint64 elapsedUs, const QByteArray &chunk)
+{
+    if (!m_file.isOpen() || chunk.isEmpty()) return;
+    m_scratch.clear();
+    appendVarint(m_scratch, quint64(qMax<qint64>(0, elapsedUs - m_lastUs)));
+    appendVarint(m_scratch, quint64(chunk.size()));
+    m_lastUs = elapsedUs;
+    m_file.write(m_scratch);
+    m_file.write(chunk);
+}
+
+void CaptureWriter::close()
+{
+    if (m_file.isOpen()) m_file.close();
+}
+
+/*######## CaptureReader ########*/
+bool CaptureReader::open(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray header = m_file.read(sizeof(kMagic) + 2 + 8 + 2);
+    if (header.size() != int(sizeof(kMagic) + 12) || !header.startsWith(QByteArray(kMagic, sizeof(kMagic)))
+        || quint8(header.at(6)) != kVersion)
+        return false;
+    m_startMsecs = qint64(qFromLittleEndian<quint64>(header.constData() + 8));
+    const quint16 nameLen = qFromLittleEndian<quint16>(header.constData() + 16);
+    m_portName = QString::fromUtf8(m_file.read(nameLen));
+    m_elapsedUs = 0;
+    return true;
+}
+
+bool CaptureReader::readVarint(quint64 &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        char c;
+        if (!m_file.getChar(&c)) return false;
+        v |= quint64(quint8(c) & 0x7f) << shift;
+        if (!(quint8(c) & 0x80)) return true;
+    }
+    return false;
+}
+
+bool CaptureReader::next(qint64 &elapsedUs, QByteArray &chunk)
+{
+    quint64 delta, len;
+    if (!readVarint(delta) || !readVarint(len)) return false;
+    chunk = m_file.read(qint64(len));
+    if (quint64(chunk.size()) != len) return false; // power cut mid-record, stop at the last whole one
+    m_elapsedUs += qint64(delta);
+    elapsedUs = m_elapsedUs;
+    return true;
+}
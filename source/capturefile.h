@@ -0,0 +1,47 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+/* Raw serial capture (.qacap), one file per port:
+     header : "QACAP" 0x00 u8 version(1) u8 reserved, u64le start time (ms since epoch),
+              u16le port name length, port name (UTF-8)
+     record : varint delta time since the previous record (µs), varint length, raw bytes
+   Varints are LEB128. A typical 0.37\n line at 10 Hz costs ~4 bytes of framing. */
+
+class CaptureWriter
+{
+public:
+    ~CaptureWriter();
+
+    bool open(const QString &path, const QString &portName);
+    void write(qint64 elapsedUs, const QByteArray &chunk);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+private:
+    QFile  m_file;
+    qint64 m_lastUs = 0;
+    QByteArray m_scratch;
+};
+
+class CaptureReader
+{
+public:
+    bool open(const QString &path);
+    bool next(qint64 &elapsedUs, QByteArray &chunk);   // false at EOF or on a torn tail
+    QString portName() const { return m_portName; }
+    qint64 startMsecs() const { return m_startMsecs; }
+
+private:
+    bool readVarint(quint64 &v);
+
+    QFile   m_file;
+    QString m_portName;
+    qint64  m_startMsecs = 0;
+    qint64  m_elapsedUs = 0;
+};
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,415 @@
+#include "coldarchive.h"
+#include "warningclassifier.h"
+#include "crc32.h"
+#include <QSaveFile>
+#include <QDateTime>
+#include <QTimeZone>
+#include <QHash>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[6] = { 'Q', 'A', 'A', 'R', 'C', 0 };
+constexpr quint8 kVersion = 1;
+constexpr int kHeaderSize = 28;
+constexpr int kIndexEntrySize = 36;
+constexpr int kBlockRows = 4096;
+constexpr quint8 kFlagXnDerived = 0x01;
+
+/*######## Bit streams, MSB first ########*/
+class BitWriter
+{
+public:
+    void put(quint64 v, int bits)
+    {
+        if (bits > 32) { put(v >> 32, bits - 32); put(v, 32); return; }
+        if (bits <= 0) return;
+        v &= (1ull << bits) - 1;
+        m_acc = (m_acc << bits) | v;
+        m_n += bits;
+        while (m_n >= 8) {
+            m_n -= 8;
+            m_out.append(char(quint8(m_acc >> m_n)));
+        }
+        m_acc &= (1ull << m_n) - 1;
+    }
+    QByteArray finish()
+    {
+        if (m_n > 0) m_out.append(char(quint8(m_acc << (8 - m_n))));
+        m_acc = 0;
+        m_n = 0;
+        return m_out;
+    }
+
+private:
+    QByteArray m_out;
+    quint64 m_acc = 0;
+    int m_n = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const char *data, qsizetype bytes) : m_p(reinterpret_cast<const quint8 *>(data)), m_bits(bytes * 8) {}
+
+    quint64 get(int bits)
+    {
+        if (bits > 32) { const quint64 hi = get(bits - 32); return (hi << 32) | get(32); }
+        quint64 v = 0;
+        while (bits > 0) {
+            if (m_pos >= m_bits) { m_overrun = true; return v << bits; }
+            const int off = int(m_pos & 7);
+            const int take = qMin(8 - off, bits);
+            const quint8 byte = m_p[m_pos >> 3];
+            v = (v << take) | ((byte >> (8 - off - take)) & ((1u << take) - 1));
+            m_pos += take;
+            bits -= take;
+        }
+        return v;
+    }
+    bool bit() { return get(1) != 0; }
+    bool overrun() const { return m_overrun; }
+
+private:
+    const quint8 *m_p;
+    qint64 m_bits;
+    qint64 m_pos = 0;
+    bool m_overrun = false;
+};
+
+quint64 zigzag(qint64 v)   { return (quint64(v) << 1) ^ quint64(v >> 63); }
+qint64  unzigzag(quint64 z) { return qint64(z >> 1) ^ -qint64(z & 1); }
+
+/*######## Timestamps: delta-of-delta ########*/
+void putTimestamps(BitWriter &w, const QVector<qint64> &ts)
+{
+    qint64 prev = 0, prevDelta = 0;
+    for (int i = 0; i < ts.size(); ++i) {
+        if (i == 0) { w.put(quint64(ts[0]), 64); prev = ts[0]; continue; }
+        const qint64 delta = ts[i] - prev;
+        const quint64 z = zigzag(delta - prevDelta);
+        if (z == 0)         { w.put(0, 1); }
+        else if (z < 128)   { w.put(0b10, 2);   w.put(z, 7); }
+        else if (z < 512)   { w.put(0b110, 3);  w.put(z, 9); }
+        else if (z < 4096)  { w.put(0b1110, 4); w.put(z, 12); }
+        else                { w.put(0b1111, 4); w.put(z, 64); }
+        prev = ts[i];
+        prevDelta = delta;
+    }
+}
+
+void getTimestamps(BitReader &r, qint64 *out, int count)
+{
+    qint64 prev = 0, prevDelta = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i == 0) { prev = out[0] = qint64(r.get(64)); continue; }
+        int ones = 0;
+        while (ones < 4 && r.bit()) ++ones;
+        static const int kWidth[] = { 0, 7, 9, 12, 64 };
+        const qint64 dod = ones == 0 ? 0 : unzigzag(r.get(kWidth[ones]));
+        prevDelta += dod;
+        prev += prevDelta;
+        out[i] = prev;
+    }
+}
+
+/*######## Floats: Gorilla XOR ########*/
+void putDoubles(BitWriter &w, const double *v, int count, int stride)
+{
+    quint64 prev = 0;
+    int lead = -1, trail = 0;
+    for (int i = 0; i < count; ++i) {
+        quint64 bits;
+        std::memcpy(&bits, reinterpret_cast<const char *>(v) + qsizetype(i) * stride, sizeof(bits));
+        if (i == 0) { w.put(bits, 64); prev = bits; continue; }
+        const quint64 x = bits ^ prev;
+        prev = bits;
+        if (x == 0) { w.put(0, 1); continue; }
+        const int l = qMin(31, int(qCountLeadingZeroBits(x)));
+        const int t = int(qCountTrailingZeroBits(x));
+        if (lead >= 0 && l >= lead && t >= trail) {// fits the previous window
+            w.put(0b10, 2);
+            w.put(x >> trail, 64 - lead - trail);
+        } else {
+            lead = l;
+            trail = t;
+            const int sig = 64 - lead - trail;
+            w.put(0b11, 2);
+            w.put(quint64(lead), 5);
+            w.put(quint64(sig - 1), 6);
+            w.put(x >> trail, sig);
+        }
+    }
+}
+
+void getDoubles(BitReader &r, double *out, int count)
+{
+    quint64 prev = 0;
+    int lead = 0, trail = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i == 0) {
+            prev = r.get(64);
+        } else if (r.bit()) {
+            if (r.bit()) {
+                lead = int(r.get(5));
+                const int sig = int(r.get(6)) + 1;
+                trail = 64 - lead - sig;
+            }
+            prev ^= r.get(64 - lead - trail) << trail;
+        }
+        std::memcpy(&out[i], &prev, sizeof(prev));
+    }
+}
+
+int bitsFor(int n)
+{
+    int b = 0;
+    while ((1 << b) < n) ++b;
+    return b;
+}
+
+/*######## Timestamp text ########*/
+class TsFormatter
+{/* The stored text is ISODate UTC + "Z"; the date part is cached so a scan does not run QDateTime per row */
+public:
+    QString format(qint64 secs)
+    {
+        const qint64 day = secs >= 0 ? secs / 86400 : (secs - 86399) / 86400;
+        if (day != m_day || m_prefix.isEmpty()) {
+            m_day = day;
+            m_prefix = QDateTime::fromSecsSinceEpoch(day * 86400, QTimeZone::UTC).toString(QStringLiteral("yyyy-MM-dd'T'"));
+        }
+        const int s = int(secs - day * 86400);
+        QString out = m_prefix;
+        out.reserve(m_prefix.size() + 10);
+        const int hh = s / 3600, mm = (s / 60) % 60, ss = s % 60;
+        auto d = [](int v) { return QChar(char16_t(u'0' + v)); };
+        const QChar digits[] = { d(hh / 10), d(hh % 10), QChar(u':'), d(mm / 10), d(mm % 10), QChar(u':'),
+                                 d(ss / 10), d(ss % 10), QChar(u'Z'), QChar(u'Z') };
+        out.append(digits, 10);
+        return out;
+    }
+
+private:
+    qint64 m_day = 0;
+    QString m_prefix;
+};
+
+QString levelName(int idx)
+{
+    static const QString names[] = { QStringLiteral("WARNING-1"), QStringLiteral("WARNING-2"),
+                                     QStringLiteral("WARNING-3"), QStringLiteral("WARNING-4") };
+    return names[idx & 3];
+}
+
+void putU32(QByteArray &out, quint32 v) { char b[4]; qToLittleEndian(v, b); out.append(b, 4); }
+void putU64(QByteArray &out, quint64 v) { char b[8]; qToLittleEndian(v, b); out.append(b, 8); }
+}
+
+/*######## ColdArchiveWriter ########*/
+bool ColdArchiveWriter::write(const QString &path, const QVector<WarningRow> &rows, QString *error)
+{
+    auto fail = [error](const QString &why) { if (error) *error = why; return false; };
+    TsFormatter fmt;
+    QByteArray blocks;
+    QByteArray index;
+    int blockCount = 0;
+
+    for (int start = 0; start < rows.size(); start += kBlockRows) {
+        const int n = qMin(kBlockRows, int(rows.size()) - start);
+        const WarningRow *r = rows.constData() + start;
+
+        QVector<qint64> ts(n);
+        QVector<double> dist(n), xn(n);
+        QHash<QString, int> dict;
+        QStringList dictOrder;
+        bool xnDerived = true;
+        BitWriter levels;
+        for (int i = 0; i < n; ++i) {
+            ts[i] = WarningStore::epochSecs(r[i].timestamp);
+            if (fmt.format(ts[i]) != r[i].timestamp)
+                return fail(QStringLiteral("timestamp does not round-trip: %1").arg(r[i].timestamp));
+            const int li = WarningClassifier::levelIndex(r[i].level);
+            if (li == 0) return fail(QStringLiteral("unknown level: %1").arg(r[i].level));
+            levels.put(quint64(li - 1), 2);
+            dist[i] = r[i].distance;
+            xn[i] = r[i].xn;
+            xnDerived = xnDerived && WarningClassifier::xn(r[i].distance) == r[i].xn;
+            if (!dict.contains(r[i].sensor)) {
+                if (dict.size() == 255) return fail(QStringLiteral("more than 255 sensors in one block"));
+                if (r[i].sensor.toUtf8().size() > 255) return fail(QStringLiteral("sensor name over 255 bytes: %1").arg(r[i].sensor));
+                dict.insert(r[i].sensor, int(dictOrder.size()));
+                dictOrder.append(r[i].sensor);
+            }
+        }
+
+        BitWriter tsw, dw, xw, sw;
+        putTimestamps(tsw, ts);
+        putDoubles(dw, dist.constData(), n, sizeof(double));
+        if (!xnDerived) putDoubles(xw, xn.constData(), n, sizeof(double));
+        const int sensorBits = bitsFor(int(dictOrder.size()));
+        for (int i = 0; i < n; ++i) sw.put(quint64(dict.value(r[i].sensor)), sensorBits);
+
+        QByteArray block;
+        putU32(block, quint32(n));
+        block.append(char(xnDerived ? kFlagXnDerived : 0));
+        block.append(char(quint8(dictOrder.size())));
+        for (const QString &s : std::as_const(dictOrder)) {
+            const QByteArray u = s.toUtf8();   // at most 255 bytes, checked above
+            block.append(char(quint8(u.size())));
+            block.append(u);
+        }
+        for (const QByteArray &col : { tsw.finish(), dw.finish(), xw.finish(), levels.finish(), sw.finish() }) {
+            putU32(block, quint32(col.size()));
+            block.append(col);
+        }
+
+        const auto [lo, hi] = std::minmax_element(ts.cbegin(), ts.cend());
+        putU64(index, quint64(*lo));
+        putU64(index, quint64(*hi));
+        putU32(index, quint32(n));
+        putU64(index, quint64(kHeaderSize + blocks.size()));
+        putU32(index, quint32(block.size()));
+        putU32(index, Crc32::compute(block.constData(), block.size()));
+        blocks.append(block);
+        ++blockCount;
+    }
+
+    QByteArray header(kMagic, sizeof(kMagic));
+    header.append(char(kVersion));
+    header.append(char(0));
+    putU32(header, quint32(blockCount));
+    putU64(header, quint64(rows.size()));
+    putU64(header, quint64(kHeaderSize + blocks.size()));
+
+    QSaveFile file(path); // temp file + rename, a crash never leaves half an archive under the final name
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(file.errorString());
+    file.write(header);
+    file.write(blocks);
+    file.write(index);
+    if (!file.commit())
+        return fail(file.errorString());
+    return true;
+}
+
+/*######## ColdArchiveReader ########*/
+bool ColdArchiveReader::open(const QString &path)
+{
+    m_index.clear();
+    m_rowCount = 0;
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+    const QByteArray header = m_file.read(kHeaderSize);
+    if (header.size() != kHeaderSize || !header.startsWith(QByteArray(kMagic, sizeof(kMagic)))
+        || quint8(header.at(6)) != kVersion)
+        return false;
+    const quint32 blockCount = qFromLittleEndian<quint32>(header.constData() + 8);
+    m_rowCount = qint64(qFromLittleEndian<quint64>(header.constData() + 12));
+    const quint64 indexOffset = qFromLittleEndian<quint64>(header.constData() + 20);
+    if (!m_file.seek(qint64(indexOffset))) return false;
+    const QByteArray index = m_file.read(qint64(blockCount) * kIndexEntrySize);
+    if (index.size() != qsizetype(blockCount) * kIndexEntrySize) return false;
+    for (quint32 i = 0; i < blockCount; ++i) {
+        const char *e = index.constData() + qsizetype(i) * kIndexEntrySize;
+        BlockInfo b;
+        b.minSecs = qint64(qFromLittleEndian<quint64>(e));
+        b.maxSecs = qint64(qFromLittleEndian<quint64>(e + 8));
+        b.rows    = qFromLittleEndian<quint32>(e + 16);
+        b.offset  = qFromLittleEndian<quint64>(e + 20);
+        b.size    = qFromLittleEndian<quint32>(e + 28);
+        b.crc     = qFromLittleEndian<quint32>(e + 32);
+        m_index.append(b);
+    }
+    return true;
+}
+
+bool ColdArchiveReader::scan(qint64 fromSecs, qint64 toSecs, const std::function<void(const WarningRow &)> &fn)
+{
+    return scanRows(fromSecs, toSecs, 0, [&fn](qint64, const WarningRow &row) { fn(row); return true; });
+}
+
+bool ColdArchiveReader::scanRows(qint64 fromSecs, qint64 toSecs, qint64 firstRow,
+                                 const std::function<bool(qint64, const WarningRow &)> &fn)
+{
+    qint64 base = 0;   // file position of the block's first row
+    bool stopped = false;
+    for (const BlockInfo &b : std::as_const(m_index)) {
+        const qint64 blockBase = base;
+        base += b.rows;
+        if (base <= firstRow) continue;                                                        // before the cursor
+        if ((fromSecs && b.maxSecs < fromSecs) || (toSecs && b.minSecs >= toSecs)) continue;   // index seek
+        if (!m_file.seek(qint64(b.offset))) return false;
+        const QByteArray block = m_file.read(b.size);
+        if (block.size() != qsizetype(b.size) || Crc32::compute(block.constData(), block.size()) != b.crc)
+            return false;
+        if (!decodeBlock(block, b.rows, fromSecs, toSecs, blockBase, firstRow, fn, stopped)) return false;
+        if (stopped) break;
+    }
+    return true;
+}
+
+bool ColdArchiveReader::decodeBlock(const QByteArray &block, quint32 rows, qint64 fromSecs, qint64 toSecs, qint64 base,
+                                    qint64 firstRow, const std::function<bool(qint64, const WarningRow &)> &fn, bool &stopped)
+{
+    const char *p = block.constData();
+    const char *end = p + block.size();
+    if (end - p < 6 || qFromLittleEndian<quint32>(p) != rows) return false;
+    p += 4;
+    const quint8 flags = quint8(*p++);
+    const int dictSize = quint8(*p++);
+    QStringList dict;
+    for (int i = 0; i < dictSize; ++i) {
+        if (p >= end) return false;
+        const int len = quint8(*p++);
+        if (end - p < len) return false;
+        dict.append(QString::fromUtf8(p, len));
+        p += len;
+    }
+    QByteArray cols[5];
+    for (QByteArray &c : cols) {
+        if (end - p < 4) return false;
+        const quint32 len = qFromLittleEndian<quint32>(p);
+        p += 4;
+        if (quint64(end - p) < len) return false;
+        c = QByteArray::fromRawData(p, qsizetype(len));
+        p += len;
+    }
+
+    const int n = int(rows);
+    QVector<qint64> ts(n);
+    QVector<double> dist(n), xn(n);
+    BitReader tr(cols[0].constData(), cols[0].size());
+    getTimestamps(tr, ts.data(), n);
+    BitReader dr(cols[1].constData(), cols[1].size());
+    getDoubles(dr, dist.data(), n);
+    if (!(flags & kFlagXnDerived)) {
+        BitReader xr(cols[2].constData(), cols[2].size());
+        getDoubles(xr, xn.data(), n);
+        if (xr.overrun()) return false;
+    }
+    BitReader lr(cols[3].constData(), cols[3].size());
+    BitReader sr(cols[4].constData(), cols[4].size());
+    const int sensorBits = bitsFor(dictSize);
+    if (tr.overrun() || dr.overrun()) return false;
+
+    TsFormatter fmt;
+    WarningRow row;
+    for (int i = 0; i < n; ++i) {
+        const int level = int(lr.get(2));
+        const int sensor = int(sr.get(sensorBits));
+        if (base + i < firstRow) continue;
+        if ((fromSecs && ts[i] < fromSecs) || (toSecs && ts[i] >= toSecs)) continue;
+        row.timestamp = fmt.format(ts[i]);
+        row.level     = levelName(level);
+        row.distance  = dist[i];
+        row.xn        = (flags & kFlagXnDerived) ? WarningClassifier::xn(dist[i]) : xn[i];
+        row.sensor    = sensor < dict.size() ? dict.at(sensor) : QString();
+        if (!fn(base + i, row)) {
+            stopped = true;
+            return true;
+        }
+    }
+    return !lr.overrun() && !sr.overrun();
+}
@@ -1,12 +1,29 @@
 #include "comportmanager.h"
 #include "comthread.h"
+#include "replaysource.h"
+#include "simulationsource.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include "portenumerator.h"
 #include "dvclient.h"
-#include <QSerialPortInfo>
+#include "trace.h"
 #include <QDebug>
+#include <QTimer>
+
+namespace {
+constexpr int kDrainBatch = 8192;          // samples per source per event loop turn
+constexpr int kBackpressureRetryMs = 50;   // how often a held-back source is looked at again
+}
 
 ComPortManager::ComPortManager(DvClient* client, QObject* parent): QObject(parent), m_client(client)
+    , m_enumerator(new PortEnumerator(this))
 {/* Here is my COM thread ports main, we firstly for from  client and parent form DvClient AND comthread respectivlly.
+    Port enumeration runs on the PortEnumerator thread, we only forward its change signal.
     After that, we call the "reloadPorts" function to reload our ports. */
+    connect(m_enumerator, &PortEnumerator::portsChanged, this, [this](const QStringList &ports, quint64){
+        emit portsChanged(ports);
+    });
     //başlangıç için bir reload at
     reloadPorts();
 }
@@ -18,12 +35,14 @@ ComPortManager::~ComPortManager()
 }
 
 QStringList ComPortManager::availablePorts() const
-{/* It is a function that shows us the available ports on the device that are usable in our context*/
-    QStringList out;
-    const auto ports = QSerialPortInfo::availablePorts();
-    //portları oports kaydetiyoruz//COMlarda var olanlarıın numaralarını ports kaydetir
-    for (const auto &p : ports) out << p.portName();//get all the port names which are not NULL
-    return out;
+{/* It is a function that shows us the available ports on the device that are usable in our context.
+    This is the last list the background scan found, it may be empty right after startup. */
+    return m_enumerator->ports();
+}
+
+quint64 ComPortManager::portListVersion() const
+{
+    return m_enumerator->version();
 }
 
 void ComPortManager::setModeIdle()
@@ -48,10 +67,48 @@ with randomly generated values. After that, we reload our ports. */
     reloadPorts();
 }
 
+void ComPortManager::setSimulationConfig(const SimulationConfig &cfg)
+{
+    m_simConfig = cfg;
+}
+
+void ComPortManager::setModeReplay(const QStringList &captureFiles, double speed)
+{/* Replays recorded .qacap files through the same path as live ports, speed 0 = as fast as possible */
+    m_mode = Mode::Replay;
+    m_replayFiles = captureFiles;
+    m_replaySpeed = speed;
+    reloadPorts();
+}
+
+void ComPortManager::setQueueConfig(const QueueConfig &cfg)
+{
+    m_queueConfig = cfg;
+}
+
+void ComPortManager::setFraming(FrameParser::Framing framing)
+{
+    m_framing = framing;
+}
+
+int ComPortManager::queuedSamples() const
+{
+    int n = 0;
+    for (SampleSource *source : m_threads)
+        n += source->queue().size();
+    return n;
+}
+
+void ComPortManager::setCaptureDirectory(const QString &dir)
+{/* Takes effect for the threads started by the next reload */
+    m_captureDir = dir;
+    if (!dir.isEmpty()) QDir().mkpath(dir);
+}
+
 void ComPortManager::reloadPorts()
 {//renew the ports, and delete the existing ones after that, call it again.
     clearAll();
     startAll();
+    m_enumerator->rescan(); // picks up plugged/unplugged adapters, portsChanged follows if the list differs
 }
 
 void ComPortManager::stopAll()
@@ -89,9 +146,17 @@ starts to run, initially, it will stay in Idle.
         For future implementation on device side, we plan to add local sensor that reads the values on device. Thus, 
         the operator will test with his hand or something like that. The reason for doing that is that,
         depending on the device, we may get some zero readings, but there are some issues with the fan blades. It  
-        allowed the  operator to be sure.*/
-        m_client->setCOMSentinel(1);
-        emit allPortsClosed();
+        allowed the  operator to be sure.
+        Each virtual port is a SimulationSource thread that behaves like a ComThread; with ports=0 the
+        old single random value every 5 s is used instead. */
+        for (int i = 0; i < m_simConfig.ports; ++i) {
+            auto *source = new SimulationSource(m_simConfig, i, this);
+            attachSource(source, source->portName());
+        }
+        if (m_threads.isEmpty()) {
+            m_client->setCOMSentinel(1);
+            emit allPortsClosed();
+        }
         return;
     }
 
@@ -107,23 +172,13 @@ starts to run, initially, it will stay in Idle.
         }
 
         ComThread *thread = new ComThread(m_selectedPort, this); /* Allocating a new thread for our new COM. */ 
-        const QString portName = m_selectedPort; //capturing the portname
         thread->setBaudRate(QSerialPort::Baud115200); //Setting our baud rate, which we are gonna read from our ESP32
-        
-        /*######### Thread Connections - Start #########*/
-        /* We are making the requirements connections to proceed with our COM readings. Which we can see portOpen and portFailed
-        distanceReceived and the parseError. and thread finish conditions.*/
-        connect(thread, &ComThread::portOpened, this, &ComPortManager::onPortOpened); //Making the requirment connections
-        connect(thread, &ComThread::distanceReceived, this, &ComPortManager::onDistance);
-        connect(thread, &ComThread::parseError, this, [portName](const QString &line){
-            qWarning() << "error on" << portName << ":" << line;
-        });
-        connect(thread, &ComThread::portOpenFailed, this, &ComPortManager::onPortOpenFailed);
-        connect(thread, &QThread::finished, this, &ComPortManager::onThreadFinished);
-        /*######### Thread Connections - End #########*/
-        
-        thread->start(); // after setting the connections, we can start the thread.
-        m_threads.append(thread);
+        thread->setFraming(m_framing);
+        if (!m_captureDir.isEmpty()) {
+            const QString stamp = QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss");
+            thread->setCapturePath(QDir(m_captureDir).filePath(QStringLiteral("%1-%2.qacap").arg(QFileInfo(m_selectedPort).fileName(), stamp)));
+        }
+        attachSource(thread, m_selectedPort);
         
         if (m_openCount == 0)
         {// will flip to 0->1 on portOpened, setting as open for the current port
@@ -132,6 +187,20 @@ starts to run, initially, it will stay in Idle.
         return;
     }
 
+    if (m_mode == Mode::Replay)
+    {/* Each capture file becomes its own source, named after the port it was recorded on */
+        for (const QString &file : std::as_const(m_replayFiles)) {
+            auto *replay = new ReplaySource(file, m_replaySpeed, this);
+            replay->setFraming(m_framing);
+            attachSource(replay, QStringLiteral("replay:%1").arg(QFileInfo(file).completeBaseName()));
+        }
+        if (m_threads.isEmpty()) {
+            emit allPortsClosed();
+            m_client->setCOMSentinel(1);
+        }
+        return;
+    }
+
     if (m_openCount == 0) {
         emit allPortsClosed();
         /*which means if the user re-selects "select port" on COMs, close all the existing COMs
@@ -140,16 +209,38 @@ starts to run, initially, it will stay in Idle.
     }
 }
 
+void ComPortManager::attachSource(SampleSource *source, const QString &name)
+{/*######### Thread Connections #########*/
+    /* We are making the requirements connections to proceed with our COM readings. Which we can see portOpen and portFailed
+    samplesReady and the parseError. and thread finish conditions.*/
+    const QString portName = name; //capturing the portname
+    connect(source, &SampleSource::portOpened, this, &ComPortManager::onPortOpened); //Making the requirment connections
+    QueueConfig queue = m_queueConfig;
+    if (m_mode == Mode::Replay) queue.policy = QueuePolicy::Block; // a replay waits, it never loses samples
+    source->setQueueConfig(queue);
+    connect(source, &SampleSource::samplesReady, this, [this, source, portName](){
+        drain(source, portName);
+    });
+    connect(source, &SampleSource::parseError, this, [portName](const QString &line){
+        qWarning() << "error on" << portName << ":" << line;
+    });
+    connect(source, &SampleSource::portOpenFailed, this, &ComPortManager::onPortOpenFailed);
+    connect(source, &QThread::finished, this, &ComPortManager::onThreadFinished);
+
+    source->start(); // after setting the connections, we can start the thread.
+    m_threads.append(source);
+}
+
 void ComPortManager::clearAll()
 {/* Before clearing the threads, we need to stop the thread and put it in wait mode.*/
-    for (ComThread *thread : m_threads) {
+    for (SampleSource *thread : m_threads) {
         qDebug() << "Stopping: " << thread->objectName();
         thread->stop();//   m_running = false;
         thread->wait();//   QThread in-build function
         qDebug() << "Stopped: " << thread->objectName();
         delete thread;// Threadi şimdi siliyoruyz,
     }
-    m_threads.clear(); //QVector<ComThread*> m_threads; olarak tanımsadım ve her bir vector listedir,direk clear atabilirim free yapmam gerekemez
+    m_threads.clear(); //QVector<SampleSource*> m_threads; olarak tanımsadım ve her bir vector listedir,direk clear atabilirim free yapmam gerekemez
 }
 
 void ComPortManager::onPortOpened(const QString &portName)
@@ -162,9 +253,25 @@ void ComPortManager::onPortOpened(const QString &portName)
     qDebug() << "Port opened:" << portName;
 }
 
-void ComPortManager::onDistance(float distance)
-{/* Getting read distance and updating the distance value from the client side */
-    m_client->updateDistance(distance);
+void ComPortManager::drain(SampleSource *source, const QString &portName)
+{/* Getting read distances and updating them from the client side, at most kDrainBatch per turn so one
+    fast source cannot hold the GUI thread; the rest comes back through the event loop. While the store
+    stage pushes back nothing is taken: the ingest queue fills up and its own policy applies, which is how
+    Block travels from SQLite back to the source thread. */
+    if (m_client->storeBackpressure()) {
+        QTimer::singleShot(kBackpressureRetryMs, source, [this, source, portName]() { drain(source, portName); });
+        return;
+    }
+    bool more = false;
+    m_drainBuffer.resize(0);
+    {
+        QTALP_TRACE_SCOPE("pipeline.handoff");
+        source->queue().take(m_drainBuffer, kDrainBatch, &more);
+    }
+    if (!m_drainBuffer.isEmpty())
+        m_client->updateDistances(portName, m_drainBuffer);
+    if (more)
+        QMetaObject::invokeMethod(source, [this, source, portName]() { drain(source, portName); }, Qt::QueuedConnection);
 }
 
 void ComPortManager::onPortOpenFailed(const QString &err)
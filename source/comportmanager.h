@@ -4,20 +4,26 @@
 #include <QObject>
 #include <QVector>
 #include <QStringList>
+#include "simulationsource.h"
+#include "boundedqueue.h"
+#include "frameparser.h"
 
-class ComThread;
 class DvClient;
+class PortEnumerator;
 
 class ComPortManager : public QObject {
     Q_OBJECT
 public:
-    enum class Mode { Idle, AllPorts, SinglePort, SimulationOnly };
+    enum class Mode { Idle, AllPorts, SinglePort, SimulationOnly, Replay };
 
     explicit ComPortManager(DvClient* client, QObject* parent = nullptr);
     ~ComPortManager() override;
 
-    // Query
+    // Query (cached, never enumerates on the caller's thread)
     QStringList availablePorts() const;
+    quint64 portListVersion() const;
+    QueueConfig queueConfig() const { return m_queueConfig; }
+    int queuedSamples() const;   // waiting in the ingest queues of all running sources
 
 public slots:
     void reloadPorts();
@@ -25,27 +31,42 @@ public slots:
     void setModeIdle();
     void setModeSingle(const QString &portName);
     void setModeSimulation();
+    void setSimulationConfig(const SimulationConfig &cfg);   // takes effect on the next reload
+    void setModeReplay(const QStringList &captureFiles, double speed);
+    void setCaptureDirectory(const QString &dir);   // non-empty: every ComThread records a .qacap there
+    void setQueueConfig(const QueueConfig &cfg);      // [queues] ingest, takes effect on the next reload
+    void setFraming(FrameParser::Framing framing);    // [serial] framing of ports and replays, on the next reload
 
 signals:
     void anyPortOpened();
     void allPortsClosed();
+    void portsChanged(const QStringList &ports);
 
 private slots:
     void onPortOpened(const QString &portName);
-    void onDistance(float distance);
     void onPortOpenFailed(const QString &err);
     void onThreadFinished();
 
 private:
     void startAll();
     void clearAll();
+    void attachSource(SampleSource *source, const QString &name);
+    void drain(SampleSource *source, const QString &portName);
 
     DvClient *m_client;
-    QVector<ComThread*> m_threads;
+    PortEnumerator *m_enumerator;
+    QVector<SampleSource*> m_threads;
     int m_openCount = 0;
 
     Mode m_mode = Mode::Idle;     // start idle (no reading)
     QString m_selectedPort;
+    QStringList m_replayFiles;
+    double m_replaySpeed = 1.0;
+    QString m_captureDir;
+    SimulationConfig m_simConfig;
+    QueueConfig m_queueConfig;
+    FrameParser::Framing m_framing = FrameParser::Framing::Text;
+    QVector<SourceSample> m_drainBuffer;
 };
 
 #endif // COMPORTMANAGER_H
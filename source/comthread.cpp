@@ -1,9 +1,14 @@
 #include "comthread.h"
 #include <qdebug.h>
+#include "metrics.h"
+#include "trace.h"
+#include "capturefile.h"
+#include "threadscheduling.h"
+#include <QElapsedTimer>
 
 /* Good old thread implemetation. */
 ComThread::ComThread(const QString &portName, QObject *parent)
-    : QThread(parent), m_portName(portName) {
+    : SampleSource(parent), m_portName(portName) {
     setObjectName(QStringLiteral("ComThread[%1]").arg(portName));
 }
 
@@ -23,13 +28,25 @@ void ComThread::setBaudRate(qint32 baudRate)
     m_baudRate = baudRate;
 }
 
+void ComThread::setCapturePath(const QString &path)
+{
+    m_capturePath = path;
+}
+
+void ComThread::setFraming(FrameParser::Framing framing)
+{
+    m_parser.setFraming(framing);
+}
+
 void ComThread::stop()
 {
     m_running = false;
+    closeQueue();
 }
 
 void ComThread::run()
 {
+    ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Acquisition);
     m_serial.setPortName(m_portName);
     m_serial.setBaudRate(m_baudRate);
     m_serial.setDataBits(QSerialPort::Data8);
@@ -37,11 +54,12 @@ void ComThread::run()
     m_serial.setStopBits(QSerialPort::OneStop);
     m_serial.setFlowControl(QSerialPort::NoFlowControl);
 
+    // Direct: the error is raised inside waitForReadyRead() on this thread, an unplug must not wait for the owner's event loop
     connect(&m_serial, &QSerialPort::errorOccurred, this,
             [this](QSerialPort::SerialPortError e){
                 if (e == QSerialPort::ResourceError || e == QSerialPort::ReadError || e == QSerialPort::DeviceNotFoundError)
                     m_running = false;
-            });
+            }, Qt::DirectConnection);
 
 
     if (!m_serial.open(QIODevice::ReadOnly)) {
@@ -50,31 +68,46 @@ void ComThread::run()
     }
     emit portOpened(m_portName);
 
-    m_running = true;
-    m_buffer.clear();
+    m_parser.reset();
+
+    CaptureWriter capture; // raw bytes with timestamps, for replaying field incidents later
+    QElapsedTimer captureClock;
+    if (!m_capturePath.isEmpty()) {
+        if (capture.open(m_capturePath, m_portName)) qInfo() << "Capturing" << m_portName << "to" << m_capturePath;
+        else qWarning() << "Cannot open capture file" << m_capturePath;
+        captureClock.start();
+    }
 
     while (m_running && m_serial.isOpen()) {
         if (m_serial.waitForReadyRead(100)) {
-            m_buffer += m_serial.readAll();
-            // qDebug()<<"READ :"<<m_buffer;
-            processBuffer();
+            {
+                QTALP_TRACE_SCOPE("serial.read");
+                m_chunk.resize(qMax<qint64>(m_serial.bytesAvailable(), 1));
+                const qint64 n = m_serial.read(m_chunk.data(), m_chunk.size());
+                m_chunk.resize(qMax<qint64>(n, 0));
+            }
+            if (m_chunk.isEmpty()) continue;
+            // qDebug()<<"READ :"<<m_chunk;
+            if (capture.isOpen()) capture.write(captureClock.nsecsElapsed() / 1000, m_chunk);
+            processBuffer(m_chunk);
         }
     }
     m_serial.close();
 }
 
-void ComThread::processBuffer()
+void ComThread::processBuffer(const QByteArray &chunk)
 {
-    int idx;
-    while ((idx = m_buffer.indexOf('\n')) >= 0) {
-        QByteArray line = m_buffer.left(idx).trimmed();
-        m_buffer.remove(0, idx + 1);
-
-        bool ok;
-        float dist = line.toFloat(&ok);
-        if (ok)
-            emit distanceReceived(dist);
-        else
-            emit parseError(QString::fromUtf8(line));
-    }
+    static Counter &samples = Metrics::counter("samples_received_total", "Frames parsed into a distance");
+    static Counter &errors  = Metrics::counter("parse_errors_total", "Serial lines that were not a float");
+    static Counter &bytes   = Metrics::counter("serial_bytes_total", "Raw bytes read from all ports");
+    QTALP_TRACE_SCOPE("serial.frame");
+    bytes.inc(quint64(chunk.size()));
+    m_batch.resize(0);
+    const qint64 tsUs = sampleClockUs();   // the lines of one read arrived together
+    m_parser.feed(chunk,
+                  [this, tsUs](int channel, float dist){ m_batch.append({ dist, channel, tsUs }); },
+                  [this](const QByteArray &line){ errors.inc(); emit parseError(QString::fromUtf8(line)); });
+    if (m_batch.isEmpty()) return;
+    samples.inc(quint64(m_batch.size()));
+    publish(m_batch);   // one queue lock per chunk, not per line
 }
@@ -1,11 +1,13 @@
 #ifndef COMTHREAD_H
 #define COMTHREAD_H
 
-#include <QThread>
 #include <QSerialPort>
 #include <QSerialPortInfo>
+#include "samplesource.h"
+#include "frameparser.h"
+#include <atomic>
 
-class ComThread : public QThread
+class ComThread : public SampleSource
 {
     Q_OBJECT
 
@@ -15,25 +17,24 @@ public:
 
     void setPortName(const QString &name);
     void setBaudRate(qint32 baudRate);
-    void stop();
-
-signals:
-    void portOpened(const QString &portName);
-    void distanceReceived(float distance);
-    void parseError(const QString &line);
-    void portOpenFailed(const QString &errorString);
+    void setCapturePath(const QString &path); // record every raw chunk to a .qacap file, empty = off
+    void setFraming(FrameParser::Framing framing); // [serial] framing, before start()
+    void stop() override;
 
 protected:
     void run() override;
 
 private:
-    void processBuffer();
+    void processBuffer(const QByteArray &chunk);
 
     QString      m_portName;
+    QString      m_capturePath;
     qint32       m_baudRate = QSerialPort::Baud115200;
-    bool         m_running  = false;
+    std::atomic<bool> m_running{true};   // cleared by stop() or a fatal port error, possibly before run() starts
     QSerialPort  m_serial;
-    QByteArray   m_buffer;
+    FrameParser  m_parser;
+    QByteArray   m_chunk;        // read buffer, reused: no allocation per read once it has grown
+    QVector<SourceSample> m_batch;   // distances of the chunk being parsed
 };
 
 #endif // COMTHREAD_H
@@ -0,0 +1,38 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <QtGlobal>
+#include <array>
+
+namespace Crc32 {
+/* IEEE 802.3 CRC-32 (same as zlib's crc32), table driven. qChecksum is only CRC-16,
+   and the archive and journal files want something a torn write cannot pass by chance. */
+inline const std::array<quint32, 256> &table()
+{
+    static const std::array<quint32, 256> t = [] {
+        std::array<quint32, 256> tab{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            tab[i] = c;
+        }
+        return tab;
+    }();
+    return t;
+}
+
+inline quint32 update(quint32 crc, const void *data, qsizetype len)
+{
+    const auto &t = table();
+    const quint8 *p = static_cast<const quint8 *>(data);
+    crc = ~crc;
+    while (len-- > 0)
+        crc = t[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline quint32 compute(const void *data, qsizetype len) { return update(0, data, len); }
+}
+
+#endif // CRC32_H
@@ -0,0 +1,277 @@
+#include "distancechartwidget.h"
+#include "dvclient.h"
+#include "trace.h"
+#include <QChart>
+#include <QDateTime>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr int    kRedrawMs      = 200;
+constexpr int    kMaxHistory    = 1000000;    // raw samples kept in RAM over all series (~16 MB)
+constexpr int    kHistoryTrim   = 20000;      // trimmed in chunks so the trim cost is amortized
+constexpr qint64 kMinWindowMs   = 5 * 1000;
+constexpr qint64 kMaxWindowMs   = 30LL * 24 * 3600 * 1000;
+}
+
+DistanceChartWidget::DistanceChartWidget(DvClient *client, QWidget *parent)
+    : QChartView(parent), m_client(client)
+{/* Chart, axes and the DB history series are created once; per-port series are added the first time the port sends */
+    QChart *c = new QChart();
+    c->legend()->setAlignment(Qt::AlignBottom);
+    setChart(c);
+    setRenderHint(QPainter::Antialiasing, false);
+
+    m_axisX = new QDateTimeAxis(this);
+    m_axisX->setFormat("HH:mm:ss");
+    m_axisX->setTitleText("Time");
+    m_axisY = new QValueAxis(this);
+    m_axisY->setTitleText("Distance (cm)");
+    c->addAxis(m_axisX, Qt::AlignBottom);
+    c->addAxis(m_axisY, Qt::AlignLeft);
+
+    m_dbSeries = new QLineSeries(this);
+    m_dbSeries->setName("History (DB)");
+    c->addSeries(m_dbSeries);
+    m_dbSeries->attachAxis(m_axisX);
+    m_dbSeries->attachAxis(m_axisY);
+
+    connect(&m_redrawTimer, &QTimer::timeout, this, &DistanceChartWidget::refresh);
+    m_redrawTimer.start(kRedrawMs);
+}
+
+DistanceChartWidget::PortTrace &DistanceChartWidget::traceFor(const QString &port)
+{
+    auto it = m_traces.find(port);
+    if (it != m_traces.end()) return it.value();
+
+    PortTrace trace;
+    trace.series = new QLineSeries(this);
+    trace.series->setName(port);
+    chart()->addSeries(trace.series);
+    trace.series->attachAxis(m_axisX);
+    trace.series->attachAxis(m_axisY);
+    return m_traces.insert(port, trace).value();
+}
+
+int DistanceChartWidget::bucketCount() const
+{// one bucket per horizontal pixel of the plot area
+    return std::max(16, int(chart()->plotArea().width()));
+}
+
+qint64 DistanceChartWidget::bucketMs() const
+{
+    return std::max<qint64>(1, m_windowMs / bucketCount());
+}
+
+qint64 DistanceChartWidget::viewEnd() const
+{
+    return m_follow ? QDateTime::currentMSecsSinceEpoch() : m_frozenEnd;
+}
+
+void DistanceChartWidget::addSample(const QString &port, qint64 msecs, double distance)
+{/* O(1) per sample: append to the raw history and fold into the last bucket. */
+    PortTrace &trace = traceFor(port);
+    const QPointF p(double(msecs), distance);
+    trace.history.append(p);
+    if (++m_historySize > kMaxHistory)
+        trimHistory();
+
+    if (!m_follow && msecs > m_frozenEnd) return; // outside a frozen view, only kept for later
+
+    const qint64 idx = msecs / m_bucketMs;
+    if (!trace.buckets.isEmpty() && trace.buckets.last().index == idx) {
+        Bucket &b = trace.buckets.last();
+        if (distance < b.lo.y()) b.lo = p;
+        if (distance > b.hi.y()) b.hi = p;
+    } else {
+        trace.buckets.append(Bucket{ idx, p, p });
+    }
+    trace.changed = true;
+}
+
+void DistanceChartWidget::trimHistory()
+{/* The budget is shared by every series, and a port with 8 channels has 8 of them: the longest history
+    gives up its oldest samples, so a busy sensor cannot push a quiet one out of the chart */
+    PortTrace *longest = nullptr;
+    for (PortTrace &trace : m_traces)
+        if (!longest || trace.history.size() > longest->history.size()) longest = &trace;
+    if (!longest) return;
+    const qsizetype n = std::min<qsizetype>(kHistoryTrim, longest->history.size());
+    longest->history.remove(0, n);
+    m_historySize -= n;
+    m_needDbHistory = true;   // the RAM history starts later now, the database fills the gap
+}
+
+void DistanceChartWidget::clearSamples()
+{
+    for (PortTrace &trace : m_traces) {
+        trace.history.clear();
+        trace.buckets.clear();
+        trace.series->clear();
+    }
+    m_historySize = 0;
+    m_dbSeries->clear();
+}
+
+void DistanceChartWidget::rebucket(PortTrace &trace)
+{/* Only after zoom/pan/resize: rebuild the buckets of the visible window from the raw history */
+    trace.buckets.clear();
+    const qint64 end = viewEnd();
+    const double from = double(end - m_windowMs);
+    auto it = std::lower_bound(trace.history.cbegin(), trace.history.cend(), from,
+                               [](const QPointF &p, double x){ return p.x() < x; });
+    for (; it != trace.history.cend() && it->x() <= double(end); ++it) {
+        const qint64 idx = qint64(it->x()) / m_bucketMs;
+        if (!trace.buckets.isEmpty() && trace.buckets.last().index == idx) {
+            Bucket &b = trace.buckets.last();
+            if (it->y() < b.lo.y()) b.lo = *it;
+            if (it->y() > b.hi.y()) b.hi = *it;
+        } else {
+            trace.buckets.append(Bucket{ idx, *it, *it });
+        }
+    }
+    trace.changed = true;
+}
+
+void DistanceChartWidget::rebucketAll()
+{
+    m_bucketMs = bucketMs();
+    for (PortTrace &trace : m_traces)
+        rebucket(trace);
+    loadDatabaseHistory();
+}
+
+void DistanceChartWidget::loadDatabaseHistory()
+{/* When the view reaches back before what is held in RAM, ask the storage rollups for min/max
+    per bucket, so the result is bounded by the plot width, not by the rows in the range. Following
+    "now" too: zoomed out past the RAM history, the left side comes from the database. */
+    m_dbSeries->clear();
+    m_needDbHistory = false;
+    if (!m_client) return;
+
+    const qint64 end = viewEnd();
+    const qint64 start = end - m_windowMs;
+    qint64 earliest = std::numeric_limits<qint64>::max();
+    for (const PortTrace &trace : std::as_const(m_traces))
+        if (!trace.history.isEmpty()) earliest = std::min(earliest, qint64(trace.history.first().x()));
+    if (start >= earliest) return;
+
+    const qint64 to = std::min(end, earliest);
+    const QVector<RollupPoint> rows = m_client->store().history(start / 1000, (to + 999) / 1000,
+                                                               int(m_windowMs / m_bucketMs));
+    QList<QPointF> pts; // rows come per sensor, ordered by bucket: fold the sensors of one bucket together
+    pts.reserve(rows.size() * 2);
+    for (const RollupPoint &r : rows) {
+        const double t = double(r.bucketSecs) * 1000.0;
+        if (!pts.isEmpty() && pts.constLast().x() == t) {
+            QPointF &lo = pts[pts.size() - 2];
+            QPointF &hi = pts[pts.size() - 1];
+            lo.setY(std::min(lo.y(), r.min));
+            hi.setY(std::max(hi.y(), r.max));
+            continue;
+        }
+        pts.append(QPointF(t, r.min));
+        pts.append(QPointF(t, r.max));
+    }
+    m_dbSeries->replace(pts);
+}
+
+void DistanceChartWidget::refresh()
+{/* Timer driven redraw. Cost is the number of buckets, i.e. the plot width in pixels. */
+    QTALP_TRACE_SCOPE("ui.paint.chart");
+    if (m_needRebucket || m_bucketMs != bucketMs()) {
+        m_needRebucket = false;
+        rebucketAll();
+    } else if (m_needDbHistory) {
+        loadDatabaseHistory();
+    }
+
+    const qint64 end = viewEnd();
+    const qint64 start = end - m_windowMs;
+    const qint64 firstIdx = start / m_bucketMs;
+
+    double yMin = std::numeric_limits<double>::max();
+    double yMax = std::numeric_limits<double>::lowest();
+    for (PortTrace &trace : m_traces) {
+        int drop = 0;
+        while (drop < trace.buckets.size() && trace.buckets.at(drop).index < firstIdx) ++drop;
+        if (drop) { trace.buckets.remove(0, drop); trace.changed = true; }
+
+        for (const Bucket &b : std::as_const(trace.buckets)) {
+            yMin = std::min(yMin, b.lo.y());
+            yMax = std::max(yMax, b.hi.y());
+        }
+        if (!trace.changed) continue;
+        trace.changed = false;
+
+        QList<QPointF> pts;
+        pts.reserve(trace.buckets.size() * 2);
+        for (const Bucket &b : std::as_const(trace.buckets)) {
+            if (b.lo.x() <= b.hi.x()) { pts.append(b.lo); pts.append(b.hi); }
+            else { pts.append(b.hi); pts.append(b.lo); }
+        }
+        trace.series->replace(pts);
+    }
+    for (const QPointF &p : m_dbSeries->points()) {
+        yMin = std::min(yMin, p.y());
+        yMax = std::max(yMax, p.y());
+    }
+
+    m_axisX->setRange(QDateTime::fromMSecsSinceEpoch(start), QDateTime::fromMSecsSinceEpoch(end));
+    if (yMin <= yMax) {
+        const double pad = std::max(1.0, (yMax - yMin) * 0.05);
+        m_axisY->setRange(yMin - pad, yMax + pad);
+    }
+}
+
+void DistanceChartWidget::resizeEvent(QResizeEvent *event)
+{
+    QChartView::resizeEvent(event);
+    m_needRebucket = true;
+}
+
+void DistanceChartWidget::wheelEvent(QWheelEvent *event)
+{/* Zoom the time window, anchored at the right edge (now, while following). */
+    const double steps = event->angleDelta().y() / 120.0;
+    const double factor = steps > 0 ? 0.8 : 1.25;
+    m_windowMs = std::clamp<qint64>(qint64(m_windowMs * factor), kMinWindowMs, kMaxWindowMs);
+    m_needRebucket = true;
+    event->accept();
+}
+
+void DistanceChartWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        m_dragX = int(event->position().x());
+        if (m_follow) { m_frozenEnd = viewEnd(); m_follow = false; }
+    }
+    QChartView::mousePressEvent(event);
+}
+
+void DistanceChartWidget::mouseMoveEvent(QMouseEvent *event)
+{/* Pan: a drag of the whole plot width moves the view by one window */
+    if (m_dragX >= 0) {
+        const int x = int(event->position().x());
+        const double plotW = std::max(1.0, chart()->plotArea().width());
+        m_frozenEnd -= qint64((x - m_dragX) * (m_windowMs / plotW));
+        m_dragX = x;
+        m_needRebucket = true;
+    }
+    QChartView::mouseMoveEvent(event);
+}
+
+void DistanceChartWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    m_dragX = -1;
+    QChartView::mouseReleaseEvent(event);
+}
+
+void DistanceChartWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{// back to the live view
+    m_follow = true;
+    m_needRebucket = true;
+    QChartView::mouseDoubleClickEvent(event);
+}
@@ -0,0 +1,76 @@
+#ifndef DISTANCECHARTWIDGET_H
+#define DISTANCECHARTWIDGET_H
+
+#include <QChartView>
+#include <QLineSeries>
+#include <QDateTimeAxis>
+#include <QValueAxis>
+#include <QTimer>
+#include <QHash>
+#include <QVector>
+#include <QPointF>
+
+class DvClient;
+
+class DistanceChartWidget : public QChartView
+{/* Live distance-over-time chart, one line per port. Samples are folded into min/max buckets one pixel wide
+    as they arrive, so a redraw only ever touches ~2 points per pixel no matter how fast the sensors stream. */
+    Q_OBJECT
+
+public:
+    explicit DistanceChartWidget(DvClient *client, QWidget *parent = nullptr);
+
+public slots:
+    void addSample(const QString &port, qint64 msecs, double distance);
+    void clearSamples();
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private slots:
+    void refresh();
+
+private:
+    struct Bucket {
+        qint64 index;
+        QPointF lo;
+        QPointF hi;
+    };
+    struct PortTrace {
+        QLineSeries      *series = nullptr;
+        QVector<QPointF>  history;   // raw samples kept in memory (bounded over all traces)
+        QVector<Bucket>   buckets;   // live min/max buckets of the current window
+        bool              changed = false;
+    };
+
+    PortTrace &traceFor(const QString &port);
+    int  bucketCount() const;
+    qint64 bucketMs() const;
+    qint64 viewEnd() const;
+    void trimHistory();
+    void rebucketAll();
+    void rebucket(PortTrace &trace);
+    void loadDatabaseHistory();
+
+    DvClient       *m_client;
+    QDateTimeAxis  *m_axisX;
+    QValueAxis     *m_axisY;
+    QLineSeries    *m_dbSeries;      // decimated rows from SQLite when zoomed/panned before the live history
+    QHash<QString, PortTrace> m_traces;
+    qsizetype       m_historySize = 0;  // samples in all histories together
+    QTimer          m_redrawTimer;
+    bool            m_needRebucket = false;
+    bool            m_needDbHistory = false;   // RAM history was trimmed, reload m_dbSeries
+    bool            m_follow  = true;  // window glued to "now"
+    qint64          m_windowMs = 60 * 1000;
+    qint64          m_frozenEnd = 0;   // view end while not following
+    qint64          m_bucketMs  = 1;
+    int             m_dragX = -1;
+};
+
+#endif // DISTANCECHARTWIDGET_H
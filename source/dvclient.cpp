@@ -1,6 +1,18 @@
 #include "dvclient.h"
 #include "comportmanager.h"
+#include "warningclassifier.h"
+#include "socketioframe.h"
+#include "metrics.h"
+#include "trace.h"
+#include "processstats.h"
+#include "warningreplayer.h"
+#include "simulationsource.h"
+#include "warningquery.h"
+#include "shmexport.h"
+#include "threadscheduling.h"
+#include "logsink.h"
 #include <QCoreApplication>
+#include <QSettings>
 #include <QNetworkRequest>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -8,31 +20,120 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDateTime>
+#include <QTimeZone>
 #include <QFile>
+#include <QTemporaryFile>
+#include <QScopedValueRollback>
 #include <QDebug>
 #include <QNetworkInterface>
 #include <QUrl>
 #include <QUrlQuery>
-#include <cmath>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace {
+class SlotHold
+{/* An upload slot taken for as long as the flow holding it lives, released also when it is cancelled */
+public:
+    explicit SlotHold(int &inFlight) : m_inFlight(inFlight) { ++m_inFlight; }
+    ~SlotHold() { --m_inFlight; }
+    SlotHold(const SlotHold &) = delete;
+    SlotHold &operator=(const SlotHold &) = delete;
+private:
+    int &m_inFlight;
+};
+
+constexpr int kFoldBatch   = 50000;    // journal samples per rollup transaction
+constexpr int kFoldRounds  = 8;        // transactions per journal tick, the rest waits for the next one
+constexpr int kUploadBatch = 100000;   // samples per send_samples body
+constexpr int kQueryMaxRows = 10000;   // rows per query_warnings page
+constexpr int kFallbackSampleMs = 5000; // the old heartbeat cadence of the random Simulation value
+constexpr int kStoreCapacity = 10000;   // detected rows waiting for SQLite, default of store_capacity
+constexpr int kStoreFlushRows = 5000;   // rows per insert transaction when a backlog is flushed
+constexpr int kStoreRetryMs = 1000;     // after a failed insert
+constexpr int kSessionTimeoutMs   = 15000;  // DevicevOpen answer
+constexpr int kConnectTimeoutMs   = 10000;  // websocket upgrade
+constexpr int kHandshakeTimeoutMs = 10000;  // each Socket.IO handshake packet
+constexpr int kUploadTimeoutMs    = 120000; // one upload body, aborted after that
+constexpr int kManifestTimeoutMs  = 30000;  // the chunk manifest answer
+constexpr int kArchiveCheckMs     = 600000; // between looks for partitions due for the cold archive
+constexpr int kLinkRetryMs        = 30000;  // before a new session after a failure or a dropped socket
+
+void recordCommandLatency(const QString &cmd, const QElapsedTimer &handling)
+{/* command_<cmd>_us, from the "m" frame to the end of its handler. A flow started by the handler
+    (uploads, queries) is counted up to its first wait, which includes building the body. */
+    Metrics::histogram(QStringLiteral("command_%1_us").arg(cmd), QStringLiteral("handling time of %1").arg(cmd))
+        .record(quint64(handling.nsecsElapsed() / 1000));
+}
+
+int remainingMs(const QElapsedTimer &clock, int budgetMs)
+{
+    return qMax(1, budgetMs - int(clock.elapsed()));
+}
+
+Async::Task<bool> awaitFrame(QWebSocket &socket, SocketIoFrame::Type type, int timeoutMs)
+{/* Skips whatever else arrives meanwhile, onSocketTextMessageReceived sees those frames anyway */
+    QElapsedTimer clock;
+    clock.start();
+    for (;;) {
+        const auto msg = co_await Async::signal(&socket, &QWebSocket::textMessageReceived, remainingMs(clock, timeoutMs));
+        if (!msg) co_return false;
+        if (SocketIoFrame::parse(std::get<0>(*msg)).type == type) co_return true;
+    }
+}
+
+WarningFilter filterFromRequest(const QJsonObject &request)
+{/* "last_s" or "from"/"to" (ISO), "levels" (array or comma list), "sensor" */
+    WarningFilter filter;
+    if (request.contains("last_s"))
+        filter = WarningFilter::lastSeconds(request.value("last_s").toInteger());
+    else {
+        filter.fromTs = request.value("from").toString();
+        filter.toTs   = request.value("to").toString();
+    }
+    const QJsonValue levels = request.value("levels");
+    if (levels.isArray()) {
+        for (const QJsonValue &l : levels.toArray()) filter.levels.append(l.toString());
+    } else if (!levels.toString().isEmpty()) {
+        filter.levels = levels.toString().split(QLatin1Char(','), Qt::SkipEmptyParts);
+    }
+    filter.sensor = request.value("sensor").toString();
+    return filter;
+}
+}
 
 DvClient::DvClient(QObject *parent)
     : QObject(parent)
-    , m_portManager(new ComPortManager(this, this))
+    , m_pendingRows(QStringLiteral("store"), QueueConfig{ kStoreCapacity, QueuePolicy::DropOldest }, false)
 {/* DvClient main, which handles the websocket connections between the ERP system and the Project. */
     loadSession();
-    connect(&http, &QNetworkAccessManager::finished, this, &DvClient::onHttpFinished);
     connect(&socket, &QWebSocket::textMessageReceived, this, &DvClient::onSocketTextMessageReceived);
     connect(&socket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error), this, &DvClient::onSocketError);
+    pingTimer.setSingleShot(true);
+    m_linkClock.start();
     connect(&pingTimer, &QTimer::timeout, this, &DvClient::onPingTimeout);
+    connect(&journalTimer, &QTimer::timeout, this, &DvClient::onJournalTimer);
+    connect(&fallbackTimer, &QTimer::timeout, this, &DvClient::onFallbackSample);
+    storeRetryTimer.setSingleShot(true);
+    connect(&storeRetryTimer, &QTimer::timeout, this, [this]() { flushPendingRows(); });
+    // Last: the manager opens the ports right away and calls back (setCOMSentinel, updateDistances)
+    m_portManager = new ComPortManager(this, this);
+    connect(m_portManager, &ComPortManager::portsChanged, this, &DvClient::serialPortsChanged);
 }
 
 DvClient::~DvClient()
 {/*DESTRUCTOR: When we are done with using the Program, it will stop ping (heartbeat) and close the socket
 As well as, delete the port manager */
+    m_flows.cancel();   // before close(), whose disconnected would resume the link flow
     pingTimer.stop();
     socket.close(); // ensures no pending textMessageReceived later
     if (m_portManager) m_portManager->stopAll();
     delete m_portManager;
+    if (m_journal) {
+        journalTimer.stop();
+        onJournalTimer(); // last fold and flush while the DB is still open
+        delete m_journal;
+    }
 }
 
 QStringList DvClient::serialPorts() const
@@ -48,51 +149,117 @@ By asking whether the port is available or not. if that is not the case; functio
 }
 
 
+void DvClient::configureProcess(QSettings &cfg)
+{/* [sched] first: threads inherit the main thread's CPU mask, and the log writer is the first to start */
+    ThreadScheduling::configure(cfg);
+    ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Main);
+    LogSink::instance().configure(cfg);
+}
+
+bool DvClient::configure(QSettings &cfg)
+{/* Everything qtalp.ini says about the client, in the order it depends on: rotation and retention before
+    the database opens, the rest after it. The GUI and the headless build both come through here. */
+    m_store.configure(cfg);                                 // [storage] partition rotation and retention
+    if (!initDatabase()) return false;
+    if (cfg.value("metrics/http_enabled", false).toBool()) { // [metrics] /metrics on localhost
+        m_metricsServer = new MetricsServer(this);
+        m_metricsServer->start(quint16(cfg.value("metrics/http_port", 9464).toUInt()));
+    }
+    if (cfg.value("capture/enabled", false).toBool())       // [capture] raw serial bytes for later replay
+        setCaptureDirectory(cfg.value("capture/dir", QCoreApplication::applicationDirPath() + "/captures").toString());
+    if (cfg.value("journal/enabled", false).toBool())       // [journal] every raw reading, SQLite keeps the derived events
+        openJournal(cfg);
+    if (cfg.value("shm/enabled", false).toBool())           // [shm] live stream for the PLC bridge and other local readers
+        openShmExport(cfg);
+    setSimulationConfig(SimulationConfig::fromSettings(cfg)); // [simulation] virtual ports for the Simulation entry
+    setDetectorConfig(DetectorConfig::fromSettings(cfg));     // [detector] hysteresis and rate limits for warnings rows
+    setHeartbeatConfig(HeartbeatConfig::fromSettings(cfg));   // [heartbeat] adaptive ping interval
+    configureQueues(cfg);                                     // [queues] bounded stages and what they drop when full
+    configureSerial(cfg);                                     // [serial] single value or multi-channel frames per port
+    configureUploads(cfg);                                    // [upload] chunked send_logs, only what the ERP lacks
+    return true;
+}
+
 bool DvClient::initDatabase()
 {/* Here we are initializing the SQL database for warnings, to make local storage of our values. */
-    db = QSqlDatabase::addDatabase("QSQLITE"); // "QSQLite" is the Qt version of SQLite
-    db.setDatabaseName(QCoreApplication::applicationDirPath() + "/warnings.db");//Setting DB name
-    if (!db.open()) {// if not open handle
-        qWarning() << "Cannot open SQLite:" << db.lastError().text();
+    if (!m_store.open(QCoreApplication::applicationDirPath() + "/warnings.db"))//Setting DB name
+        return false;
+    qDebug() << "SQLite initialized at" << m_store.path();
+    m_flows.spawn(archiveLoop());
+    return true;
+}
+
+bool DvClient::openJournal(QSettings &cfg)
+{/* From here on every reading goes to the journal and the rollups are built from it; the heartbeat
+    keeps storing its warnings rows, which are then only the derived events. */
+    auto *journal = new SampleJournal(cfg.value("journal/dir", QCoreApplication::applicationDirPath() + "/journal").toString());
+    journal->configure(cfg);
+    if (!journal->open()) {
+        qWarning() << "Sample journal disabled, cannot open" << journal->dir();
+        delete journal;
         return false;
     }
-    QSqlQuery q;
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS warnings (
-          id        INTEGER PRIMARY KEY AUTOINCREMENT,
-          timestamp TEXT    NOT NULL,
-          level     TEXT    NOT NULL,
-          distance  REAL    NOT NULL,
-          xn        REAL    NOT NULL
-        )
-    )")) {/* If the table does not exist, it will generate one according  to the given format*/
-        qWarning() << "Failed to create table:" << q.lastError().text();
+    m_journal = journal;
+    m_store.setRollupsFromInserts(false);
+    journalTimer.start(qMax(100, cfg.value("journal/sync_ms", 1000).toInt()));
+    qDebug() << "Sample journal at" << journal->dir() << "next seq" << journal->nextSeq();
+    return true;
+}
+
+bool DvClient::openShmExport(QSettings &cfg)
+{/* Readers map the object themselves (qtalp_shm.h), nothing here waits for them */
+    auto *shm = new ShmExport(this);
+    if (!shm->open(cfg)) {
+        delete shm;
         return false;
     }
-    qDebug() << "SQLite initialized at" << db.databaseName();
+    m_shm = shm;
     return true;
 }
 
 void DvClient::start()
-{/* It is a function that starts the device. It will first generate the URL that we need using the "buildDvOpURL" function.
-With the generated URL, we can send our open Request to the ERP system and fetch our session.*/
-    QString url = buildDvOpUrl(sessionId);
-    qDebug() << "Fetching session via:" << url;
-    http.get(QNetworkRequest(QUrl(url)));
+{/* It is a function that starts the device: the ERP link runs from here on as one flow (runLink), which
+reconnects by itself whenever a step fails or the socket drops. */
+    m_flows.spawn(runLink());
 }
 
-void DvClient::onHttpFinished(QNetworkReply *reply)
-{
-    const QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> guard(reply); // auto deleteLater()
-    if (reply->error() != QNetworkReply::NoError) {
-        qWarning() << "HTTP error:" << reply->errorString();
-        return;
+Async::Task<> DvClient::runLink()
+{/* Open the session over HTTP, connect the socket, do the Socket.IO handshake and register, then wait for
+    the socket to drop and start over after kLinkRetryMs. Every step has its own timeout, so a server that
+    stops answering halfway costs a retry instead of leaving the device silently offline. */
+    for (;;) {
+        if (co_await openSession() && co_await connectSocket()) {
+            co_await Async::signal(&socket, &QWebSocket::disconnected);
+            qWarning() << "WS disconnected";
+        }
+        registered = false;
+        pingTimer.stop();
+        socket.abort();
+        Metrics::counter("link_retries_total", "ERP session/socket attempts that failed or dropped").inc();
+        co_await Async::sleep(kLinkRetryMs);
+    }
+}
+
+Async::Task<bool> DvClient::openSession()
+{/* It will first generate the URL that we need using the "buildDvOpURL" function. With the generated URL,
+we send our open Request to the ERP system and fetch our session. */
+    const QString url = buildDvOpUrl(sessionId);
+    qDebug() << "Fetching session via:" << url;
+    QNetworkReply *reply;
+    {
+        QTALP_TRACE_SCOPE("http.send");
+        reply = http.get(QNetworkRequest(QUrl(url)));
+    }
+    const Async::HttpResult r = co_await Async::reply(reply, kSessionTimeoutMs);
+    QTALP_TRACE_SCOPE("http.recv");
+    if (!r.ok()) {
+        qWarning() << "HTTP error:" << r.errorString;
+        co_return false;
     }
-    QByteArray body = reply->readAll();
-    auto doc = QJsonDocument::fromJson(body).object();
+    auto doc = QJsonDocument::fromJson(r.body).object();
     if (doc["status"].toString() != "succes") {
-        qWarning() << "Bad status:" << body;
-        return;
+        qWarning() << "Bad status:" << r.body;
+        co_return false;
     }
     auto data = doc["data"].toObject();
     sessionId  = data["S"].toString();
@@ -100,96 +267,90 @@ void DvClient::onHttpFinished(QNetworkReply *reply)
     locationID = data["corps_locations_id"].toString();
     devicesID  = data["devices_id"].toString();
     if (!haveSavedSession) { saveSession(); haveSavedSession = true; }
+    co_return true;
+}
+
+Async::Task<bool> DvClient::connectSocket()
+{/* Websocket upgrade with the session cookie, then the SocketIO handshake protocol: the server's open
+    packet is answered with "40", its connect ack with our registration */
     QNetworkRequest req(QUrl("wss://dev-kodx.mepsan.com.tr/s.io/?EIO=4&transport=websocket"));
     req.setRawHeader("Cookie", QByteArray("S=") + sessionId.toUtf8());
     socket.open(req);
+    QElapsedTimer clock;
+    clock.start();
+    while (socket.state() != QAbstractSocket::ConnectedState) {
+        const auto state = co_await Async::signal(&socket, &QWebSocket::stateChanged, remainingMs(clock, kConnectTimeoutMs));
+        if (!state) {
+            qWarning() << "WS connect timed out";
+            co_return false;
+        }
+        if (std::get<0>(*state) == QAbstractSocket::UnconnectedState) {
+            qWarning() << "WS connect failed:" << socket.errorString();
+            co_return false;
+        }
+    }
+    if (!co_await awaitFrame(socket, SocketIoFrame::Type::Open, kHandshakeTimeoutMs)) {
+        qWarning() << "SocketIO: no open packet";
+        co_return false;
+    }
+    socket.sendTextMessage("40");
+    if (!co_await awaitFrame(socket, SocketIoFrame::Type::Connect, kHandshakeTimeoutMs)) {
+        qWarning() << "SocketIO: connect not acknowledged";
+        co_return false;
+    }
+    // Registration processes step
+    QJsonArray reg{ "r", QJsonObject{{"n", sessionId}, {"r","dev"}} };
+    socket.sendTextMessage("42" + QJsonDocument(reg).toJson(QJsonDocument::Compact));
+    registered = true;
+    m_heartbeat.reset();
+    onPingTimeout(); // Condition that make our registration allive, the pongs keep it going
+    co_return true;
 }
 
 void DvClient::onSocketTextMessageReceived(const QString &msg)
 {/* It is where we process the message that we received from the ERP system. The message itself is 
 in the raw data format. Thus, this function also transforms that data into our message.*/
-    // SocketIO handshake protocol
-    if (msg.startsWith('0')) { socket.sendTextMessage("40"); return; } 
-    if (msg == "2")        { socket.sendTextMessage("3");  return; }
-    if (msg == "3")        { return; }
-
-    if (msg.startsWith("40") && !registered) {// Registration processes step
-        QJsonArray reg{ "r", QJsonObject{{"n", sessionId}, {"r","dev"}} };
-        socket.sendTextMessage("42" + QJsonDocument(reg).toJson(QJsonDocument::Compact));
-        registered = true;
-        pingTimer.start(5000); // Condition that make our registration allive
-        return;
-    }
+    QTALP_TRACE_SCOPE("ws.recv");
+    const SocketIoFrame frame = SocketIoFrame::parse(msg);
 
-    if (msg.startsWith("42")) 
-    {/* This part handles the true event of the message, which initially processes the message that we received 
-        from ERP. Then, we need to convert it into a QbyteArray, which becomes our raw reading to be processed.
-        then we pulled our ev data, which message string to be seen. It can be "pong" or "m*(message) or 
+    // Open and Connect belong to the handshake in connectSocket()
+    if (frame.type == SocketIoFrame::Type::Ping) { socket.sendTextMessage("3");  return; }
+    if (frame.type == SocketIoFrame::Type::Pong) { return; }
+
+    if (frame.type == SocketIoFrame::Type::Event) 
+    {/* This part handles the true event of the message. The frame already carries the parsed array,
+        its first element is the ev string to be seen. It can be "pong" or "m*(message) or 
         various other depending on what ERP sends*/
-        QByteArray raw = msg.mid(2).toUtf8();
-        auto arr = QJsonDocument::fromJson(raw).array();
-        QString ev = arr.at(0).toString();
+        const QString &ev = frame.event;
 
         if (ev == "pong") {
-            if (ErrorSimulationSentinelVal) 
-            {/*This heartbeat implementation is very valuable to the ERP system to keep the device open
-                because, if there is no response after a certain amount of time ERP system will shut down the device.
-                So, every 5 seconds, ERP sends a tick to the device device sends a ping*/
-                double dist; // will be the distance that readed from the COMs
-                if (comSentinel)
-                {/* If comSentinel is set, use a random simulated distance between 10 and 200
-                WHY we have this, it is a test condition that other elements are working or not*/
-                    dist = QRandomGenerator::global()->generateDouble() * 190.0 + 10.0;
-                } 
-                else {
-                    // Otherwise, use the actual currentDistance value from the COM port
-                    dist = this->currentDistance;
-                }
-                
-                // Xn processing
-                double t  = 7.0 * (dist * 10.0) + 3.0;
-                double xn = std::fmod(t, 4.0);
-                if (xn < 0.0) xn += 4.0;
-                
-                QString lvl;/* Depending on the value of the Xn, we determine our warning level, 
-                whether it is in the range or not. Warning values are important because, depending on their value,
-                which level they will populate their corresponding locations on the 3D Graph*/
-                if (xn <= 1.5) lvl = "WARNING-1"; 
-                else if (xn <= 2.1) lvl = "WARNING-2";
-                else if (xn <= 3.1) lvl = "WARNING-3";
-                else lvl = "WARNING-4";
-                
-                QSqlQuery ins;/* This SQL condition handles to sets our calculated and read values to store in our local Database.
-                The reason why we are doing it dynamically is to protect the data, if there is be connection error with ERP*/
-                
-                ins.prepare(R"(INSERT INTO warnings (timestamp, level, distance, xn) VALUES (:ts, :lvl, :d, :xn))");
-                QString now = QDateTime::currentDateTimeUtc().toString(Qt::ISODate) + "Z";
-                ins.bindValue(":ts",  now);
-                ins.bindValue(":lvl", lvl);
-                ins.bindValue(":d",   dist);
-                ins.bindValue(":xn",  xn);
-                if (!ins.exec()) {
-                    qWarning() << "DB insert failed:" << ins.lastError().text();
-                } else {
-                    emit newWarning(now, lvl, dist, xn);
-                }
-            }
+            /* RTT into the heartbeat estimator, which may have picked a new interval: the next ping is
+               rescheduled so pings stay that far apart. */
+            const qint64 rttUs = m_heartbeat.pong(frame.args.at(1).toObject(), m_linkClock.nsecsElapsed() / 1000);
+            if (rttUs >= 0 && registered)
+                pingTimer.start(qMax(0, m_heartbeat.intervalMs() - int(rttUs / 1000)));
+            /* The pong only carries link status. Warnings are detected in the sample pipeline as the
+               readings arrive (detect()), so they keep coming while the ERP link is down. */
         }
         else if (ev == "m")
         {/* This is where we process our "m" message value. If the ERP system sends a message, 
         then we need to process that message value further. For us to get a specific "cmd" 
         command value to precede the commands on the device*/
-            QJsonObject obj = arr.at(1).toObject();
-            QString tStr = obj.value("t").toString();
-            QJsonDocument innerDoc = QJsonDocument::fromJson(tStr.toUtf8());
-            QJsonObject inner = innerDoc.object();
+            QElapsedTimer handling;
+            handling.start();
+            QJsonObject inner = frame.commandObject();
             QString cmd = inner.value("f").toString();
+            bool known = true;
 
             if (cmd == "send_logs") 
             {/* It is a command that calls the uploading recorded SQL file to the ERP system */
                 qInfo() << "==> LOGs will be uploading:";
                 uploadLogFile();
             }
+            else if (cmd == "send_samples")
+            {/* Raw journal samples the ERP has not received yet, at most kUploadBatch per command */
+                uploadSamples();
+            }
             else if (cmd == "get_d_parameters")
             {/*Function that lists the device parameters */
                 requestParameters();
@@ -211,6 +372,23 @@ in the raw data format. Thus, this function also transforms that data into our m
                 qInfo() << "\n\nWARNING: System UNSTABLE";
                 ErrorSimulationSentinelVal = 1;
             }
+            else if (cmd == "query_warnings")
+            {/* Filtered page of stored warnings, e.g. {"f":"query_warnings","last_s":3600,"levels":["WARNING-4"]} */
+                m_flows.spawn(queryWarnings(inner));
+            }
+            else if (cmd == "history_stats")
+            {/* Level counts, distance histogram and reclassification count over the stored history, same filters */
+                m_flows.spawn(historyStats(inner));
+            }
+            else if (cmd == "replay_warnings")
+            {/* Replays a stored range (ISO "from"/"to", empty = open) at "speed", re-uploading it if "upload" is set */
+                replayWarnings(inner.value("from").toString(), inner.value("to").toString(),
+                               inner.value("speed").toDouble(1.0), inner.value("upload").toBool());
+            }
+            else if (cmd == "dump_trace")
+            {/* Writes the pipeline trace rings to a Chrome/Perfetto JSON file next to the executable */
+                dumpTrace();
+            }
             else if (cmd == "ping")
             {//Sending a legit ping from ERP that gave a response
                 onPingTimeout();
@@ -225,29 +403,185 @@ in the raw data format. Thus, this function also transforms that data into our m
             }
             else {//Unknown command handler, if there will be an Unknown command is received from the ERP system.
                 qWarning() << "Unknown Command:" << cmd;
+                known = false;
             }
+            recordCommandLatency(known ? cmd : QStringLiteral("unknown"), handling);
         }
     }
 }
 
 void DvClient::resetDatabase()
-{/* Function that cleans the values in the local SQLite database*/
-    if (db.isOpen()) db.close();
-    QString path = QCoreApplication::applicationDirPath() + "/warnings.db";
-    if (QFile::exists(path) && !QFile::remove(path))
-        qWarning() << "Failed to remove DB file:" << path;
-    initDatabase();
+{/* Function that cleans the values in the local SQLite database.
+    It is a partition rotation: the "warnings" view starts empty right away, the old rows stay in their
+    closed partition until the next send_logs has uploaded them, then retention drops that partition. */
+    if (!m_store.rotate(QStringLiteral("reset")))
+        qWarning() << "Failed to rotate the warnings partition";
 }
 
 void DvClient::setCOMSentinel(int value)
-{// Setting the new COM Sentinel
+{// Setting the new COM Sentinel, while it is set (no source open) a random reading stands in every 5 s
     comSentinel = value;
+    if (comSentinel) fallbackTimer.start(kFallbackSampleMs);
+    else             fallbackTimer.stop();
     qDebug() << "COMsentinel set to:" << value;
 }
 
-void DvClient::updateDistance(float distance)
-{/* Update the distance readed by the HC-SR04 sensor*/
-    currentDistance = distance;
+void DvClient::onFallbackSample()
+{/* If comSentinel is set, use a random simulated distance between 10 and 200
+    WHY we have this, it is a test condition that other elements are working or not*/
+    updateDistance(QStringLiteral("Simulation"), float(QRandomGenerator::global()->generateDouble() * 190.0 + 10.0));
+}
+
+void DvClient::updateDistance(const QString &port, float distance)
+{/* Update the distance readed by the HC-SR04 sensor: every reading goes through the warning detector first,
+    then to the journal/shared memory and the live views */
+    const qint64 tsUs = sampleClockUs();
+    QVector<WarningRow> rows;
+    detect(port, tsUs, distance, rows);
+    storeWarnings(rows);
+    recordSample(port, tsUs, distance);
+    emit sampleReceived(port, tsUs / 1000, distance);
+}
+
+void DvClient::updateDistances(const QString &port, const QVector<SourceSample> &batch)
+{/* Same as updateDistance for a whole batch; the rows it produces go to the DB in one transaction.
+    A tagged channel is a sensor of its own, "<port>#<channel>", for the detector, the rows, the journal
+    and the live views alike; the names are made once per port and channel and then looked up by index.
+    Every sample keeps the time its source stamped it with, however long it waited in the ingest queue. */
+    if (batch.isEmpty()) return;
+    QVector<QString> &channels = m_channelSensors[port];
+    auto sensor = [&port, &channels](int channel) -> const QString & {
+        if (channel < 0) return port;
+        if (channel >= channels.size()) channels.resize(channel + 1);
+        QString &name = channels[channel];
+        if (name.isEmpty()) name = port + QLatin1Char('#') + QString::number(channel);
+        return name;
+    };
+    QVector<WarningRow> rows;
+    for (const SourceSample &s : batch)
+        detect(sensor(s.channel), s.tsUs, s.distance, rows);
+    storeWarnings(rows);
+    for (const SourceSample &s : batch) {
+        const QString &name = sensor(s.channel);
+        recordSample(name, s.tsUs, s.distance);
+        emit sampleReceived(name, s.tsUs / 1000, s.distance);
+    }
+}
+
+void DvClient::detect(const QString &port, qint64 tsUs, float distance, QVector<WarningRow> &rows)
+{/* Only while sensor reading is started (Start Sensor Reading / changed_parameters), like the heartbeat did */
+    if (!ErrorSimulationSentinelVal) return;
+    WarningDetector::Event ev;
+    QTALP_TRACE_SCOPE("warning.classify");
+    if (!m_detector.feed(port, tsUs / 1000, distance, ev)) return;
+    WarningRow row;
+    row.xn        = ev.xn;
+    row.level     = WarningClassifier::levelName(ev.level);
+    row.distance  = ev.distance;
+    row.sensor    = port;
+    row.timestamp = WarningStore::tsFromMSecs(tsUs / 1000);
+    row.tsUs      = tsUs;
+    rows.append(row);
+}
+
+void DvClient::storeWarnings(const QVector<WarningRow> &rows)
+{/* The reason why we are storing it dynamically is to protect the data, if there is be connection error with ERP.
+    Rows pass through the bounded "store" queue: a failed insert leaves them there for the retry, and
+    store_policy decides once that backlog is full. */
+    if (rows.isEmpty()) return;
+    bool wake = false;
+    m_pendingRows.push(rows.constData(), int(rows.size()), &wake);
+    flushPendingRows(true);
+}
+
+void DvClient::flushPendingRows(bool measure)
+{/* Rows leave the queue only once they are committed. Latency is measured from the source stamping the
+    sample to newWarning, ingest queue included, for rows stored in the turn they were detected in (not
+    for replays, whose stamps are capture time). Shared memory gets the sample time, not the commit time,
+    so rows flushed late by the retry still line up with their samples. */
+    QVector<WarningRow> rows;
+    if (m_pendingRows.peek(rows, kStoreFlushRows) == 0) return;
+    const bool stored = rows.size() == 1 ? m_store.insert(rows.constFirst()) : m_store.insertBatch(rows);
+    if (!stored) {
+        if (!storeRetryTimer.isActive()) storeRetryTimer.start(kStoreRetryMs);
+        return;
+    }
+    m_pendingRows.pop(int(rows.size()));
+    static Histogram &latency = Metrics::histogram("warning_detect_latency_us", "Sample acquisition to newWarning");
+    for (const WarningRow &row : std::as_const(rows)) {
+        if (m_shm)
+            m_shm->publishWarning(m_shm->portIndex(row.sensor), row.tsUs,
+                                  WarningClassifier::levelIndex(row.level), row.distance, row.xn);
+        emit newWarning(row.timestamp, row.level, row.distance, row.xn);
+        if (measure && !row.sensor.startsWith(QLatin1String("replay:")))
+            latency.record(quint64(qMax<qint64>(0, sampleClockUs() - row.tsUs)));
+    }
+    if (m_pendingRows.size() > 0 && !storeRetryTimer.isActive())
+        storeRetryTimer.start(0);   // the rest of a backlog, one transaction per event loop turn
+}
+
+bool DvClient::storeBackpressure() const
+{
+    return m_pendingRows.policy() == QueuePolicy::Block && m_pendingRows.full();
+}
+
+void DvClient::configureSerial(QSettings &cfg)
+{
+    FrameParser::Framing framing = FrameParser::Framing::Text;
+    const QString name = cfg.value("serial/framing", FrameParser::framingName(framing)).toString();
+    if (!FrameParser::parseFraming(name, framing))
+        qWarning() << "Unknown serial framing" << name << "- using text";
+    if (m_portManager) m_portManager->setFraming(framing);
+}
+
+void DvClient::configureUploads(QSettings &cfg)
+{
+    m_chunkedUploads = cfg.value("upload/chunked", false).toBool();
+    m_manifest.setChunkRows(cfg.value("upload/chunk_rows", m_manifest.chunkRows()).toInt());
+}
+
+void DvClient::configureQueues(QSettings &cfg)
+{/* One bounded queue per stage boundary: ingest (every source thread to here) and store (detected rows
+    to SQLite), plus a cap on uploads in flight. Drops are counted per stage, see get_d_parameters. */
+    if (m_portManager)
+        m_portManager->setQueueConfig(QueueConfig::fromSettings(cfg, QStringLiteral("ingest"), QueueConfig()));
+    m_pendingRows.setConfig(QueueConfig::fromSettings(cfg, QStringLiteral("store"), QueueConfig{ kStoreCapacity, QueuePolicy::DropOldest }));
+    m_maxUploadsInFlight = qMax(1, cfg.value("queues/upload_in_flight", 1).toInt());
+}
+
+void DvClient::recordSample(const QString &port, qint64 tsUs, float distance)
+{
+    if (!m_journal && !m_shm) return;
+    quint16 flags = 0;
+    if (port == QLatin1String("Simulation") || port.startsWith(QLatin1String("SIM"))) flags |= SampleJournal::Simulated;
+    if (port.startsWith(QLatin1String("replay:"))) flags |= SampleJournal::Replayed;
+    if (m_journal) m_journal->append(m_journal->portId(port), tsUs, distance, flags);
+    if (m_shm) m_shm->publishSample(m_shm->portIndex(port), tsUs, distance, flags);
+}
+
+void DvClient::onJournalTimer()
+{/* Flush, then fold whatever the "rollups" cursor has not seen yet. The cursor only moves after the
+    rollup transaction committed, so a crash in between folds that batch again rather than losing it. */
+    QTALP_TRACE_SCOPE("journal.fold");
+    m_journal->sync();
+    quint64 from = m_journal->cursor(QStringLiteral("rollups"));
+    QVector<SampleJournal::Sample> batch;
+    QVector<RollupSample> samples;
+    for (int round = 0; round < kFoldRounds; ++round) {
+        const quint64 next = m_journal->read(from, kFoldBatch, batch);
+        if (next == from) break;
+        samples.resize(batch.size());
+        for (int i = 0; i < batch.size(); ++i) {
+            const SampleJournal::Sample &smp = batch.at(i);
+            samples[i].secs     = smp.tsUs / 1000000;
+            samples[i].sensor   = m_journal->portName(smp.port);
+            samples[i].distance = smp.value;
+            samples[i].level    = WarningClassifier::levelIndex(WarningClassifier::level(WarningClassifier::xn(smp.value)));
+        }
+        if (!m_store.addRollupSamples(samples)) break;
+        m_journal->setCursor(QStringLiteral("rollups"), next);
+        from = next;
+    }
 }
 
 void DvClient::requestParameters()
@@ -263,6 +597,48 @@ separate the pairs as IP and MAC as first and second pair*/
     qInfo() << "   Location ID:" << locationID;
     qInfo() << "   IP          :" << ip;
     qInfo() << "   MAC         :" << mac;
+    Metrics::gauge("rss_kib").set(ProcessStats::rssKiB());
+    qInfo() << "==> Metrics:";
+    for (const QString &line : Metrics::summaryLines())
+        qInfo().noquote() << "  " << line;
+
+    qInfo() << "==> Queues:";
+    auto stage = [](const QString &name, QueuePolicy policy, int capacity, int depth) {
+        qInfo().noquote() << QStringLiteral("   %1 %2 depth=%3/%4 dropped=%5")
+                                 .arg(name, -7).arg(QueueConfig::policyName(policy), -12).arg(depth).arg(capacity)
+                                 .arg(Metrics::counter(QStringLiteral("queue_%1_dropped_total").arg(name)).value());
+    };
+    if (m_portManager) {
+        const QueueConfig ingest = m_portManager->queueConfig();
+        stage(QStringLiteral("ingest"), ingest.policy, ingest.capacity, m_portManager->queuedSamples());
+    }
+    stage(QStringLiteral("store"), m_pendingRows.policy(), m_pendingRows.capacity(), m_pendingRows.size());
+    stage(QStringLiteral("upload"), QueuePolicy::DropNewest, m_maxUploadsInFlight, m_uploadsInFlight);
+
+    qInfo() << "==> Heartbeat:";
+    for (const QString &line : m_heartbeat.summaryLines())
+        qInfo().noquote() << "  " << line;
+
+    qInfo() << "==> Scheduling:";
+    for (const QString &line : ThreadScheduling::summaryLines())
+        qInfo().noquote() << "  " << line;
+}
+
+QString DvClient::dumpTrace()
+{/* Trace file for the "dump_trace" command and the UI button. Open it in ui.perfetto.dev or chrome://tracing */
+    if (!Tracer::compiledIn()) {
+        qWarning() << "Tracing is not compiled in (configure with -DQTALP_ENABLE_TRACING=ON)";
+        return QString();
+    }
+    const QString path = QCoreApplication::applicationDirPath() + "/traces/trace-"
+                         + QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss") + ".json";
+    const int n = Tracer::dump(path);
+    if (n < 0) {
+        qWarning() << "Cannot write trace file" << path;
+        return QString();
+    }
+    qInfo() << "==> Trace written:" << path << "(" << n << "events)";
+    return path;
 }
 
 void DvClient::onSocketError(QAbstractSocket::SocketError)
@@ -271,8 +647,15 @@ void DvClient::onSocketError(QAbstractSocket::SocketError)
 }
 
 void DvClient::onPingTimeout()
-{//Legit Ping that got from ERP system.
-    socket.sendTextMessage("42[\"ping\",{}]");
+{/* Legit Ping that got from ERP system, numbered so its pong can be matched. Pings that never got
+    their pong are written off first, which also drops the interval to heartbeat/min_ms. */
+    QTALP_TRACE_SCOPE("ws.send");
+    const qint64 nowUs = m_linkClock.nsecsElapsed() / 1000;
+    if (m_heartbeat.expire(nowUs) > 0)
+        qWarning() << "Heartbeat: pong overdue, lost so far" << m_heartbeat.lost();
+    socket.sendTextMessage(QString::fromLatin1(m_heartbeat.ping(nowUs)));
+    // The pong re-arms for the full interval; without one the next ping goes out at the timeout
+    if (registered) pingTimer.start(qMin(m_heartbeat.intervalMs(), m_heartbeat.config().timeoutMs));
 }
 
 QString DvClient::buildDvOpUrl(const QString &session)
@@ -304,7 +687,210 @@ automatically. Some names may be inconsistent due to not sharing company methods
 void DvClient::uploadLogFile()
 {/* Function that allowed us to upload our local database values onto the ERP system with converting the SQL reading into JSON format
 in order for the ERP system to understand. */
-    QSqlQuery query("SELECT timestamp, level, distance, xn FROM warnings");
+    m_flows.spawn(sendLogs());
+}
+
+void DvClient::uploadSamples()
+{
+    m_flows.spawn(sendSamples());
+}
+
+Async::Task<> DvClient::sendLogs()
+{/* Closed partitions that never reached the ERP, then the active one. After a successful
+    upload the closed ones are marked and retention may drop them. One at a time, holding its upload
+    slot throughout: a second one would plan and post the same chunks while the first is between posts. */
+    if (m_sendingLogs) {
+        qWarning() << "send_logs: the previous one is still running";
+        co_return;
+    }
+    if (!uploadSlotFree()) co_return;
+    QScopedValueRollback<bool> running(m_sendingLogs, true);
+    SlotHold slot(m_uploadsInFlight);
+    QVector<WarningPartition> parts = m_store.pendingUploads();
+    QVector<int> closedIds;
+    for (const WarningPartition &p : std::as_const(parts))
+        closedIds.append(p.id);
+    parts.append(m_store.activePartition());
+    const bool sent = m_chunkedUploads ? co_await sendLogChunks(parts) : co_await sendWholeLog(parts);
+    if (sent) {
+        m_store.markUploaded(closedIds);
+        m_store.applyRetention();
+        if (m_chunkedUploads) m_manifest.prune();
+    }
+}
+
+Async::Task<bool> DvClient::sendWholeLog(QVector<WarningPartition> parts)
+{
+    QByteArray body;
+    {
+        QTALP_TRACE_SCOPE("http.upload");
+        body = serializeLogs(m_store, parts);
+    }
+    co_return co_await postBody(std::move(body));
+}
+
+Async::Task<bool> DvClient::sendLogChunks(QVector<WarningPartition> parts)
+{/* [upload] chunked: the chunks the manifest has not seen acknowledged are offered to the ERP first, it
+    answers with the hashes it already holds (a device that lost its database, an upload whose answer got
+    lost), and only the rest is posted, one chunk per body. A chunk is recorded as soon as its post went
+    through, so a failure halfway only costs the chunks that were not sent yet. True once nothing is left.
+    An ERP without the manifest endpoint gets the whole body as before. */
+    static Counter &chunksSent    = Metrics::counter("upload_chunks_sent_total", "send_logs chunks posted");
+    static Counter &chunksSkipped = Metrics::counter("upload_chunks_skipped_total", "send_logs chunks the ERP already had");
+    static Counter &bytesSaved    = Metrics::counter("upload_bytes_saved_total", "send_logs body bytes not sent again");
+    UploadManifest::Plan plan;
+    {
+        QTALP_TRACE_SCOPE("http.upload");
+        plan = m_manifest.plan(parts);
+    }
+    if (!plan.ok) co_return false;
+    qint64 saved = plan.bytesAcked;
+    int skipped = plan.chunksAcked;
+    if (!plan.chunks.isEmpty()) {
+        QNetworkRequest req = erpRequest(QUrl("https://devSampllle.san.com.tr/dl/DeviceLogManifest"));// -> Sample Name
+        req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        const Async::HttpResult r = co_await Async::reply(http.post(req, UploadManifest::offer(plan.chunks, m_manifest.chunkRows())),
+                                                          kManifestTimeoutMs);
+        if (r.status == 404 || r.status == 405 || r.status == 501) {
+            qWarning() << "The ERP has no chunk manifest endpoint, sending the whole log";
+            co_return co_await sendWholeLog(std::move(parts));
+        }
+        if (!r.ok()) {
+            qWarning() << "Chunk manifest failed:" << r.errorString;
+            Metrics::counter("upload_failures_total").inc();
+            co_return false;
+        }
+        const QSet<QByteArray> have = UploadManifest::parseHave(r.body);
+        for (LogChunk &c : plan.chunks) {
+            if (have.contains(c.hash)) {
+                saved += c.body.size();
+                ++skipped;
+                m_manifest.acknowledge(c);
+                continue;
+            }
+            const QList<QPair<QByteArray, QByteArray>> headers{
+                { "chunk_key", c.key().toLatin1() }, { "chunk_hash", c.hash }, { "chunk_rows", QByteArray::number(c.rows) } };
+            if (!co_await postBody(c.body, headers)) co_return false;
+            m_manifest.acknowledge(c);
+            c.body = QByteArray();   // posted, the rest of the plan still holds its own
+            chunksSent.inc();
+        }
+    }
+    chunksSkipped.inc(quint64(skipped));
+    bytesSaved.inc(quint64(saved));
+    qInfo() << "==> send_logs:" << plan.chunks.size() << "chunk(s) offered," << skipped << "already acknowledged,"
+            << saved << "bytes not sent again," << plan.rowsRead << "of" << plan.rows << "rows serialized";
+    co_return true;
+}
+
+Async::Task<> DvClient::sendSamples()
+{/* The "upload" cursor moves only once the ERP accepted the body, a failed post is resent next time.
+    One at a time, whatever upload_in_flight allows: two would read the same cursor and post the same batch. */
+    if (!m_journal) {
+        qWarning() << "send_samples: the sample journal is not enabled";
+        co_return;
+    }
+    if (m_sendingSamples) {
+        qWarning() << "send_samples: the previous one is still running";
+        co_return;
+    }
+    if (!uploadSlotFree()) co_return;
+    QScopedValueRollback<bool> running(m_sendingSamples, true);
+    SlotHold slot(m_uploadsInFlight);
+    const quint64 from = m_journal->cursor(QStringLiteral("upload"));
+    QVector<SampleJournal::Sample> batch;
+    const quint64 next = m_journal->read(from, kUploadBatch, batch);
+    if (batch.isEmpty()) {
+        if (next != from) m_journal->setCursor(QStringLiteral("upload"), next);
+        qInfo() << "==> No new samples to upload";
+        co_return;
+    }
+    qInfo() << "==> Uploading" << batch.size() << "samples";
+    QByteArray body;
+    {
+        QTALP_TRACE_SCOPE("http.upload");
+        body = serializeSamples(*m_journal, batch);
+    }
+    if (co_await postBody(std::move(body)) && m_journal)
+        m_journal->setCursor(QStringLiteral("upload"), next);
+}
+
+Async::Task<> DvClient::sendRows(QVector<WarningRow> rows)
+{
+    co_await postLogBody(serializeRows(rows));
+}
+
+bool DvClient::uploadSlotFree()
+{/* [queues] upload_in_flight: while the ERP is slow to answer, further bodies are refused instead of
+    piling up in memory behind it. Checked before serializing, so a refused upload costs nothing. */
+    if (m_uploadsInFlight < m_maxUploadsInFlight) return true;
+    static Counter &dropped = Metrics::counter("queue_upload_dropped_total", "Uploads refused while others were in flight");
+    dropped.inc();
+    qWarning() << "Upload skipped:" << m_uploadsInFlight << "still in flight";
+    return false;
+}
+
+QNetworkRequest DvClient::erpRequest(const QUrl &url) const
+{
+    QNetworkRequest req(url);
+    req.setRawHeader("Cookie", QByteArray("S=") + sessionId.toUtf8());
+    req.setRawHeader("sys_objects_name", "alperen_test"); //raw header name given as that way to recongnize it is a test device.
+    req.setRawHeader("p_devices_id", devicesID.toUtf8());
+    return req;
+}
+
+Async::Task<bool> DvClient::postLogBody(QByteArray body)
+{
+    if (!uploadSlotFree()) co_return false;
+    SlotHold slot(m_uploadsInFlight);
+    co_return co_await postBody(std::move(body));
+}
+
+Async::Task<bool> DvClient::postBody(QByteArray body, QList<QPair<QByteArray, QByteArray>> headers)
+{/* Writes the JSON body to a temp file and posts it as the multipart "file" field the ERP expects.
+    A file of its own per upload (upload_in_flight may allow several), removed with the reply.
+    True once the ERP accepted it; an upload without an answer after kUploadTimeoutMs is aborted. */
+    auto *multi = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+    auto *filePart = new QTemporaryFile(QCoreApplication::applicationDirPath() + "/logs_temp_XXXXXX.json", multi);
+    if (!filePart->open()) {
+        qWarning() << "Cannot open temp log file";
+        delete multi;
+        co_return false;
+    }
+    Metrics::histogram("upload_bytes", "send_logs body size").record(quint64(body.size()));
+    filePart->write(body);
+    filePart->seek(0);
+    body = QByteArray();   // the frame lives until the answer, the file has it now
+
+    QHttpPart part;
+    part.setHeader(QNetworkRequest::ContentDispositionHeader,
+                   "form-data; name=\"file\"; filename=\"logs_temp.json\"");
+    part.setBodyDevice(filePart);
+    multi->append(part);
+
+    QNetworkRequest req = erpRequest(QUrl("https://devSampllle.san.com.tr/dl/DeviceLogUpload"));// -> Sample Name
+    for (const auto &h : std::as_const(headers))
+        req.setRawHeader(h.first, h.second);
+
+    auto *reply = http.post(req, multi);
+    multi->setParent(reply);   // the file part goes with the reply
+    const Async::HttpResult r = co_await Async::reply(reply, kUploadTimeoutMs);
+    if (!r.ok()) {
+        qWarning() << "Upload failed:" << r.errorString;
+        Metrics::counter("upload_failures_total").inc();
+        co_return false;
+    }
+    qDebug() << "-> Upload Successful";
+    Metrics::counter("uploads_total").inc();
+    co_return true;
+}
+
+QByteArray DvClient::serializeLogs(QSqlDatabase &db, const QStringList &tables)
+{/* SQL reading into the JSON format the ERP log upload expects, partitions in the given order */
+    QStringList parts;
+    for (const QString &t : tables)
+        parts.append(QStringLiteral("SELECT timestamp, level, distance, xn FROM %1").arg(t));
+    QSqlQuery query(parts.join(QStringLiteral(" UNION ALL ")), db);
     QJsonArray logs;
     while (query.next()) {
         QJsonObject e;
@@ -314,42 +900,132 @@ in order for the ERP system to understand. */
         e["Xn_val"]    = query.value(3).toDouble();
         logs.append(e);
     }
+    return QJsonDocument(logs).toJson(QJsonDocument::Compact);
+}
 
-    QString tempFile = QCoreApplication::applicationDirPath() + "/logs_temp.json";
-    QFile f(tempFile);
-    if (!f.open(QIODevice::WriteOnly)) {
-        qWarning() << "Cannot open temp log file";
-        return;
+QByteArray DvClient::serializeLogs(const WarningStore &store, const QVector<WarningPartition> &parts)
+{/* Same body from a list of partitions, whether they are still tables or already in the cold archive */
+    QJsonArray logs;
+    for (const WarningPartition &p : parts) {
+        store.scanPartition(p, QString(), QString(), [&logs](const WarningRow &r) {
+            QJsonObject e;
+            e["timestamp"] = r.timestamp;
+            e["level"]     = r.level;
+            e["distance"]  = r.distance;
+            e["Xn_val"]    = r.xn;
+            logs.append(e);
+        });
     }
-    f.write(QJsonDocument(logs).toJson(QJsonDocument::Compact));
-    f.close();
+    return QJsonDocument(logs).toJson(QJsonDocument::Compact);
+}
 
-    auto *multi = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-    QHttpPart part;
-    part.setHeader(QNetworkRequest::ContentDispositionHeader,
-                   "form-data; name=\"file\"; filename=\"logs_temp.json\"");
-    auto *filePart = new QFile(tempFile);
-    filePart->open(QIODevice::ReadOnly);
-    part.setBodyDevice(filePart);
-    filePart->setParent(multi);
-    multi->append(part);
+QByteArray DvClient::serializeRows(const QVector<WarningRow> &rows)
+{
+    QJsonArray logs;
+    for (const WarningRow &r : rows) {
+        QJsonObject e;
+        e["timestamp"] = r.timestamp;
+        e["level"]     = r.level;
+        e["distance"]  = r.distance;
+        e["Xn_val"]    = r.xn;
+        logs.append(e);
+    }
+    return QJsonDocument(logs).toJson(QJsonDocument::Compact);
+}
 
-    QNetworkRequest req(QUrl("https://devSampllle.san.com.tr/dl/DeviceLogUpload"));// -> Sample Name
-    req.setRawHeader("Cookie", QByteArray("S=") + sessionId.toUtf8());
-    req.setRawHeader("sys_objects_name", "alperen_test"); //raw header name given as that way to recongnize it is a test device.
-    req.setRawHeader("p_devices_id", devicesID.toUtf8());
+QByteArray DvClient::serializeSamples(const SampleJournal &journal, const QVector<SampleJournal::Sample> &samples)
+{
+    QJsonArray out;
+    for (const SampleJournal::Sample &smp : samples) {
+        QJsonObject e;
+        e["seq"]       = qint64(smp.seq);
+        e["timestamp"] = QDateTime::fromMSecsSinceEpoch(smp.tsUs / 1000, QTimeZone::UTC).toString(Qt::ISODateWithMs);
+        e["sensor"]    = journal.portName(smp.port);
+        e["distance"]  = double(smp.value);
+        e["flags"]     = smp.flags;
+        out.append(e);
+    }
+    return QJsonDocument(out).toJson(QJsonDocument::Compact);
+}
 
-    auto *reply = http.post(req, multi);
-    multi->setParent(reply);
-    connect(reply, &QNetworkReply::finished, [reply, filePart, tempFile]() {
-        if (reply->error() != QNetworkReply::NoError)
-            qWarning() << "Upload failed:" << reply->errorString();
-        else
-            qDebug() << "-> Upload Successful";
-        filePart->deleteLater();
-        QFile::remove(tempFile);
-        reply->deleteLater();
+Async::Task<> DvClient::queryWarnings(QJsonObject request)
+{/* Filters: "last_s" or "from"/"to" (ISO), "levels" (array or comma list), "sensor"; paging: "limit", "cursor".
+    The rows go up through the log upload path, the page summary (with the cursor for the next page and
+    the caller's "id") comes back as a "query_result" event on the socket once the upload is answered,
+    so "ok" means the ERP has the rows. */
+    const WarningFilter filter = filterFromRequest(request);
+    const int limit = qBound(1, request.value("limit").toInt(1000), kQueryMaxRows);
+
+    const WarningQuery::Page page = WarningQuery(m_store).page(filter, request.value("cursor").toString(), limit);
+    QJsonObject result;
+    result["id"]   = request.value("id");
+    result["ok"]   = page.ok && (page.rows.isEmpty() || co_await postLogBody(serializeRows(page.rows)));
+    result["rows"] = int(page.rows.size());
+    result["next"] = page.next;
+    qInfo() << "==> Query:" << page.rows.size() << "warnings" << (page.next.isEmpty() ? "" : "(more)");
+    socket.sendTextMessage("42" + QJsonDocument(QJsonArray{ QStringLiteral("query_result"), result }).toJson(QJsonDocument::Compact));
+}
+
+Async::Task<> DvClient::historyStats(QJsonObject request)
+{/* Same filters as query_warnings, answered with the HistoryStats of every matching row as a "stats_result"
+    event. The scan runs on m_scan's pool; this flow only waits for it, so the link and the sensors keep going. */
+    QElapsedTimer timer;
+    timer.start();
+    QFutureWatcher<ScanResult<HistoryStats>> watcher;
+    watcher.setFuture(m_scan.statsAsync(filterFromRequest(request)));
+    if (!watcher.isFinished())
+        co_await Async::signal(&watcher, &QFutureWatcherBase::finished);
+    const ScanResult<HistoryStats> r = watcher.result();
+    QJsonObject result = r.value.toJson();
+    result["id"]     = request.value("id");
+    result["ok"]     = r.ok();
+    result["ranges"] = r.ranges;
+    result["ms"]     = timer.elapsed();
+    qInfo() << "==> History stats:" << r.value.rows << "rows in" << timer.elapsed() << "ms over" << r.ranges
+            << "ranges," << m_scan.threads() << "threads" << (r.ok() ? "" : "(incomplete)");
+    socket.sendTextMessage("42" + QJsonDocument(QJsonArray{ QStringLiteral("stats_result"), result }).toJson(QJsonDocument::Compact));
+}
+
+Async::Task<> DvClient::archiveLoop()
+{/* The cold archive off the insert path: reading, encoding and verifying a day of rows runs on m_scan's
+    pool with a connection of its own, only the catalog update and the DROP TABLE come back to this thread */
+    for (;;) {
+        for (const WarningPartition &p : m_store.archiveCandidates()) {
+            const QString dbPath = m_store.path();
+            const QString file = m_store.archiveFileFor(p);
+            QFutureWatcher<bool> watcher;
+            watcher.setFuture(QtConcurrent::run(&m_scan.pool(), [dbPath, p, file]() {
+                ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Background);
+                QString error;
+                const bool ok = WarningStore::buildArchive(dbPath, p, file, &error);
+                if (!ok) qWarning() << "Partition" << p.table << "not archived:" << error;
+                return ok;
+            }));
+            if (!watcher.isFinished())
+                co_await Async::signal(&watcher, &QFutureWatcherBase::finished);
+            if (watcher.result()) m_store.commitArchive(p, file);
+        }
+        co_await Async::sleep(kArchiveCheckMs);
+    }
+}
+
+bool DvClient::replayWarnings(const QString &fromTs, const QString &toTs, double speed, bool upload)
+{/* The replayer goes through newWarning, so the table/graph in the UI show the incident again exactly
+    like they did live. Nothing is written back to the DB. */
+    auto *replayer = new WarningReplayer(m_store, fromTs, toTs, speed, this);
+    connect(replayer, &WarningReplayer::warningReplayed, this, &DvClient::newWarning);
+    connect(replayer, &WarningReplayer::finished, this, [this, replayer, upload](int rowCount) {
+        qInfo() << "==> Replayed" << rowCount << "warnings";
+        if (upload && rowCount > 0)
+            m_flows.spawn(sendRows(replayer->rows()));
+        replayer->deleteLater();
     });
+    if (!replayer->start()) {
+        qWarning() << "Replay query failed";
+        replayer->deleteLater();
+        return false;
+    }
+    return true;
 }
 
 QPair<QString, QString> DvClient::getNetworkInfo()
@@ -408,6 +1084,10 @@ void DvClient::rebootComPorts()
 void DvClient::comUseIdle() { if (m_portManager) m_portManager->setModeIdle(); }// Setting the code on Idle, which also starts the code as well on Idle state
 void DvClient::comUseSimulationOnly() { if (m_portManager) m_portManager->setModeSimulation(); } // Use the simulation value.
 
+void DvClient::comUseReplay(const QStringList &files, double speed) { if (m_portManager) m_portManager->setModeReplay(files, speed); }
+void DvClient::setSimulationConfig(const SimulationConfig &cfg) { if (m_portManager) m_portManager->setSimulationConfig(cfg); }
+void DvClient::setCaptureDirectory(const QString &dir) { if (m_portManager) m_portManager->setCaptureDirectory(dir); }
+
 void DvClient::comUseSinglePort(const QString &p)
 {/*Setting for single Port usage send with the setted version, we can start to read from the port and generate our threads according to that. */
     if (m_portManager)
@@ -12,8 +12,24 @@
 #include <QHttpMultiPart>
 #include <QPair>
 #include <QStringList>
+#include "warningstore.h"
+#include "samplejournal.h"
+#include "warningdetector.h"
+#include "heartbeat.h"
+#include "boundedqueue.h"
+#include "samplesource.h"
+#include <QHash>
+#include "async.h"
+#include "warningscan.h"
+#include "uploadmanifest.h"
+#include <QElapsedTimer>
 
 class ComPortManager;
+class ShmExport;
+class QSettings;
+class QJsonObject;
+class MetricsServer;
+struct SimulationConfig;
 
 class DvClient : public QObject
 {
@@ -23,14 +39,32 @@ public:
     explicit DvClient(QObject *parent = nullptr);
     ~DvClient() override;
 
+    // qtalp.ini, shared by both entry points: process wide groups before any thread starts, then the client's
+    static void configureProcess(QSettings &cfg);   // [sched] and [log]
+    bool configure(QSettings &cfg);                  // [storage] and the database, then every other group; false without a database
     bool initDatabase();
+    bool openJournal(QSettings &cfg);   // [journal] raw samples at full rate, feeds the rollups and send_samples
+    bool openShmExport(QSettings &cfg); // [shm] live samples and warnings for other local processes
+    void configureQueues(QSettings &cfg); // [queues] bounds and policies of the ingest and store stages
+    void configureSerial(QSettings &cfg); // [serial] framing, single value or channel-tagged lines, or binary frames
+    void configureUploads(QSettings &cfg); // [upload] send_logs as content-addressed chunks, only the ones the ERP lacks
 
     void start();
-    void updateDistance(float distance);
+    void updateDistance(const QString &port, float distance);
+    void updateDistances(const QString &port, const QVector<SourceSample> &batch);
     void setCOMSentinel(int value);
     void uploadLogFile();
+    void uploadSamples();
+    bool storeBackpressure() const;     // store queue full under Block: stop draining the ingest queues
 
-    QSqlDatabase& database() { return db; }
+    QSqlDatabase& database() { return m_store.database(); }
+    WarningStore& store() { return m_store; }
+
+    // Upload body: the whole warnings table as a compact JSON array
+    static QByteArray serializeLogs(QSqlDatabase &db, const QStringList &tables = { QStringLiteral("warnings") });
+    static QByteArray serializeLogs(const WarningStore &store, const QVector<WarningPartition> &parts);
+    static QByteArray serializeRows(const QVector<WarningRow> &rows);   // same keys, for replayed ranges
+    static QByteArray serializeSamples(const SampleJournal &journal, const QVector<SampleJournal::Sample> &samples);
 
     // COM selection helpers for UI
     QStringList serialPorts() const;                  // list available ports
@@ -42,32 +76,77 @@ public slots:
     void requestParameters();
     void resetDatabase();
     void rebootComPorts();
+    QString dumpTrace();
 
     // Modes
     void comUseIdle();
     void comUseSimulationOnly();
     void comUseSinglePort(const QString &portName);
+    void comUseReplay(const QStringList &captureFiles, double speed);
+    void setCaptureDirectory(const QString &dir);
+    void setSimulationConfig(const SimulationConfig &cfg);
+    void setDetectorConfig(const DetectorConfig &cfg) { m_detector.setConfig(cfg); }
+    void setHeartbeatConfig(const HeartbeatConfig &cfg) { m_heartbeat.setConfig(cfg); }
+
+    // Re-emit stored warnings in [fromTs, toTs) as newWarning, optionally re-uploading them afterwards
+    bool replayWarnings(const QString &fromTs, const QString &toTs, double speed, bool upload);
 
 signals:
     void newWarning(const QString &timestamp, const QString &level, double distance, double xn);
+    void sampleReceived(const QString &port, qint64 msecs, double distance); // every reading, for live views
+    void serialPortsChanged(const QStringList &ports);                     // background port scan found a new list
 
 private slots:
-    void onHttpFinished(QNetworkReply *reply);
     void onSocketTextMessageReceived(const QString &msg);
     void onSocketError(QAbstractSocket::SocketError error);
     void onPingTimeout();
+    void onJournalTimer();
+    void onFallbackSample();
 
 private:
     QString buildDvOpUrl(const QString &session);
     QPair<QString, QString> getNetworkInfo();
     void loadSession();
     void saveSession();
+    // ERP link and upload flows, run as coroutines in m_flows (async.h); parameters are taken by value
+    Async::Task<> runLink();
+    Async::Task<bool> openSession();
+    Async::Task<bool> connectSocket();
+    Async::Task<bool> postLogBody(QByteArray body);   // takes an upload slot for the post
+    Async::Task<bool> postBody(QByteArray body, QList<QPair<QByteArray, QByteArray>> headers = {});   // caller holds the slot
+    Async::Task<> sendLogs();
+    Async::Task<bool> sendWholeLog(QVector<WarningPartition> parts);
+    Async::Task<bool> sendLogChunks(QVector<WarningPartition> parts);
+    QNetworkRequest erpRequest(const QUrl &url) const;   // with the session cookie and device headers
+    Async::Task<> sendSamples();
+    Async::Task<> sendRows(QVector<WarningRow> rows);
+    Async::Task<> queryWarnings(QJsonObject request);
+    Async::Task<> historyStats(QJsonObject request);
+    Async::Task<> archiveLoop();
+    bool uploadSlotFree();
+    void recordSample(const QString &port, qint64 tsUs, float distance);   // journal and shared memory
+    void detect(const QString &port, qint64 tsUs, float distance, QVector<WarningRow> &rows);
+    void storeWarnings(const QVector<WarningRow> &rows);
+    void flushPendingRows(bool measure = false);
 
     QNetworkAccessManager http;
     QWebSocket socket;
-    QTimer pingTimer;
-    QSqlDatabase db;
-    ComPortManager *m_portManager;
+    QTimer pingTimer;                    // single shot, re-armed with m_heartbeat's interval
+    WarningStore m_store;
+    MetricsServer  *m_metricsServer = nullptr;   // [metrics] http_enabled
+    ComPortManager *m_portManager = nullptr;   // made last in the constructor, it calls back into this
+    SampleJournal *m_journal = nullptr;
+    ShmExport *m_shm = nullptr;
+    QTimer journalTimer;                 // flushes the journal and folds new samples into the rollups
+    QTimer fallbackTimer;                // one random "Simulation" reading every 5 s while no source is open
+    WarningDetector m_detector;
+    BoundedQueue<WarningRow> m_pendingRows;   // "store" stage: detected rows not in SQLite yet
+    QTimer storeRetryTimer;              // retries m_pendingRows after a failed insert
+    int m_uploadsInFlight = 0;
+    bool m_sendingLogs = false;          // a send_logs flow is running, from planning to its last chunk
+    bool m_sendingSamples = false;       // a send_samples flow is running; both read and move a cursor
+    int m_maxUploadsInFlight = 1;        // [queues] upload_in_flight
+    QHash<QString, QVector<QString>> m_channelSensors;   // port -> sensor id per tagged channel, "<port>#<channel>"
 
     QString sessionId;
     QString corpsID;
@@ -78,7 +157,13 @@ private:
     bool registered = false;
     int ErrorSimulationSentinelVal = 0;
     int comSentinel = 0;
-    float currentDistance = 0;
+    Heartbeat m_heartbeat;               // ping numbering, RTT estimate and the adaptive interval
+    QElapsedTimer m_linkClock;           // monotonic time base for m_heartbeat
+    WarningScan m_scan{ m_store };       // history_stats: parallel read-only scans over m_store's file
+    UploadManifest m_manifest{ m_store }; // chunks of send_logs the ERP has acknowledged
+    bool m_chunkedUploads = false;       // [upload] chunked
+
+    Async::Scope m_flows;                // last member: cancelled before anything the flows use goes away
 };
 
 #endif // DVCLIENT_H
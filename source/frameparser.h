@@ -0,0 +1,183 @@
+#ifndef FRAMEPARSER_H
+#define FRAMEPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QtEndian>
+#include <cstring>
+
+class FrameParser
+{/* Serial framing, split out of ComThread so it can be driven without a port (benchmarks, replay).
+    One port can carry several sensors, each on its own channel 0..kMaxChannels-1.
+
+    Text framing, one frame per '\n' terminated line:
+        0.37                    a single value without channel (kNoChannel): the port itself is the sensor
+        0:12.5,1:80.25,3:7.75   channel-tagged values, separated by ',' ';' ' ' or '\t'
+    Binary framing, 7 bytes per value, resynchronised on the sync byte after garbage:
+        0xA5 <channel> <float32 little endian> <XOR of channel and the four value bytes>
+
+    Values are reported with their channel number as they are parsed; the consumer maps the number to a
+    sensor through an array, so the work per byte is the same for one channel or 256. Whatever follows
+    the last complete frame waits for the next chunk. */
+public:
+    enum class Framing { Text, Binary };
+    static constexpr int   kNoChannel = -1;
+    static constexpr int   kMaxChannels = 256;
+    static constexpr uchar kBinarySync = 0xA5;
+    static constexpr int   kBinaryFrameSize = 7;
+    static constexpr int   kMaxLine = 4096;   // a longer text line without '\n' is dropped as an error
+
+    explicit FrameParser(Framing framing = Framing::Text) : m_framing(framing) {}
+
+    void setFraming(Framing framing) { m_framing = framing; m_buffer.resize(0); }
+    Framing framing() const { return m_framing; }
+
+    // onValue(int channel, float value) per value; onError(const QByteArray &frame) per bad line, or per
+    // run of bytes skipped to find the next binary frame
+    template <typename OnValue, typename OnError>
+    void feed(QByteArrayView chunk, OnValue &&onValue, OnError &&onError);
+
+    void reset() { m_buffer.resize(0); }
+    qsizetype pending() const { return m_buffer.size(); }
+
+    static QByteArray binaryFrame(int channel, float value);
+    static bool parseFraming(const QString &name, Framing &out);   // "text", "binary"
+    static QString framingName(Framing framing);
+
+private:
+    template <typename OnValue, typename OnError>
+    void textLine(QByteArrayView line, OnValue &onValue, OnError &onError);
+    template <typename OnValue, typename OnError>
+    qsizetype binaryFrames(QByteArrayView data, OnValue &onValue, OnError &onError);
+
+    Framing    m_framing;
+    QByteArray m_buffer;   // incomplete frame from the previous chunk
+};
+
+template <typename OnValue, typename OnError>
+void FrameParser::feed(QByteArrayView chunk, OnValue &&onValue, OnError &&onError)
+{
+    if (m_framing == Framing::Binary) {
+        // The chunk is only copied while a partial frame (at most 6 bytes) is waiting in front of it
+        if (m_buffer.isEmpty()) {
+            const qsizetype used = binaryFrames(chunk, onValue, onError);
+            m_buffer.append(chunk.data() + used, chunk.size() - used);
+        } else {
+            m_buffer.append(chunk);
+            m_buffer.remove(0, binaryFrames(m_buffer, onValue, onError));
+        }
+        return;
+    }
+
+    // Text: complete lines are parsed in place, only the unterminated tail is kept
+    const char *p = chunk.data();
+    const char *const end = p + chunk.size();
+    while (p < end) {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        if (!nl) {
+            m_buffer.append(p, end - p);
+            if (m_buffer.size() > kMaxLine) {
+                onError(m_buffer);
+                m_buffer.resize(0);
+            }
+            return;
+        }
+        if (m_buffer.isEmpty()) {
+            textLine(QByteArrayView(p, nl - p), onValue, onError);
+        } else {
+            m_buffer.append(p, nl - p);
+            textLine(m_buffer, onValue, onError);
+            m_buffer.resize(0);
+        }
+        p = nl + 1;
+    }
+}
+
+template <typename OnValue, typename OnError>
+void FrameParser::textLine(QByteArrayView line, OnValue &onValue, OnError &onError)
+{
+    line = line.trimmed();
+    bool ok = false;
+    if (line.indexOf(':') < 0) {
+        const float value = line.toFloat(&ok);
+        if (ok) onValue(kNoChannel, value);
+        else    onError(line.toByteArray());
+        return;
+    }
+    bool bad = false;
+    qsizetype i = 0;
+    while (i < line.size()) {
+        qsizetype j = i;
+        while (j < line.size() && line[j] != ',' && line[j] != ';' && line[j] != ' ' && line[j] != '\t') ++j;
+        if (j > i) {
+            const QByteArrayView entry = line.sliced(i, j - i);
+            int channel = 0;
+            qsizetype k = 0;
+            while (k < entry.size() && entry[k] >= '0' && entry[k] <= '9' && channel < kMaxChannels)
+                channel = channel * 10 + (entry[k++] - '0');
+            ok = k > 0 && k < entry.size() && entry[k] == ':' && channel < kMaxChannels;
+            const float value = ok ? entry.sliced(k + 1).toFloat(&ok) : 0.0f;
+            if (ok) onValue(channel, value);
+            else    bad = true;
+        }
+        i = j + 1;
+    }
+    if (bad) onError(line.toByteArray());   // the good values of the line still count
+}
+
+template <typename OnValue, typename OnError>
+qsizetype FrameParser::binaryFrames(QByteArrayView data, OnValue &onValue, OnError &onError)
+{/* Returns how many bytes were used up; the rest starts with a sync byte and is shorter than a frame */
+    const uchar *d = reinterpret_cast<const uchar *>(data.data());
+    const qsizetype n = data.size();
+    qsizetype i = 0, skipped = -1;   // start of the garbage run being skipped
+    auto flushSkipped = [&]() {
+        if (skipped < 0) return;
+        onError(data.sliced(skipped, i - skipped).toByteArray());
+        skipped = -1;
+    };
+    while (n - i >= kBinaryFrameSize) {
+        const uchar *f = d + i;
+        if (f[0] == kBinarySync && uchar(f[1] ^ f[2] ^ f[3] ^ f[4] ^ f[5]) == f[6]) {
+            flushSkipped();
+            onValue(int(f[1]), qFromLittleEndian<float>(f + 2));
+            i += kBinaryFrameSize;
+        } else {
+            if (skipped < 0) skipped = i;
+            ++i;
+        }
+    }
+    while (i < n && d[i] != kBinarySync) {
+        if (skipped < 0) skipped = i;
+        ++i;
+    }
+    flushSkipped();
+    return i;
+}
+
+inline QByteArray FrameParser::binaryFrame(int channel, float value)
+{
+    QByteArray f(kBinaryFrameSize, '\0');
+    uchar *d = reinterpret_cast<uchar *>(f.data());
+    d[0] = kBinarySync;
+    d[1] = uchar(channel);
+    qToLittleEndian<float>(value, d + 2);
+    d[6] = uchar(d[1] ^ d[2] ^ d[3] ^ d[4] ^ d[5]);
+    return f;
+}
+
+inline bool FrameParser::parseFraming(const QString &name, Framing &out)
+{
+    const QString n = name.trimmed().toLower();
+    if (n == QLatin1String("text"))   { out = Framing::Text;   return true; }
+    if (n == QLatin1String("binary")) { out = Framing::Binary; return true; }
+    return false;
+}
+
+inline QString FrameParser::framingName(Framing framing)
+{
+    return framing == Framing::Binary ? QStringLiteral("binary") : QStringLiteral("text");
+}
+
+#endif // FRAMEPARSER_H
@@ -0,0 +1,151 @@
+#include "heartbeat.h"
+#include "metrics.h"
+#include <QSettings>
+#include <QJsonValue>
+
+namespace {
+constexpr int kMaxPending = 64;   // expire() normally keeps it far below this
+constexpr int kWarmupPongs = 3;   // the first variance is rtt/2 by definition, judge jitter after a few more
+
+Histogram &rttHistogram()
+{
+    static Histogram &h = Metrics::histogram("heartbeat_rtt_us", "ping to pong round trip");
+    return h;
+}
+
+Gauge &intervalGauge()
+{
+    static Gauge &g = Metrics::gauge("heartbeat_interval_ms", "current ping interval");
+    return g;
+}
+
+QString ms(qint64 us)
+{
+    return QString::number(double(us) / 1000.0, 'f', 1) + QStringLiteral(" ms");
+}
+}
+
+HeartbeatConfig HeartbeatConfig::fromSettings(QSettings &cfg)
+{
+    HeartbeatConfig c;
+    c.minMs         = qMax(100, cfg.value("heartbeat/min_ms", c.minMs).toInt());
+    c.maxMs         = qMax(c.minMs, cfg.value("heartbeat/max_ms", c.maxMs).toInt());
+    c.initialMs     = qBound(c.minMs, cfg.value("heartbeat/initial_ms", c.initialMs).toInt(), c.maxMs);
+    c.timeoutMs     = qMax(100, cfg.value("heartbeat/timeout_ms", c.timeoutMs).toInt());
+    c.backoff       = qMax(1.0, cfg.value("heartbeat/backoff", c.backoff).toDouble());
+    c.rttHighMs     = qMax(1, cfg.value("heartbeat/rtt_high_ms", c.rttHighMs).toInt());
+    c.jitterRatio   = qMax(0.0, cfg.value("heartbeat/jitter_ratio", c.jitterRatio).toDouble());
+    c.jitterFloorMs = qMax(0, cfg.value("heartbeat/jitter_floor_ms", c.jitterFloorMs).toInt());
+    return c;
+}
+
+Heartbeat::Heartbeat(const HeartbeatConfig &cfg)
+    : m_cfg(cfg)
+    , m_intervalMs(cfg.initialMs)
+{
+}
+
+void Heartbeat::setConfig(const HeartbeatConfig &cfg)
+{
+    m_cfg = cfg;
+    m_intervalMs = qBound(cfg.minMs, m_intervalMs, cfg.maxMs);
+}
+
+void Heartbeat::reset()
+{
+    m_pending.clear();
+    m_srttUs = m_rttvarUs = 0;
+    m_samples = 0;
+    m_intervalMs = m_cfg.initialMs;
+    intervalGauge().set(m_intervalMs);
+}
+
+QByteArray Heartbeat::ping(qint64 nowUs)
+{
+    static Counter &pings = Metrics::counter("heartbeat_pings_total", "pings sent to the ERP");
+    const quint32 seq = m_nextSeq++;
+    if (m_pending.size() >= kMaxPending) m_pending.removeFirst();
+    m_pending.append({ seq, nowUs });
+    pings.inc();
+    return "42[\"ping\",{\"seq\":" + QByteArray::number(seq) + "}]";
+}
+
+qint64 Heartbeat::pong(const QJsonObject &payload, qint64 nowUs)
+{/* The link is one ordered stream, so pings older than the one answered will not be answered any more */
+    static Counter &unmatched = Metrics::counter("heartbeat_unmatched_total", "pongs without an outstanding ping");
+    static Counter &lost = Metrics::counter("heartbeat_lost_total", "pings never answered");
+    static Gauge &srtt = Metrics::gauge("heartbeat_srtt_us", "smoothed ping RTT");
+    static Gauge &rttvar = Metrics::gauge("heartbeat_rttvar_us", "ping RTT variance");
+    int idx = -1;
+    const QJsonValue seq = payload.value(QStringLiteral("seq"));
+    if (seq.isDouble()) {
+        for (int i = 0; i < m_pending.size() && idx < 0; ++i)
+            if (m_pending.at(i).seq == quint32(seq.toInteger())) idx = i;
+    } else if (!m_pending.isEmpty()) {
+        idx = 0;
+    }
+    if (idx < 0) {
+        unmatched.inc();
+        return -1;
+    }
+    const qint64 rtt = qMax<qint64>(0, nowUs - m_pending.at(idx).sentUs);
+    if (idx > 0) {
+        m_lost += quint64(idx);
+        lost.inc(quint64(idx));
+    }
+    m_pending.remove(0, idx + 1);
+
+    if (m_samples++ == 0) {
+        m_srttUs   = rtt;
+        m_rttvarUs = rtt / 2;
+    } else {
+        m_rttvarUs = (3 * m_rttvarUs + qAbs(m_srttUs - rtt)) / 4;
+        m_srttUs   = (7 * m_srttUs + rtt) / 8;
+    }
+    rttHistogram().record(quint64(rtt));
+    srtt.set(m_srttUs);
+    rttvar.set(m_rttvarUs);
+    adapt(degraded());
+    return rtt;
+}
+
+int Heartbeat::expire(qint64 nowUs)
+{
+    static Counter &lost = Metrics::counter("heartbeat_lost_total", "pings never answered");
+    const qint64 limitUs = qint64(m_cfg.timeoutMs) * 1000;
+    int n = 0;
+    while (n < m_pending.size() && nowUs - m_pending.at(n).sentUs >= limitUs) ++n;
+    if (n == 0) return 0;
+    m_pending.remove(0, n);
+    m_lost += quint64(n);
+    lost.inc(quint64(n));
+    m_intervalMs = m_cfg.minMs;   // probe quickly until pongs come back
+    intervalGauge().set(m_intervalMs);
+    return n;
+}
+
+bool Heartbeat::degraded() const
+{
+    if (m_samples == 0) return false;
+    if (m_srttUs > qint64(m_cfg.rttHighMs) * 1000) return true;
+    const double jitterLimitUs = qMax(m_cfg.jitterRatio * double(m_srttUs), double(m_cfg.jitterFloorMs) * 1000.0);
+    return m_samples >= quint64(kWarmupPongs) && double(m_rttvarUs) > jitterLimitUs;
+}
+
+void Heartbeat::adapt(bool degradedNow)
+{
+    if (degradedNow) m_intervalMs = qMax(m_cfg.minMs, m_intervalMs / 2);
+    else             m_intervalMs = qMin(m_cfg.maxMs, qMax(m_intervalMs + 1, int(m_intervalMs * m_cfg.backoff)));
+    intervalGauge().set(m_intervalMs);
+}
+
+QStringList Heartbeat::summaryLines() const
+{
+    QStringList lines;
+    lines << QStringLiteral("interval %1 ms (%2..%3), %4").arg(m_intervalMs).arg(m_cfg.minMs).arg(m_cfg.maxMs)
+                 .arg(degraded() ? QStringLiteral("degraded") : QStringLiteral("steady"));
+    lines << (m_samples == 0 ? QStringLiteral("rtt unknown")
+                             : QStringLiteral("srtt %1, rttvar %2").arg(ms(m_srttUs), ms(m_rttvarUs)));
+    lines << QStringLiteral("outstanding %1, lost %2").arg(outstanding()).arg(m_lost);
+    return lines;
+}
@@ -0,0 +1,65 @@
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QStringList>
+#include <QVector>
+
+class QSettings;
+
+struct HeartbeatConfig
+{/* [heartbeat] group of qtalp.ini. The interval starts at initial_ms, grows by backoff after every pong on
+    a steady link up to max_ms, and is halved (down to min_ms) when the RTT gets high or jittery; a lost
+    ping drops it to min_ms at once. */
+    int    initialMs   = 5000;
+    int    minMs       = 2000;
+    int    maxMs       = 30000;    // stay well below the ERP's session idle timeout
+    int    timeoutMs   = 10000;    // a ping without pong after this long is counted as lost, and pinged again
+    double backoff     = 1.25;
+    int    rttHighMs   = 1000;     // smoothed RTT above this is "degraded"
+    double jitterRatio = 0.25;     // so is an RTT variance above this fraction of the smoothed RTT...
+    int    jitterFloorMs = 20;     // ...and above this many ms, so LAN-level wobble does not count
+
+    static HeartbeatConfig fromSettings(QSettings &cfg);
+};
+
+class Heartbeat
+{/* The ERP link's application ping: numbers every ping, matches pongs to them, keeps a smoothed RTT and
+    RTT variance (RFC 6298 estimator) and picks the next interval from them. Like WarningDetector it has no
+    clock of its own, the caller passes monotonic microseconds, which keeps it deterministic for the bench. */
+public:
+    explicit Heartbeat(const HeartbeatConfig &cfg = HeartbeatConfig());
+    void setConfig(const HeartbeatConfig &cfg);
+    const HeartbeatConfig &config() const { return m_cfg; }
+
+    void reset();                              // new connection: RTT unknown, initial interval
+    QByteArray ping(qint64 nowUs);             // next ping frame, 42["ping",{"seq":n}]
+    // A pong echoing "seq" answers that ping, one without it the oldest outstanding one.
+    // Returns the RTT in microseconds, or -1 if nothing was outstanding (late or unsolicited pong).
+    qint64 pong(const QJsonObject &payload, qint64 nowUs);
+    int expire(qint64 nowUs);                  // outstanding pings older than timeoutMs, now counted as lost
+
+    int     intervalMs() const { return m_intervalMs; }
+    qint64  srttUs() const { return m_srttUs; }        // 0 until the first pong
+    qint64  rttvarUs() const { return m_rttvarUs; }
+    int     outstanding() const { return int(m_pending.size()); }
+    quint64 lost() const { return m_lost; }
+    bool    degraded() const;
+    QStringList summaryLines() const;          // for get_d_parameters
+
+private:
+    struct Pending { quint32 seq; qint64 sentUs; };
+    void adapt(bool degradedNow);
+
+    HeartbeatConfig  m_cfg;
+    QVector<Pending> m_pending;                // in send order
+    quint32 m_nextSeq = 1;
+    qint64  m_srttUs = 0;
+    qint64  m_rttvarUs = 0;
+    quint64 m_samples = 0;                     // pongs matched since reset()
+    int     m_intervalMs;
+    quint64 m_lost = 0;
+};
+
+#endif // HEARTBEAT_H
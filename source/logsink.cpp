@@ -0,0 +1,234 @@
+#include "logsink.h"
+#include "threadscheduling.h"
+#include <QCoreApplication>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+namespace {
+constexpr int kUiRingCapacity   = 8192;  // records waiting for the GUI timer
+constexpr int kFileRingCapacity = 16384; // records waiting for the file writer
+constexpr int kWriterIdleMs     = 50;
+
+int roundUpPow2(int v)
+{
+    int p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+}
+
+/*######## LogRing ########*/
+LogRing::LogRing(int capacity)
+{/* Classic sequence-numbered bounded queue: every slot carries the position it expects next,
+    so producers only need one CAS on the head to claim a slot. */
+    const int cap = roundUpPow2(capacity);
+    m_slots.reset(new Slot[cap]);
+    m_mask = quint64(cap - 1);
+    for (int i = 0; i < cap; ++i)
+        m_slots[i].seq.store(quint64(i), std::memory_order_relaxed);
+}
+
+bool LogRing::push(LogRecord &&rec)
+{
+    quint64 pos = m_head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+        const quint64 seq = slot->seq.load(std::memory_order_acquire);
+        const qint64 diff = qint64(seq) - qint64(pos);
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {// full, the consumer has not caught up
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+    slot->rec = std::move(rec);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogRing::pop(LogRecord &out)
+{
+    Slot &slot = m_slots[m_tail & m_mask];
+    if (slot.seq.load(std::memory_order_acquire) != m_tail + 1)
+        return false;
+    out = std::move(slot.rec);
+    slot.rec.message = QString();
+    slot.seq.store(m_tail + m_mask + 1, std::memory_order_release);
+    ++m_tail;
+    return true;
+}
+
+/*######## LogFileWriter ########*/
+LogFileWriter::LogFileWriter(const QString &path, qint64 maxBytes, int maxFiles, QObject *parent)
+    : QThread(parent), m_path(path), m_maxBytes(maxBytes), m_maxFiles(qMax(1, maxFiles)), m_ring(kFileRingCapacity)
+{
+    setObjectName(QStringLiteral("LogFileWriter"));
+}
+
+LogFileWriter::~LogFileWriter()
+{
+    stop();
+    wait();
+}
+
+void LogFileWriter::stop()
+{
+    m_running = false;
+}
+
+void LogFileWriter::rotate()
+{/* app.log -> app.log.1 -> ... -> app.log.N, the oldest one falls off the end */
+    QFile::remove(QStringLiteral("%1.%2").arg(m_path).arg(m_maxFiles));
+    for (int i = m_maxFiles - 1; i >= 1; --i)
+        QFile::rename(QStringLiteral("%1.%2").arg(m_path).arg(i), QStringLiteral("%1.%2").arg(m_path).arg(i + 1));
+    QFile::rename(m_path, m_path + ".1");
+}
+
+void LogFileWriter::run()
+{
+    ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Background);
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        return; // nowhere to write, the UI ring still gets everything
+
+    LogRecord rec;
+    QByteArray line;
+    // Drain whatever is left after stop() so the last lines before a shutdown are not lost
+    for (;;) {
+        bool wrote = false;
+        while (m_ring.pop(rec)) {
+            line = QStringLiteral("[%1] [%2] %3%4\n")
+                       .arg(double(rec.monoNs) / 1e9, 0, 'f', 6)
+                       .arg(rec.threadId, 0, 16)
+                       .arg(LogSink::prefix(rec.type), rec.message)
+                       .toUtf8();
+            file.write(line);
+            wrote = true;
+            if (m_maxBytes > 0 && file.size() >= m_maxBytes) {
+                file.close();
+                rotate();
+                file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+            }
+        }
+        if (wrote) file.flush();
+        if (!m_running) break;
+        msleep(kWriterIdleMs);
+    }
+    file.close();
+}
+
+/*######## LogSink ########*/
+LogSink::LogSink()
+    : m_uiRing(kUiRingCapacity)
+{
+    m_clock.start();
+}
+
+LogSink &LogSink::instance()
+{
+    static LogSink sink;
+    return sink;
+}
+
+void LogSink::install()
+{/* Installed once for the whole process; every thread that logs ends up in LogSink::push */
+    instance();
+    qInstallMessageHandler(&LogSink::messageHandler);
+}
+
+void LogSink::uninstall()
+{
+    qInstallMessageHandler(nullptr);
+}
+
+void LogSink::configure(const QSettings &settings)
+{/* [log] group of qtalp.ini, the file sink is off unless asked for. */
+    if (!settings.value("log/file_enabled", false).toBool())
+        return;
+    const QString path = settings.value("log/file_path", QCoreApplication::applicationDirPath() + "/logs/qtalp.log").toString();
+    const qint64 maxBytes = settings.value("log/file_max_bytes", 4 * 1024 * 1024).toLongLong();
+    const int maxFiles = settings.value("log/file_max_files", 5).toInt();
+    enableFileSink(path, maxBytes, maxFiles);
+}
+
+void LogSink::enableFileSink(const QString &path, qint64 maxBytes, int maxFiles)
+{
+    auto *writer = new LogFileWriter(path, maxBytes, maxFiles);
+    writer->start(QThread::LowPriority);
+    replaceFileWriter(writer);
+}
+
+void LogSink::shutdown()
+{/* Called from main() after the event loop ends, before statics are torn down. */
+    uninstall();
+    replaceFileWriter(nullptr);
+}
+
+void LogSink::replaceFileWriter(LogFileWriter *next)
+{/* The old writer is freed only once no push() can still be using it: a push that loaded it counted
+    itself in m_pushing first, and every push that starts after the exchange sees the new one. Deleting
+    it stops its thread after the ring is written out. */
+    LogFileWriter *old = m_fileWriter.exchange(next);
+    if (!old) return;
+    while (m_pushing.load() != 0)
+        QThread::yieldCurrentThread();
+    delete old;
+}
+
+void LogSink::push(QtMsgType type, const QString &msg)
+{
+    LogRecord rec;
+    rec.type     = type;
+    rec.monoNs   = m_clock.nsecsElapsed();
+    rec.threadId = quintptr(QThread::currentThreadId());
+    rec.message  = msg;
+
+    m_pushing.fetch_add(1);
+    if (LogFileWriter *writer = m_fileWriter.load()) {
+        LogRecord copy = rec;
+        writer->ring().push(std::move(copy));
+    }
+    m_pushing.fetch_sub(1);
+    m_uiRing.push(std::move(rec));
+}
+
+int LogSink::drain(QVector<LogRecord> &out, int maxRecords)
+{/* GUI thread only */
+    int n = 0;
+    LogRecord rec;
+    while (n < maxRecords && m_uiRing.pop(rec)) {
+        out.append(std::move(rec));
+        ++n;
+    }
+    return n;
+}
+
+QString LogSink::prefix(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:    return QStringLiteral("DEBUG: ");
+    case QtWarningMsg:  return QStringLiteral("WARNING: ");
+    case QtCriticalMsg: return QStringLiteral("CRITICAL: ");
+    case QtFatalMsg:    return QStringLiteral("FATAL: ");
+    default:            return QString();
+    }
+}
+
+void LogSink::messageHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+{/* Qt aborts right after a fatal message returns from here: the file writer is stopped first, which
+    writes its ring out, fatal line included (unless the writer thread itself is the one dying) */
+    LogSink &sink = instance();
+    sink.push(type, msg);
+    if (type != QtFatalMsg) return;
+    LogFileWriter *writer = sink.m_fileWriter.load();
+    if (writer && QThread::currentThread() != writer)
+        sink.replaceFileWriter(nullptr);
+}
@@ -0,0 +1,100 @@
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QThread>
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+
+class QSettings;
+
+/* One captured qDebug/qInfo/qWarning call. The timestamp is monotonic (ns since the sink was created),
+   so ordering stays correct even if the wall clock jumps on the device. */
+struct LogRecord {
+    QtMsgType type     = QtDebugMsg;
+    qint64    monoNs   = 0;
+    quintptr  threadId = 0;
+    QString   message;
+};
+
+class LogRing
+{/* Bounded lock-free ring: any thread may push, exactly one thread pops.
+    When it is full the newest record is dropped and counted, producers never wait. */
+public:
+    explicit LogRing(int capacity);
+
+    bool push(LogRecord &&rec);
+    bool pop(LogRecord &out);
+    quint64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<quint64> seq{0};
+        LogRecord rec;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    quint64 m_mask = 0;
+    alignas(64) std::atomic<quint64> m_head{0}; // shared by the producers
+    alignas(64) quint64 m_tail = 0;             // owned by the consumer
+    std::atomic<quint64> m_dropped{0};
+};
+
+class LogFileWriter : public QThread
+{/* Background writer for the optional rotating log file. It owns its own ring so a slow
+    disk only ever costs the producers a failed push, never a blocking write. */
+    Q_OBJECT
+
+public:
+    LogFileWriter(const QString &path, qint64 maxBytes, int maxFiles, QObject *parent = nullptr);
+    ~LogFileWriter() override;
+
+    LogRing &ring() { return m_ring; }
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    void rotate();
+
+    QString m_path;
+    qint64  m_maxBytes;
+    int     m_maxFiles;
+    std::atomic<bool> m_running{true};   // set before start(), so a stop() that comes first is not lost
+    LogRing m_ring;
+};
+
+class LogSink
+{/* Process wide replacement of the old "messageHandler -> appendLog" path. The Qt message handler only
+    formats and pushes into the rings; the UI drains its ring in batches from a timer on the GUI thread. */
+public:
+    static LogSink &instance();
+
+    static void install();
+    static void uninstall();
+
+    void configure(const QSettings &settings);
+    void enableFileSink(const QString &path, qint64 maxBytes, int maxFiles);
+    void shutdown();
+
+    void push(QtMsgType type, const QString &msg);
+    int drain(QVector<LogRecord> &out, int maxRecords);
+    quint64 droppedForUi() const { return m_uiRing.dropped(); }
+
+    static QString prefix(QtMsgType type);
+
+private:
+    LogSink();
+    static void messageHandler(QtMsgType type, const QMessageLogContext &, const QString &msg);
+    void replaceFileWriter(LogFileWriter *next);
+
+    QElapsedTimer m_clock;
+    LogRing m_uiRing;
+    std::atomic<LogFileWriter*> m_fileWriter{nullptr};
+    std::atomic<int> m_pushing{0};       // push() calls that may still hold the writer they loaded
+};
+
+#endif // LOGSINK_H
@@ -1,14 +1,26 @@
 #include <QApplication>
+#include <QSettings>
 #include "dvclient.h"
 #include "mainwindow.h"
+#include "logsink.h"
+#include "processstats.h"
+#include <QTimer>
 
 int main(int argc,char *argv[]){
     QApplication app(argc,argv);
+    LogSink::install(); // every thread logs into the ring, the window drains it
+    QSettings cfg(QCoreApplication::applicationDirPath() + "/qtalp.ini", QSettings::IniFormat);
+    DvClient::configureProcess(cfg); // [sched] before any thread starts, then [log]
     DvClient client;
-    if(!client.initDatabase())
+    if(!client.configure(cfg)){
+        LogSink::instance().shutdown();
         return -1;//DB SQLite var mı yok mu?
+    }
     MainWindow w(&client);
     w.show();
     client.start();
-    return app.exec();
+    QTimer::singleShot(0, [](){ ProcessStats::reportStartup("QtAlp"); });
+    const int rc = app.exec();
+    LogSink::instance().shutdown();
+    return rc;
 }
@@ -0,0 +1,50 @@
+#include <QCoreApplication>
+#include <QSettings>
+#include <QTimer>
+#include <QVector>
+#include <cstdio>
+#include "dvclient.h"
+#include "logsink.h"
+#include "processstats.h"
+
+/* Display-less gateway build: same DvClient/ComPortManager core as the Widgets UI, on a QCoreApplication.
+   The choices the operator makes in the window come from the [headless] group of qtalp.ini. */
+int main(int argc,char *argv[]){
+    QCoreApplication app(argc,argv);
+    LogSink::install();
+    QSettings cfg(QCoreApplication::applicationDirPath() + "/qtalp.ini", QSettings::IniFormat);
+    DvClient::configureProcess(cfg);
+
+    // Nobody drains the log ring on screen here, so the event loop prints it to stderr
+    QTimer logDrain;
+    QObject::connect(&logDrain, &QTimer::timeout, [](){
+        QVector<LogRecord> batch;
+        if (LogSink::instance().drain(batch, 500) == 0) return;
+        for (const LogRecord &r : std::as_const(batch)) {
+            const QByteArray line = (LogSink::prefix(r.type) + r.message).toLocal8Bit() + '\n';
+            std::fwrite(line.constData(), 1, size_t(line.size()), stderr);
+        }
+        std::fflush(stderr);
+    });
+    logDrain.start(100);
+
+    DvClient client;
+    if(!client.configure(cfg)){
+        LogSink::instance().shutdown();
+        return -1;
+    }
+
+    const QString mode = cfg.value("headless/mode", "idle").toString();
+    if (mode == "simulation") client.comUseSimulationOnly();
+    else if (mode == "port")  client.comUseSinglePort(cfg.value("headless/port").toString());
+    else if (mode == "replay") client.comUseReplay(cfg.value("headless/replay_files").toStringList(),
+                                                   cfg.value("headless/replay_speed", 1.0).toDouble());
+    else                      client.comUseIdle();
+    client.setErrorSimulation(cfg.value("headless/start_reading", false).toBool());
+
+    client.start();
+    QTimer::singleShot(0, [](){ ProcessStats::reportStartup("QtAlp_headless"); });
+    const int rc = app.exec();
+    LogSink::instance().shutdown();
+    return rc;
+}
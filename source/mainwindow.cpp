@@ -1,24 +1,28 @@
 #include "mainwindow.h"
 #include "dvclient.h"
+#include "logsink.h"
+#include "warningclassifier.h"
+#include "trace.h"
+#include "warningquery.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
 #include <QHeaderView>
 #include <QAbstractItemView>
-#include <QSqlQuery>
 #include <QDebug>
 #include <QTextCursor>
 #include <QTimer>
 
-
-MainWindow* MainWindow::s_instance = nullptr;
+namespace {
+constexpr int kLogMaxBlocks   = 5000; // lines kept in the log console, older ones scroll out
+constexpr int kLogDrainMs     = 100;
+constexpr int kLogDrainBatch  = 500;  // records moved per tick, the rest waits for the next one
+}
 
 MainWindow::MainWindow(DvClient *client, QWidget *parent)
     : QMainWindow(parent)
     , client(client)
 { /* Here is where we make our main window, which consists of port selection buttons, event output, and 3D OpenGL graph   */
-    s_instance = this; // To show the current instance 
-    qInstallMessageHandler(messageHandler); // Installing the message handler to show the messages on our message output box.
     //Initializing the current boxes on their.
     QWidget *central = new QWidget(this);
     QVBoxLayout *layout = new QVBoxLayout(central);
@@ -28,8 +32,9 @@ MainWindow::MainWindow(DvClient *client, QWidget *parent)
     portCombo = new QComboBox(this); // new Comboxes
     portCombo->addItem("Select Port");     // idx 0 for idle state pre-build 
     portCombo->addItem("Simulation");      // idx 1 for using the simulated values, it is pre build as well.
-    const QStringList ports = client->serialPorts(); // Showing the read values currently on the device, which is read from the client.
+    const QStringList ports = client->serialPorts(); // Cached list, the background scan fills the rest in through serialPortsChanged
     for (const QString &p : ports) portCombo->addItem(p); /// idx 3 for reading from the COM state, which is a state that shows all the ports that we need to be reading 
+    connect(client, &DvClient::serialPortsChanged, this, &MainWindow::onPortsChanged);
     connect(portCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onPortChoiceChanged);
     top->addWidget(portCombo); // adding the ports that readed
     layout->addLayout(top);
@@ -54,6 +59,7 @@ MainWindow::MainWindow(DvClient *client, QWidget *parent)
     resetButton       = new QPushButton("Reset Database", this); // Allocating the button for Reset Database
     parametersButton  = new QPushButton("Get Parameters", this); // Allocating the button for Get Parameters
     rebootButton      = new QPushButton("Reboot", this); // Allocating the button for Reboot
+    traceButton       = new QPushButton("Dump Trace", this); // Allocating the button for Dump Trace
 
     QGridLayout *btnGrid = new QGridLayout(); // Creating the button layout
     btnGrid->addWidget(sendLogsButton,    0,0); //Specifing the unique location
@@ -62,6 +68,7 @@ MainWindow::MainWindow(DvClient *client, QWidget *parent)
     btnGrid->addWidget(resetButton,       1,1); //Specifing the unique location
     btnGrid->addWidget(parametersButton,  2,0); //Specifing the unique location
     btnGrid->addWidget(rebootButton,      2,1); //Specifing the unique location
+    btnGrid->addWidget(traceButton,       3,0,1,2); //Specifing the unique location
     layout->addLayout(btnGrid);
 
     /*######## 3D Scatter ########*/
@@ -70,11 +77,18 @@ MainWindow::MainWindow(DvClient *client, QWidget *parent)
     scatterWidget->setMinimumSize(300,300);
     layout->addWidget(scatterWidget);
 
+    /*######## Distance over time ########*/
+    /* Live per-port line chart; wheel zooms, drag pans into history, double click goes back to live. */
+    chartWidget = new DistanceChartWidget(client, this);
+    chartWidget->setMinimumSize(300,200);
+    layout->addWidget(chartWidget);
+
     /*######## Logs ########*/
     /* Area that prints our logs on screen like COM reads, URL parameters errors, etc.*/ 
     logOutput = new QPlainTextEdit(this);
     logOutput->setReadOnly(true);
     logOutput->setMinimumSize(400,100);
+    logOutput->setMaximumBlockCount(kLogMaxBlocks);
     layout->addWidget(logOutput);
     setCentralWidget(central);
 
@@ -82,28 +96,29 @@ MainWindow::MainWindow(DvClient *client, QWidget *parent)
     /* While we are showing the generated records on the screen, we also need to show
     The previous values have been generated as well to ensure that we need to repopulate
     the table with previous values.*/
-    QSqlQuery q(client->database());
-    q.exec("SELECT timestamp, level, distance, xn FROM warnings");
-    while(q.next()){
-        QString ts  = q.value(0).toString();
-        QString lvl = q.value(1).toString();
-        double d    = q.value(2).toDouble();
-        double x    = q.value(3).toDouble();
-        double v    = LevelDetect(lvl);
-        scatterWidget->addPoint(d,x,v);
-        appendLog(QString("History: %1, %2, %3").arg(ts).arg(lvl).arg(d));
-    }
+    WarningFilter current; // the active partition, i.e. what the "warnings" view shows
+    current.fromTs = client->store().activeStartTs();
+    WarningQuery(client->store()).stream(current, 1000, [this](const QVector<WarningRow> &rows) {
+        for (const WarningRow &r : rows) {
+            scatterWidget->addPoint(r.distance, r.xn, LevelDetect(r.level));
+            appendLog(QString("History: %1, %2, %3").arg(r.timestamp).arg(r.level).arg(r.distance));
+        }
+        return true;
+    });
 
     /*######## Button Connect actions ########*/
     /*Connecting the generated buttons with their corresponding functions and,
     also describing how input will be getting from the screen*/
     connect(client, &DvClient::newWarning, this, &MainWindow::onNewWarning);
+    connect(client, &DvClient::sampleReceived, chartWidget, &DistanceChartWidget::addSample);
     connect(sendLogsButton,  &QPushButton::clicked, this, &MainWindow::onSendLogs);
     connect(startSensorButton,&QPushButton::clicked, this, &MainWindow::onStartSensor);
     connect(stopSensorButton, &QPushButton::clicked, this, &MainWindow::onStopSensor);
     connect(resetButton,      &QPushButton::clicked, this, &MainWindow::onResetDatabase);
     connect(parametersButton, &QPushButton::clicked, this, &MainWindow::onGetParameters);
     connect(rebootButton,     &QPushButton::clicked, this, &MainWindow::onReboot);
+    connect(traceButton,      &QPushButton::clicked, client, &DvClient::dumpTrace);
+    traceButton->setEnabled(Tracer::compiledIn());
 
     /* Here we disable the buttons until there is a COM selection. 
     After choosing the COMs, the buttons will be unlocked. Expect the 
@@ -114,28 +129,31 @@ MainWindow::MainWindow(DvClient *client, QWidget *parent)
     resetButton->setEnabled(false);
     parametersButton->setEnabled(false);
     sendLogsButton->setEnabled(false);
+
+    /*######## Log drain ########*/
+    /* qDebug & co. from any thread land in the LogSink ring; only this timer touches the widget. */
+    logDrainTimer = new QTimer(this);
+    connect(logDrainTimer, &QTimer::timeout, this, &MainWindow::drainLogs);
+    logDrainTimer->start(kLogDrainMs);
 }
 
-MainWindow::~MainWindow(){/*DESTRUCTOR, it is a typical destructor, and also
-individually deleting qInstallMessageHandler */
-    qInstallMessageHandler(nullptr); s_instance=nullptr; 
+MainWindow::~MainWindow(){/*DESTRUCTOR, it is a typical destructor. The message handler belongs to LogSink now. */
 }
 
 double MainWindow::LevelDetect(const QString &level)
 { /*Detecting level that got on SQL Database.*/
-    if(level=="WARNING-1") return 1;
-    if(level=="WARNING-2") return 2;
-    if(level=="WARNING-3") return 3;
-    if(level=="WARNING-4") return 4;
-    return 0;
+    return WarningClassifier::levelIndex(level);
 }
 
 void MainWindow::onNewWarning(const QString &, const QString &level, double distance, double xn)
 {/*Message that pushed on the screen to see each sensor reading and its corresponding readings. */
-    model->select(); tableView->scrollToBottom();
+    {
+        QTALP_TRACE_SCOPE("ui.model_refresh");
+        model->select(); tableView->scrollToBottom();
+    }
     double v=LevelDetect(level);
     scatterWidget->addPoint(distance,xn,v);
-    appendLog(QString("-> New warning: %1, distance=%2, xn=%3").arg(level).arg(distance).arg(xn));
+    appendLog(QStringLiteral("-> New warning: %1, distance=%2, xn=%3").arg(level, QString::number(distance), QString::number(xn)));
 }
 
 void MainWindow::appendLog(const QString &msg)
@@ -161,6 +179,7 @@ void MainWindow::onResetDatabase()
 {/* button condition that resets the database and clears all the points. While resetting, 
     It will also close the error simulation. */
     scatterWidget->clearPoints();
+    chartWidget->clearSamples();
     client->resetDatabase();
     client->setErrorSimulation(false);
     model->select();
@@ -173,10 +192,10 @@ void MainWindow::onGetParameters()
     client->requestParameters();
 }
 void MainWindow::onReboot()
-{/*it is a button call function that reboots the COMS and shows the newer COM list on COM select */
+{/*it is a button call function that reboots the COMS. The newer COM list reaches the COM select
+    through onPortsChanged once the background rescan finishes, nothing waits for it here. */
     appendLog("# Rebooting COM ports...");
     client->rebootComPorts();//reseting as function 
-    QTimer::singleShot(400, this, &MainWindow::refreshPortList);//reseting as on screeen
 }
 
 void MainWindow::onPortChoiceChanged(int idx)
@@ -207,19 +226,27 @@ void MainWindow::onPortChoiceChanged(int idx)
 
 }
 
-void MainWindow::messageHandler(QtMsgType t,const QMessageLogContext&,const QString &m)
-{/* Handles the message that will be shown on the Device message screen */
-    QString p;
-    switch(t){ case QtDebugMsg: p="DEBUG: ";break; case QtWarningMsg: p="WARNING: ";break; case QtCriticalMsg: p="CRITICAL: ";break; case QtFatalMsg: p="FATAL: ";break; default: p.clear(); }
-    if(s_instance) s_instance->appendLog(p+m);
+void MainWindow::drainLogs()
+{/* Moves a batch of queued log records onto the screen with a single append, 
+    so a burst of qDebug from the COM threads costs one layout pass instead of hundreds. */
+    QVector<LogRecord> batch;
+    batch.reserve(kLogDrainBatch);
+    if (LogSink::instance().drain(batch, kLogDrainBatch) == 0) return;
+
+    QString text;
+    for (const LogRecord &r : batch) {
+        if (!text.isEmpty()) text += QLatin1Char('\n');
+        text += LogSink::prefix(r.type);
+        text += r.message;
+    }
+    appendLog(text);
 }
 
-void MainWindow::refreshPortList()
-{/* Refreshes the POrt list to choose*/
+void MainWindow::onPortsChanged(const QStringList &ports)
+{/* Refreshes the POrt list to choose, whenever the background scan reports a different list */
     const QString prev = portCombo->currentText();
 
     const QStringList base = { "Select Port", "Simulation"};
-    const QStringList ports = client->serialPorts();
 
     portCombo->blockSignals(true);
     portCombo->clear();
@@ -230,8 +257,9 @@ void MainWindow::refreshPortList()
     portCombo->setCurrentIndex(idx >= 0 ? idx : 0);
     portCombo->blockSignals(false);
 
-    // Re-apply mode for the restored selection
-    onPortChoiceChanged(portCombo->currentIndex());
+    // The selected port disappeared: fall back to idle. Otherwise the running mode is left alone.
+    if (idx < 0)
+        onPortChoiceChanged(portCombo->currentIndex());
 }
 
 
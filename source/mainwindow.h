@@ -7,7 +7,9 @@
 #include <QSqlTableModel>
 #include <QPlainTextEdit>
 #include <QComboBox>
+#include <QTimer>
 #include "scatter3dwidget.h"
+#include "distancechartwidget.h"
 
 class DvClient;
 
@@ -30,11 +32,10 @@ private slots:
     void onGetParameters();
     void onReboot();
     void onPortChoiceChanged(int idx);
+    void drainLogs();
+    void onPortsChanged(const QStringList &ports);
 
 private:
-    static MainWindow *s_instance;
-    static void messageHandler(QtMsgType, const QMessageLogContext &, const QString &msg);
-    void refreshPortList();
 
     DvClient       *client;
     QTableView     *tableView;
@@ -46,8 +47,11 @@ private:
     QPushButton    *resetButton;
     QPushButton    *parametersButton;
     QPushButton    *rebootButton;
+    QPushButton    *traceButton;
     Scatter3DWidget *scatterWidget;
+    DistanceChartWidget *chartWidget;
     QPlainTextEdit *logOutput;
+    QTimer         *logDrainTimer;
 };
 
 #endif // MAINWINDOW_H
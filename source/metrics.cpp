@@ -0,0 +1,239 @@
+#include "metrics.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QMap>
+#include <QHash>
+#include <QDebug>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <algorithm>
+
+/*######## Counter ########*/
+int Counter::shardIndex()
+{/* Threads get a shard round robin on their first increment */
+    static std::atomic<int> next{0};
+    thread_local const int idx = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return idx;
+}
+
+quint64 Counter::value() const
+{
+    quint64 sum = 0;
+    for (const Shard &s : m_shards) sum += s.v.load(std::memory_order_relaxed);
+    return sum;
+}
+
+/*######## Histogram ########*/
+int Histogram::bucketIndex(quint64 v)
+{/* values below 8 map 1:1, above that: (power of two, top 3 bits below the leading one) */
+    if (v < quint64(kSubBuckets)) return int(v);
+    const int msb = 63 - __builtin_clzll(v);
+    const int shift = msb - kSubBits;
+    return (shift + 1) * kSubBuckets + int((v >> shift) & (kSubBuckets - 1));
+}
+
+quint64 Histogram::bucketUpperBound(int idx)
+{
+    if (idx < kSubBuckets) return quint64(idx);
+    const int shift = idx / kSubBuckets - 1;
+    const quint64 sub = quint64(idx % kSubBuckets);
+    const quint64 lower = (quint64(kSubBuckets) + sub) << shift;
+    return lower + ((quint64(1) << shift) - 1);
+}
+
+void Histogram::record(quint64 v)
+{
+    m_buckets[bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(v, std::memory_order_relaxed);
+    quint64 prev = m_max.load(std::memory_order_relaxed);
+    while (v > prev && !m_max.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {}
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot s;
+    for (int i = 0; i < kBuckets; ++i) {
+        const quint64 c = m_buckets[i].load(std::memory_order_relaxed);
+        if (c) s.buckets.append({ bucketUpperBound(i), c });
+        s.count += c;
+    }
+    s.sum = m_sum.load(std::memory_order_relaxed);
+    s.max = m_max.load(std::memory_order_relaxed);
+    return s;
+}
+
+quint64 Histogram::Snapshot::quantile(double q) const
+{
+    if (count == 0) return 0;
+    const quint64 rank = quint64(std::clamp(q, 0.0, 1.0) * double(count - 1)) + 1;
+    quint64 seen = 0;
+    for (const auto &b : buckets) {
+        seen += b.second;
+        if (seen >= rank) return std::min(b.first, max);
+    }
+    return max;
+}
+
+/*######## Registry ########*/
+namespace {
+// Prometheus le bounds: 4^k - 1 for k = 1..20 (3 ... ~1.1e12). Every one is an upper bound of an HDR
+// bucket, so the cumulative counts are exact, and the series set of a histogram never changes.
+constexpr int kPromBounds = 20;
+
+struct Registry {
+    QMutex mutex;
+    QMap<QString, Counter*>   counters;   // QMap keeps the export sorted by name
+    QMap<QString, Gauge*>     gauges;
+    QMap<QString, Histogram*> histograms;
+    QHash<QString, QString>   help;
+};
+
+Registry &registry()
+{
+    static Registry r;
+    return r;
+}
+
+template <typename T>
+T &lookup(QMap<QString, T*> &map, const QString &name, const QString &help)
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    T *&slot = map[name];
+    if (!slot) slot = new T(); // intentionally never freed, references are held for the process lifetime
+    if (!help.isEmpty()) r.help.insert(name, help);
+    return *slot;
+}
+}
+
+Counter &Metrics::counter(const QString &name, const QString &help)
+{
+    return lookup(registry().counters, name, help);
+}
+
+Gauge &Metrics::gauge(const QString &name, const QString &help)
+{
+    return lookup(registry().gauges, name, help);
+}
+
+Histogram &Metrics::histogram(const QString &name, const QString &help)
+{
+    return lookup(registry().histograms, name, help);
+}
+
+QJsonObject Metrics::snapshotJson()
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    QJsonObject out;
+    for (auto it = r.counters.cbegin(); it != r.counters.cend(); ++it)
+        out[it.key()] = double(it.value()->value());
+    for (auto it = r.gauges.cbegin(); it != r.gauges.cend(); ++it)
+        out[it.key()] = double(it.value()->value());
+    for (auto it = r.histograms.cbegin(); it != r.histograms.cend(); ++it) {
+        const Histogram::Snapshot s = it.value()->snapshot();
+        out[it.key()] = QJsonObject{
+            { "count", double(s.count) },
+            { "sum",   double(s.sum) },
+            { "p50",   double(s.quantile(0.50)) },
+            { "p90",   double(s.quantile(0.90)) },
+            { "p99",   double(s.quantile(0.99)) },
+            { "max",   double(s.max) },
+        };
+    }
+    return out;
+}
+
+QStringList Metrics::summaryLines()
+{
+    QStringList lines;
+    const QJsonObject snap = snapshotJson();
+    for (auto it = snap.constBegin(); it != snap.constEnd(); ++it) {
+        if (it.value().isObject()) {
+            const QJsonObject h = it.value().toObject();
+            lines << QStringLiteral("%1: n=%2 p50=%3 p90=%4 p99=%5 max=%6")
+                         .arg(it.key())
+                         .arg(qint64(h["count"].toDouble()))
+                         .arg(qint64(h["p50"].toDouble()))
+                         .arg(qint64(h["p90"].toDouble()))
+                         .arg(qint64(h["p99"].toDouble()))
+                         .arg(qint64(h["max"].toDouble()));
+        } else {
+            lines << QStringLiteral("%1: %2").arg(it.key()).arg(qint64(it.value().toDouble()));
+        }
+    }
+    return lines;
+}
+
+QByteArray Metrics::prometheusText()
+{/* Text exposition format 0.0.4, every name gets the qtalp_ prefix */
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    QByteArray out;
+    auto header = [&](const QString &name, const char *type) {
+        const QByteArray full = "qtalp_" + name.toUtf8();
+        const QString help = r.help.value(name);
+        if (!help.isEmpty()) out += "# HELP " + full + ' ' + help.toUtf8() + '\n';
+        out += "# TYPE " + full + ' ' + type + '\n';
+        return full;
+    };
+    for (auto it = r.counters.cbegin(); it != r.counters.cend(); ++it)
+        out += header(it.key(), "counter") + ' ' + QByteArray::number(it.value()->value()) + '\n';
+    for (auto it = r.gauges.cbegin(); it != r.gauges.cend(); ++it)
+        out += header(it.key(), "gauge") + ' ' + QByteArray::number(it.value()->value()) + '\n';
+    for (auto it = r.histograms.cbegin(); it != r.histograms.cend(); ++it) {
+        const QByteArray full = header(it.key(), "histogram");
+        const Histogram::Snapshot s = it.value()->snapshot();
+        quint64 cumulative = 0;
+        auto b = s.buckets.cbegin();
+        for (int k = 1; k <= kPromBounds; ++k) {
+            const quint64 le = (quint64(1) << (2 * k)) - 1;
+            for (; b != s.buckets.cend() && b->first <= le; ++b) cumulative += b->second;
+            out += full + "_bucket{le=\"" + QByteArray::number(le) + "\"} " + QByteArray::number(cumulative) + '\n';
+        }
+        out += full + "_bucket{le=\"+Inf\"} " + QByteArray::number(s.count) + '\n';
+        out += full + "_sum " + QByteArray::number(s.sum) + '\n';
+        out += full + "_count " + QByteArray::number(s.count) + '\n';
+    }
+    return out;
+}
+
+/*######## MetricsServer ########*/
+MetricsServer::MetricsServer(QObject *parent)
+    : QTcpServer(parent)
+{
+    connect(this, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+bool MetricsServer::start(quint16 port)
+{/* Bound to loopback only, scraping from the LAN goes through whatever agent runs on the gateway */
+    if (!listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Metrics endpoint failed to listen on port" << port << ":" << errorString();
+        return false;
+    }
+    qInfo() << "Metrics endpoint: http://127.0.0.1:" << serverPort() << "/metrics";
+    return true;
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket *sock = nextPendingConnection()) {
+        connect(sock, &QTcpSocket::disconnected, sock, &QObject::deleteLater);
+        connect(sock, &QTcpSocket::readyRead, sock, [sock]() {
+            if (!sock->canReadLine()) return;
+            const QList<QByteArray> requestLine = sock->readLine().trimmed().split(' ');
+            const bool ok = requestLine.size() >= 2 && requestLine.at(0) == "GET"
+                            && (requestLine.at(1) == "/metrics" || requestLine.at(1) == "/");
+            const QByteArray body = ok ? Metrics::prometheusText() : QByteArray("not found\n");
+            QByteArray resp = ok ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n";
+            resp += "Content-Type: text/plain; version=0.0.4\r\n";
+            resp += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+            resp += "Connection: close\r\n\r\n";
+            resp += body;
+            sock->write(resp);
+            sock->disconnectFromHost();
+        });
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+#include <QTcpServer>
+#include <atomic>
+#include <array>
+
+class Counter
+{/* Monotonic counter sharded per thread: each thread adds into its own cache line,
+    readers sum the shards. inc() is one uncontended relaxed fetch_add. */
+public:
+    static constexpr int kShards = 16;
+
+    void inc(quint64 n = 1) { m_shards[shardIndex()].v.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const;
+
+private:
+    struct alignas(64) Shard { std::atomic<quint64> v{0}; };
+    static int shardIndex();
+
+    std::array<Shard, kShards> m_shards;
+};
+
+class Gauge
+{/* Last written value, for things like "ports open" or "queue depth" */
+public:
+    void set(qint64 v) { m_value.store(v, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+class Histogram
+{/* HDR style log-linear histogram over non-negative integers: 8 sub-buckets per power of two,
+    so any recorded value lands in a bucket at most 12.5% wide. Fixed memory, no locks. */
+public:
+    static constexpr int kSubBits    = 3;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets    = (64 - kSubBits + 1) * kSubBuckets;
+
+    void record(quint64 v);
+
+    struct Snapshot {
+        quint64 count = 0;
+        quint64 sum   = 0;
+        quint64 max   = 0;
+        QVector<QPair<quint64, quint64>> buckets; // (upper bound, count), non-empty only
+        quint64 quantile(double q) const;
+    };
+    Snapshot snapshot() const;
+
+    static int bucketIndex(quint64 v);
+    static quint64 bucketUpperBound(int idx);
+
+private:
+    std::array<std::atomic<quint64>, kBuckets> m_buckets{};
+    std::atomic<quint64> m_count{0};
+    std::atomic<quint64> m_sum{0};
+    std::atomic<quint64> m_max{0};
+};
+
+class Metrics
+{/* Process wide registry. Look a metric up once (it is never moved or freed) and keep the reference;
+    recording never goes through the registry again. */
+public:
+    static Counter   &counter(const QString &name, const QString &help = QString());
+    static Gauge     &gauge(const QString &name, const QString &help = QString());
+    static Histogram &histogram(const QString &name, const QString &help = QString());
+
+    static QJsonObject snapshotJson();
+    static QByteArray prometheusText();
+    static QStringList summaryLines();  // human readable, for get_d_parameters
+};
+
+class MetricsServer : public QTcpServer
+{/* Minimal localhost-only HTTP endpoint: GET /metrics in Prometheus text format, anything else 404. */
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+    bool start(quint16 port);
+
+private slots:
+    void onNewConnection();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,75 @@
+#include "portenumerator.h"
+#include "metrics.h"
+#include "threadscheduling.h"
+#include <QSerialPortInfo>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+namespace {
+constexpr int kRescanIntervalMs = 2000; // hot-plug pickup without anyone pressing "Reboot"
+}
+
+void PortScanWorker::scan()
+{
+    static Histogram &latency = Metrics::histogram("port_enumeration_ms", "QSerialPortInfo::availablePorts() duration");
+    QElapsedTimer timer;
+    timer.start();
+    QStringList out;
+    const auto ports = QSerialPortInfo::availablePorts();
+    for (const auto &p : ports) out << p.portName();//get all the port names which are not NULL
+    latency.record(quint64(timer.elapsed()));
+    emit scanned(out);
+}
+
+void PortScanWorker::startPeriodic(int intervalMs)
+{
+    if (!m_timer) {
+        m_timer = new QTimer(this);
+        connect(m_timer, &QTimer::timeout, this, &PortScanWorker::scan);
+    }
+    m_timer->start(intervalMs);
+}
+
+PortEnumerator::PortEnumerator(QObject *parent)
+    : QObject(parent), m_worker(new PortScanWorker)
+{/* The worker is moved to its own thread, every call into it goes through a queued signal */
+    m_thread.setObjectName(QStringLiteral("PortEnumerator"));
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(&m_thread, &QThread::started, m_worker, [](){
+        ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Background);
+    }, Qt::DirectConnection);
+    connect(this, &PortEnumerator::requestScan, m_worker, &PortScanWorker::scan);
+    connect(m_worker, &PortScanWorker::scanned, this, &PortEnumerator::onScanned);
+    m_thread.start(QThread::LowPriority);
+    QMetaObject::invokeMethod(m_worker, "startPeriodic", Qt::QueuedConnection, Q_ARG(int, kRescanIntervalMs));
+    rescan();
+}
+
+PortEnumerator::~PortEnumerator()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+QStringList PortEnumerator::ports() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_ports;
+}
+
+void PortEnumerator::rescan()
+{
+    emit requestScan();
+}
+
+void PortEnumerator::onScanned(const QStringList &ports)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (ports == m_ports && m_version.load(std::memory_order_relaxed) != 0) return;
+        m_ports = ports;
+    }
+    const quint64 v = m_version.fetch_add(1, std::memory_order_acq_rel) + 1;
+    emit portsChanged(ports, v);
+}
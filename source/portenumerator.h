@@ -0,0 +1,57 @@
+#ifndef PORTENUMERATOR_H
+#define PORTENUMERATOR_H
+
+#include <QObject>
+#include <QThread>
+#include <QStringList>
+#include <QMutex>
+#include <QTimer>
+#include <atomic>
+
+class PortScanWorker : public QObject
+{/* Lives on the enumerator's thread; the only place QSerialPortInfo::availablePorts() is called. */
+    Q_OBJECT
+
+public slots:
+    void scan();
+    void startPeriodic(int intervalMs);
+
+signals:
+    void scanned(const QStringList &ports);
+
+private:
+    QTimer *m_timer = nullptr;
+};
+
+class PortEnumerator : public QObject
+{/* Cached, versioned list of serial ports. Enumeration walks sysfs/udev on Linux and can take
+    hundreds of ms, so it runs on a background thread; callers only ever read the cache.
+    portsChanged() fires (on the owner's thread) when a scan finds a different list. */
+    Q_OBJECT
+
+public:
+    explicit PortEnumerator(QObject *parent = nullptr);
+    ~PortEnumerator() override;
+
+    QStringList ports() const;
+    quint64 version() const { return m_version.load(std::memory_order_acquire); }
+
+public slots:
+    void rescan();   // asynchronous, returns immediately
+
+signals:
+    void portsChanged(const QStringList &ports, quint64 version);
+    void requestScan();
+
+private slots:
+    void onScanned(const QStringList &ports);
+
+private:
+    QThread m_thread;
+    PortScanWorker *m_worker;
+    mutable QMutex m_mutex;
+    QStringList m_ports;
+    std::atomic<quint64> m_version{0};
+};
+
+#endif // PORTENUMERATOR_H
@@ -0,0 +1,64 @@
+#include "processstats.h"
+#include "metrics.h"
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+#include <QDebug>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+qint64 statusField(const char *key)
+{/* "VmRSS:     12345 kB" style lines of /proc/self/status */
+#ifdef Q_OS_LINUX
+    QFile f("/proc/self/status");
+    if (!f.open(QIODevice::ReadOnly)) return -1;
+    const QByteArray prefix = QByteArray(key) + ':';
+    for (const QByteArray &line : f.readAll().split('\n')) {
+        if (line.startsWith(prefix))
+            return line.mid(prefix.size()).trimmed().split(' ').value(0).toLongLong();
+    }
+#else
+    Q_UNUSED(key);
+#endif
+    return -1;
+}
+}
+
+qint64 ProcessStats::msSinceProcessStart()
+{/* field 22 of /proc/self/stat is the start time in clock ticks after boot, /proc/uptime is "now" */
+#ifdef Q_OS_LINUX
+    QFile stat("/proc/self/stat"), uptime("/proc/uptime");
+    if (!stat.open(QIODevice::ReadOnly) || !uptime.open(QIODevice::ReadOnly)) return -1;
+    const QByteArray s = stat.readAll();
+    // the command name (field 2) may contain spaces, count fields after its closing parenthesis
+    const QList<QByteArray> fields = s.mid(s.lastIndexOf(')') + 2).split(' ');
+    const qint64 startTicks = fields.value(19).toLongLong();
+    const double upSec = uptime.readAll().split(' ').value(0).toDouble();
+    const long hz = sysconf(_SC_CLK_TCK);
+    if (hz <= 0 || startTicks <= 0) return -1;
+    return qint64(upSec * 1000.0) - startTicks * 1000 / hz;
+#else
+    return -1;
+#endif
+}
+
+qint64 ProcessStats::rssKiB()
+{
+    return statusField("VmRSS");
+}
+
+qint64 ProcessStats::peakRssKiB()
+{
+    return statusField("VmHWM");
+}
+
+void ProcessStats::reportStartup(const char *variant)
+{
+    const qint64 startup = msSinceProcessStart();
+    const qint64 rss = rssKiB();
+    Metrics::gauge("startup_ms", "Process start to first event loop iteration").set(startup);
+    Metrics::gauge("rss_kib", "Resident set size").set(rss);
+    qInfo().noquote() << QStringLiteral("==> %1 started in %2 ms, RSS %3 KiB").arg(QLatin1String(variant)).arg(startup).arg(rss);
+}
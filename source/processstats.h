@@ -0,0 +1,18 @@
+#ifndef PROCESSSTATS_H
+#define PROCESSSTATS_H
+
+#include <QtGlobal>
+
+class ProcessStats
+{/* Startup time and memory of the running process, used to compare the UI and headless builds.
+    Linux reads /proc; other platforms report -1. */
+public:
+    static qint64 msSinceProcessStart();  // wall time since the kernel started the process (includes dynamic loading)
+    static qint64 rssKiB();               // resident set size
+    static qint64 peakRssKiB();           // high-water mark of the resident set
+
+    // Logs both and stores them in the startup_ms / rss_kib gauges, call once the event loop runs
+    static void reportStartup(const char *variant);
+};
+
+#endif // PROCESSSTATS_H
@@ -0,0 +1,134 @@
+/* QtAlp live stream in POSIX shared memory, layout version 1.
+
+   QtAlp (the single writer) creates the object given by [shm] name, "/qtalp" by default, and publishes every
+   sample and every stored warning into two rings. Any number of local processes may map it read-only and
+   follow along. Readers take no lock and write nothing, so a slow or crashed reader can never hold up
+   acquisition. A reader that falls more than a ring behind just loses the oldest entries, and it can tell
+   how many.
+
+   Everything is little-endian with natural alignment (x86-64, aarch64, armv7).
+
+     offset   size
+     0        1152   qtalp_shm_header (fixed part 128 bytes, then the port name table)
+     sample_offset   sample_slots  x 32 bytes   qtalp_shm_sample
+     warning_offset  warning_slots x 64 bytes   qtalp_shm_warning
+
+   Entry n (counting from 0 since the writer started) lives in slot n % slots, and the slot counts are
+   powers of two. Each slot starts with a sequence word:
+     2n+1   the writer is filling the slot with entry n
+     2n+2   the slot holds entry n
+   To read entry n: load seq (acquire), copy the slot, acquire fence, load seq again. The copy is good if
+   both loads gave 2n+2. If seq is below 2n+1, entry n is not written yet. If it is above 2n+2, or the two
+   loads differ, the writer has lapped the reader and entry n is gone. The *_head words count the entries
+   published so far.
+
+   When the writer restarts it unlinks and recreates the object, so created_ms changes. A reader should
+   compare it (and magic/version) after mapping, and remap once heartbeat_ms stops advancing; the writer
+   updates it at least once a second.
+
+   Python: mmap /dev/shm/qtalp and unpack the same offsets with struct ("<QQqfHH" for a sample slot). */
+
+#ifndef QTALP_SHM_H
+#define QTALP_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QTALP_SHM_MAGIC        0x48534151u   /* "QASH" */
+#define QTALP_SHM_VERSION      1
+#define QTALP_SHM_MAX_PORTS    32
+#define QTALP_SHM_PORT_NAME    32            /* bytes per name, NUL padded */
+
+#define QTALP_SHM_FLAG_SIMULATED 0x1         /* same bits as the raw sample journal */
+#define QTALP_SHM_FLAG_REPLAYED  0x2
+
+typedef struct qtalp_shm_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;          /* 1152 */
+    uint32_t sample_slots;
+    uint32_t warning_slots;
+    uint32_t sample_slot_size;     /* 32 */
+    uint32_t warning_slot_size;    /* 64 */
+    uint64_t sample_offset;
+    uint64_t warning_offset;
+    int64_t  created_ms;           /* ms since epoch UTC when the writer created the object */
+    uint64_t writer_pid;
+    uint64_t reserved_fixed;
+    /* 64: updated by the writer while it runs, read with acquire loads */
+    uint64_t sample_head;          /* samples published so far */
+    uint64_t warning_head;         /* warnings published so far */
+    int64_t  heartbeat_ms;
+    uint32_t port_count;           /* valid entries in port_names, only ever grows */
+    uint32_t reserved0;
+    uint8_t  reserved[32];
+    /* 128 */
+    char     port_names[QTALP_SHM_MAX_PORTS][QTALP_SHM_PORT_NAME];
+} qtalp_shm_header;
+
+typedef struct qtalp_shm_sample {
+    uint64_t seq;
+    uint64_t index;                /* n, also implied by seq */
+    int64_t  ts_us;                /* µs since epoch UTC */
+    float    value;                /* distance in cm */
+    uint16_t port;                 /* index into port_names */
+    uint16_t flags;                /* QTALP_SHM_FLAG_* */
+} qtalp_shm_sample;
+
+typedef struct qtalp_shm_warning {
+    uint64_t seq;
+    uint64_t index;
+    int64_t  ts_us;                /* detection time, µs since epoch UTC (same clock as the sample) */
+    double   distance;
+    double   xn;
+    uint16_t level;                /* 1..4 for WARNING-1..4 */
+    uint16_t port;
+    uint32_t reserved0;
+    uint64_t reserved[2];
+} qtalp_shm_warning;
+
+enum { QTALP_SHM_OK = 0, QTALP_SHM_NOT_YET = 1, QTALP_SHM_OVERWRITTEN = -1 };
+
+static inline uint64_t qtalp_shm_sample_head(const qtalp_shm_header *h)
+{
+    return __atomic_load_n(&h->sample_head, __ATOMIC_ACQUIRE);
+}
+
+static inline uint64_t qtalp_shm_warning_head(const qtalp_shm_header *h)
+{
+    return __atomic_load_n(&h->warning_head, __ATOMIC_ACQUIRE);
+}
+
+/* One seqlock read of a slot of slot_size bytes holding entry n, the slot layouts above share the seq word */
+static inline int qtalp_shm_read_slot(const void *slot, uint64_t n, void *out, size_t slot_size)
+{
+    const uint64_t *seq = (const uint64_t *)slot;
+    const uint64_t s1 = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+    if (s1 < 2 * n + 2) return QTALP_SHM_NOT_YET;
+    if (s1 != 2 * n + 2) return QTALP_SHM_OVERWRITTEN;
+    memcpy(out, slot, slot_size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) == s1 ? QTALP_SHM_OK : QTALP_SHM_OVERWRITTEN;
+}
+
+static inline int qtalp_shm_read_sample(const qtalp_shm_header *h, uint64_t n, qtalp_shm_sample *out)
+{
+    const qtalp_shm_sample *ring = (const qtalp_shm_sample *)((const char *)h + h->sample_offset);
+    return qtalp_shm_read_slot(&ring[n & (h->sample_slots - 1)], n, out, sizeof(*out));
+}
+
+static inline int qtalp_shm_read_warning(const qtalp_shm_header *h, uint64_t n, qtalp_shm_warning *out)
+{
+    const qtalp_shm_warning *ring = (const qtalp_shm_warning *)((const char *)h + h->warning_offset);
+    return qtalp_shm_read_slot(&ring[n & (h->warning_slots - 1)], n, out, sizeof(*out));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QTALP_SHM_H */
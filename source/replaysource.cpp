@@ -0,0 +1,70 @@
+#include "replaysource.h"
+#include "capturefile.h"
+#include "threadscheduling.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDebug>
+
+ReplaySource::ReplaySource(const QString &capturePath, double speed, QObject *parent)
+    : SampleSource(parent), m_path(capturePath), m_speed(speed)
+{
+    setObjectName(QStringLiteral("Replay[%1]").arg(QFileInfo(capturePath).fileName()));
+    QueueConfig lossless;
+    lossless.policy = QueuePolicy::Block;
+    setQueueConfig(lossless);
+}
+
+ReplaySource::~ReplaySource()
+{
+    stop();
+    wait();
+}
+
+void ReplaySource::stop()
+{
+    m_running = false;
+    closeQueue();
+}
+
+void ReplaySource::run()
+{
+    ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Acquisition);
+    CaptureReader reader;
+    if (!reader.open(m_path)) {
+        emit portOpenFailed(QStringLiteral("Cannot read capture %1").arg(m_path));
+        return;
+    }
+    const QString name = QStringLiteral("replay:%1").arg(reader.portName());
+    emit portOpened(name);
+
+    m_parser.reset();
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 startUs = sampleClockUs();   // samples are stamped startUs + capture time, at any speed
+    qint64 elapsedUs = 0;
+    qint64 bytes = 0;
+    QByteArray chunk;
+    QVector<SourceSample> batch;
+
+    while (m_running && reader.next(elapsedUs, chunk)) {
+        if (m_speed > 0) {// sleep in short slices so stop() stays responsive
+            const qint64 dueUs = qint64(double(elapsedUs) / m_speed);
+            qint64 waitUs;
+            while (m_running && (waitUs = dueUs - clock.nsecsElapsed() / 1000) > 0)
+                usleep(quint64(qMin<qint64>(waitUs, 50000)));
+        }
+        bytes += chunk.size();
+        batch.resize(0);
+        m_parser.feed(chunk,
+                      [&batch, tsUs = startUs + elapsedUs](int channel, float dist){ batch.append({ dist, channel, tsUs }); },
+                      [this](const QByteArray &line){ emit parseError(QString::fromUtf8(line)); });
+        if (batch.isEmpty()) continue;
+        m_samples.fetch_add(quint64(batch.size()), std::memory_order_relaxed);
+        publish(batch);
+    }
+
+    const double secs = qMax(1e-9, clock.nsecsElapsed() / 1e9);
+    qInfo().noquote() << QStringLiteral("Replay of %1 done: %2 bytes, %3 samples in %4 s (%5 samples/s)")
+                             .arg(name).arg(bytes).arg(samplesEmitted()).arg(secs, 0, 'f', 3)
+                             .arg(double(samplesEmitted()) / secs, 0, 'f', 0);
+}
@@ -0,0 +1,34 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include "samplesource.h"
+#include "frameparser.h"
+#include <atomic>
+
+class ReplaySource : public SampleSource
+{/* Plays a .qacap capture back through the same framing and signals as a live ComThread.
+    speed 1.0 = real time, N = N times faster, 0 = as fast as possible (pipeline throughput test).
+    Its queue blocks when full: a replay waits for the consumer rather than losing samples. */
+    Q_OBJECT
+
+public:
+    explicit ReplaySource(const QString &capturePath, double speed = 1.0, QObject *parent = nullptr);
+    ~ReplaySource() override;
+
+    void stop() override;
+    void setFraming(FrameParser::Framing framing) { m_parser.setFraming(framing); }   // the one the capture was recorded with
+
+    quint64 samplesEmitted() const { return m_samples.load(std::memory_order_relaxed); }
+
+protected:
+    void run() override;
+
+private:
+    QString m_path;
+    double  m_speed;
+    std::atomic<bool> m_running{true};   // a stop() before run() ends the replay before its first chunk
+    std::atomic<quint64> m_samples{0};
+    FrameParser m_parser;
+};
+
+#endif // REPLAYSOURCE_H
@@ -0,0 +1,383 @@
+#include "samplejournal.h"
+#include "crc32.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QSettings>
+#include <QtEndian>
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+const char kMagic[8] = { 'Q', 'A', 'J', 'R', 'N', 'L', 0, 0 };
+constexpr quint16 kVersion = 1;
+constexpr int kHeaderSize = 64;
+constexpr int kRecordSize = 24;
+constexpr int kPayloadSize = kRecordSize - 4;   // what the record CRC covers
+
+QString segmentName(quint64 index)
+{
+    return QStringLiteral("journal-%1.qaj").arg(index, 8, 10, QLatin1Char('0'));
+}
+
+void encodeRecord(uchar *p, quint64 seq, qint64 tsUs, quint16 port, quint16 flags, float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<qint64>(tsUs, p);
+    qToLittleEndian<quint32>(quint32(seq), p + 8);
+    qToLittleEndian<quint16>(port, p + 12);
+    qToLittleEndian<quint16>(flags, p + 14);
+    qToLittleEndian<quint32>(bits, p + 16);
+    qToLittleEndian<quint32>(Crc32::compute(p, kPayloadSize), p + 20);
+}
+
+bool decodeRecord(const uchar *p, quint64 seq, SampleJournal::Sample &s)
+{/* The sequence check is what stops a stale but intact record (from before a torn tail was zeroed
+    on a machine that lost power again mid-recovery) from being taken for the next one */
+    if (qFromLittleEndian<quint32>(p + 20) != Crc32::compute(p, kPayloadSize)) return false;
+    if (qFromLittleEndian<quint32>(p + 8) != quint32(seq)) return false;
+    const quint32 bits = qFromLittleEndian<quint32>(p + 16);
+    s.seq   = seq;
+    s.tsUs  = qFromLittleEndian<qint64>(p);
+    s.port  = qFromLittleEndian<quint16>(p + 12);
+    s.flags = qFromLittleEndian<quint16>(p + 14);
+    std::memcpy(&s.value, &bits, sizeof(bits));
+    return true;
+}
+
+bool isZero(const uchar *p, int n)
+{
+    while (n-- > 0)
+        if (*p++) return false;
+    return true;
+}
+
+void flushRange(uchar *base, qint64 from, qint64 to)
+{/* MS_ASYNC only schedules the writeback on Linux, a power cut right after it still loses the data */
+    if (to <= from) return;
+#if defined(Q_OS_UNIX)
+    static const qint64 page = qint64(sysconf(_SC_PAGESIZE));
+    const qint64 start = from - from % page;
+    if (::msync(base + start, size_t(to - start), MS_SYNC) != 0)
+        qWarning() << "Journal msync failed:" << qt_error_string(errno);
+#elif defined(Q_OS_WIN)
+    if (!FlushViewOfFile(base + from, SIZE_T(to - from)))
+        qWarning() << "Journal flush failed:" << qt_error_string(int(GetLastError()));
+#else
+    Q_UNUSED(base);
+#endif
+}
+}
+
+SampleJournal::SampleJournal(const QString &dir)
+    : m_dir(dir)
+{
+}
+
+SampleJournal::~SampleJournal()
+{
+    close();
+}
+
+void SampleJournal::configure(QSettings &cfg)
+{
+    m_segmentBytes = qMax<qint64>(1, cfg.value("journal/segment_mb", m_segmentBytes >> 20).toLongLong()) << 20;
+    m_maxSegments  = qMax(1, cfg.value("journal/max_segments", m_maxSegments).toInt());
+}
+
+bool SampleJournal::open()
+{/* Closed segments are trusted as written (they were flushed before the next one was created), only the
+    last one is scanned. A segment with a broken header is set aside as .bad rather than deleted. */
+    close();
+    if (!QDir().mkpath(m_dir)) {
+        qWarning() << "Cannot create journal directory" << m_dir;
+        return false;
+    }
+    loadPorts();
+    m_cursors.clear();
+    const QDir d(m_dir);
+    for (const QString &f : d.entryList({ QStringLiteral("*.cursor") }, QDir::Files))
+        cursor(f.chopped(7));
+
+    m_segments.clear();
+    for (const QString &f : d.entryList({ QStringLiteral("journal-*.qaj") }, QDir::Files, QDir::Name)) {
+        Segment seg;
+        if (!readHeader(d.filePath(f), seg)) {
+            qWarning() << "Journal segment" << f << "has a bad header, set aside";
+            QFile::rename(d.filePath(f), d.filePath(f) + QStringLiteral(".bad"));
+            continue;
+        }
+        m_segments.append(seg);
+    }
+
+    m_torn = 0;
+    if (m_segments.isEmpty())
+        return createSegment(0, 0);
+    if (!mapSegment(m_segments.last(), true))
+        return false;
+    if (m_torn > 0) {
+        qWarning() << "Journal recovery dropped" << m_torn << "torn records from" << m_segments.last().path;
+        Metrics::counter("journal_torn_records_total", "Records discarded by journal recovery").inc(m_torn);
+    }
+    const Segment &last = m_segments.last();
+    m_nextSeq = last.firstSeq + last.count;
+    if (last.count == last.capacity) {
+        seal();
+        return createSegment(last.index + 1, m_nextSeq);
+    }
+    return true;
+}
+
+void SampleJournal::close()
+{
+    if (m_map) seal();
+}
+
+bool SampleJournal::readHeader(const QString &path, Segment &seg) const
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    const QByteArray h = f.read(kHeaderSize);
+    if (h.size() != kHeaderSize || !h.startsWith(QByteArray(kMagic, sizeof(kMagic)))) return false;
+    const uchar *p = reinterpret_cast<const uchar *>(h.constData());
+    if (qFromLittleEndian<quint32>(p + 60) != Crc32::compute(p, 60)) return false;
+    if (qFromLittleEndian<quint16>(p + 8) != kVersion || qFromLittleEndian<quint16>(p + 10) != kRecordSize) return false;
+    seg.capacity = qFromLittleEndian<quint32>(p + 12);
+    seg.index    = qFromLittleEndian<quint64>(p + 16);
+    seg.firstSeq = qFromLittleEndian<quint64>(p + 24);
+    seg.count    = seg.capacity;
+    seg.path     = path;
+    return seg.capacity > 0;
+}
+
+bool SampleJournal::createSegment(quint64 index, quint64 firstSeq)
+{/* The file is sized once up front, so appends never grow it and the mapping never moves */
+    Segment seg;
+    seg.index    = index;
+    seg.firstSeq = firstSeq;
+    seg.capacity = quint32(qBound<qint64>(1024, (m_segmentBytes - kHeaderSize) / kRecordSize, 0xFFFFFFFFll));
+    seg.path     = QDir(m_dir).filePath(segmentName(index));
+
+    uchar h[kHeaderSize] = {};
+    std::memcpy(h, kMagic, sizeof(kMagic));
+    qToLittleEndian<quint16>(kVersion, h + 8);
+    qToLittleEndian<quint16>(quint16(kRecordSize), h + 10);
+    qToLittleEndian<quint32>(seg.capacity, h + 12);
+    qToLittleEndian<quint64>(index, h + 16);
+    qToLittleEndian<quint64>(firstSeq, h + 24);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), h + 32);
+    qToLittleEndian<quint32>(Crc32::compute(h, 60), h + 60);
+
+    QFile f(seg.path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(reinterpret_cast<const char *>(h), kHeaderSize) != kHeaderSize
+        || !f.resize(kHeaderSize + qint64(seg.capacity) * kRecordSize)) {
+        qWarning() << "Cannot create journal segment" << seg.path << f.errorString();
+        return false;
+    }
+    f.close();
+    seg.count = 0;
+    m_segments.append(seg);
+    return mapSegment(m_segments.last(), false);
+}
+
+bool SampleJournal::mapSegment(Segment &seg, bool recover)
+{
+    const qint64 size = kHeaderSize + qint64(seg.capacity) * kRecordSize;
+    m_file.setFileName(seg.path);
+    if (!m_file.open(QIODevice::ReadWrite) || (m_file.size() < size && !m_file.resize(size))) {
+        qWarning() << "Cannot open journal segment" << seg.path << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    m_map = m_file.map(0, size);
+    if (!m_map) {
+        qWarning() << "Cannot map journal segment" << seg.path << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    if (recover) {
+        uchar *rec = m_map + kHeaderSize;
+        Sample s;
+        quint64 n = 0;
+        while (n < seg.capacity && decodeRecord(rec + n * kRecordSize, seg.firstSeq + n, s))
+            ++n;
+        seg.count = n;
+        for (quint64 i = n; i < seg.capacity; ++i) {
+            uchar *p = rec + i * kRecordSize;
+            if (isZero(p, kRecordSize)) continue;
+            std::memset(p, 0, kRecordSize);
+            ++m_torn;
+        }
+        if (m_torn > 0)
+            flushRange(m_map, kHeaderSize + qint64(n) * kRecordSize, size);
+    }
+    m_syncedCount = seg.count;
+    return true;
+}
+
+void SampleJournal::seal()
+{
+    sync();
+    m_file.unmap(m_map);
+    m_map = nullptr;
+    m_file.close();
+}
+
+bool SampleJournal::append(quint16 port, qint64 tsUs, float value, quint16 flags)
+{
+    if (!m_map) return false;
+    if (m_segments.last().count == m_segments.last().capacity) {
+        const quint64 next = m_segments.last().index + 1;
+        seal();
+        if (!createSegment(next, m_nextSeq)) return false;
+        applyRetention();
+    }
+    Segment &seg = m_segments.last();
+    encodeRecord(m_map + kHeaderSize + seg.count * kRecordSize, m_nextSeq, tsUs, port, flags, value);
+    ++seg.count;
+    ++m_nextSeq;
+    return true;
+}
+
+void SampleJournal::sync()
+{
+    if (!m_map) return;
+    const quint64 count = m_segments.last().count;
+    flushRange(m_map, kHeaderSize + qint64(m_syncedCount) * kRecordSize, kHeaderSize + qint64(count) * kRecordSize);
+    m_syncedCount = count;
+}
+
+quint64 SampleJournal::firstSeq() const
+{
+    return m_segments.isEmpty() ? m_nextSeq : m_segments.first().firstSeq;
+}
+
+quint64 SampleJournal::read(quint64 fromSeq, int maxSamples, QVector<Sample> &out) const
+{/* The active segment is read straight from the mapping, closed ones with plain reads. A closed
+    segment ends early at its first invalid record (the tail torn by a power cut that happened
+    while it was still active), reading then carries on with the next segment. */
+    out.clear();
+    for (int i = 0; i < m_segments.size() && out.size() < maxSamples; ++i) {
+        const Segment &seg = m_segments.at(i);
+        const quint64 end = seg.firstSeq + seg.count;
+        if (fromSeq >= end) continue;
+        fromSeq = qMax(fromSeq, seg.firstSeq);   // dropped by retention, or a gap after a torn tail
+        const quint64 n = qMin<quint64>(end - fromSeq, quint64(maxSamples - out.size()));
+        const bool active = (i == m_segments.size() - 1) && m_map;
+
+        QByteArray buf;
+        const uchar *p;
+        if (active) {
+            p = m_map + kHeaderSize + (fromSeq - seg.firstSeq) * kRecordSize;
+        } else {
+            QFile f(seg.path);
+            if (!f.open(QIODevice::ReadOnly) || !f.seek(kHeaderSize + qint64(fromSeq - seg.firstSeq) * kRecordSize)) {
+                fromSeq = end;
+                continue;
+            }
+            buf = f.read(qint64(n) * kRecordSize);
+            p = reinterpret_cast<const uchar *>(buf.constData());
+        }
+        const quint64 avail = active ? n : quint64(buf.size() / kRecordSize);
+        Sample s;
+        quint64 k = 0;
+        for (; k < avail && decodeRecord(p + k * kRecordSize, fromSeq + k, s); ++k)
+            out.append(s);
+        fromSeq = (k == n) ? fromSeq + k : end;
+    }
+    return fromSeq;
+}
+
+/*######## Ports and cursors ########*/
+void SampleJournal::loadPorts()
+{/* A last line without its newline was cut by a power loss and is ignored, the next portId() rewrites it */
+    m_portIds.clear();
+    m_portNames.clear();
+    QFile f(QDir(m_dir).filePath(QStringLiteral("ports.txt")));
+    if (!f.open(QIODevice::ReadOnly)) return;
+    const QByteArray all = f.readAll();
+    for (const QByteArray &line : all.split('\n').mid(0, all.count('\n'))) {
+        const int tab = line.indexOf('\t');
+        bool ok = false;
+        const int id = line.left(tab).toInt(&ok);
+        if (tab < 0 || !ok || id != m_portNames.size()) break;
+        const QString name = QString::fromUtf8(line.mid(tab + 1));
+        m_portIds.insert(name, quint16(id));
+        m_portNames.append(name);
+    }
+    f.close();
+    const qint64 whole = all.lastIndexOf('\n') + 1;
+    if (whole != all.size())
+        QFile::resize(f.fileName(), whole);
+}
+
+quint16 SampleJournal::portId(const QString &name)
+{
+    const auto it = m_portIds.constFind(name);
+    if (it != m_portIds.cend()) return it.value();
+    if (m_portNames.size() >= 0xFFFF) return 0xFFFF;
+    const quint16 id = quint16(m_portNames.size());
+    QFile f(QDir(m_dir).filePath(QStringLiteral("ports.txt")));
+    if (f.open(QIODevice::WriteOnly | QIODevice::Append))
+        f.write(QByteArray::number(id) + '\t' + name.toUtf8() + '\n');
+    m_portIds.insert(name, id);
+    m_portNames.append(name);
+    return id;
+}
+
+QString SampleJournal::portName(quint16 id) const
+{
+    return id < m_portNames.size() ? m_portNames.at(id) : QStringLiteral("port%1").arg(id);
+}
+
+quint64 SampleJournal::cursor(const QString &consumer) const
+{
+    const auto it = m_cursors.constFind(consumer);
+    if (it != m_cursors.cend()) return it.value();
+    QFile f(QDir(m_dir).filePath(consumer + QStringLiteral(".cursor")));
+    bool ok = false;
+    quint64 seq = 0;
+    if (f.open(QIODevice::ReadOnly))
+        seq = f.readAll().trimmed().toULongLong(&ok);
+    if (!ok) seq = firstSeq();
+    m_cursors.insert(consumer, seq);
+    return seq;
+}
+
+bool SampleJournal::setCursor(const QString &consumer, quint64 seq)
+{/* QSaveFile: after a power cut the cursor is either the old or the new value, never half of one */
+    QSaveFile f(QDir(m_dir).filePath(consumer + QStringLiteral(".cursor")));
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    f.write(QByteArray::number(seq));
+    if (!f.commit()) {
+        qWarning() << "Cannot save journal cursor" << consumer << f.errorString();
+        return false;
+    }
+    m_cursors.insert(consumer, seq);
+    return true;
+}
+
+void SampleJournal::applyRetention()
+{/* Disk use is bounded whatever the consumers do: a consumer that fell that far behind loses the
+    oldest samples, which is counted rather than silently skipped */
+    static Counter &lost = Metrics::counter("journal_samples_lost_total", "Samples deleted before every consumer read them");
+    while (m_segments.size() - 1 > m_maxSegments) {
+        const Segment seg = m_segments.takeFirst();
+        const quint64 end = seg.firstSeq + seg.count;
+        for (auto it = m_cursors.cbegin(); it != m_cursors.cend(); ++it)
+            if (it.value() < end)
+                lost.inc(end - qMax(it.value(), seg.firstSeq));
+        if (!QFile::remove(seg.path))
+            qWarning() << "Cannot delete journal segment" << seg.path;
+    }
+}
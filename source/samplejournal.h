@@ -0,0 +1,91 @@
+#ifndef SAMPLEJOURNAL_H
+#define SAMPLEJOURNAL_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QSettings;
+
+/* Raw sample journal: every reading at full rate, append only, in memory-mapped segment files
+   (journal-<index>.qaj) that are preallocated and then only ever written through the mapping.
+     header : "QAJRNL" 0x00 0x00, u16le version(1), u16le record size(24), u32le capacity (records),
+              u64le segment index, u64le first sequence number, i64le creation msecs, reserved,
+              u32le CRC-32 of the 60 bytes before it (header size 64)
+     record : i64le timestamp (µs since epoch UTC), u32le sequence (low 32 bits), u16le port id,
+              u16le flags, f32le value, u32le CRC-32 of the 20 bytes before it
+   Port ids map to names through ports.txt ("<id>\t<name>" lines), consumers keep their read position
+   in <name>.cursor files.
+
+   A record is valid when its CRC matches and its sequence number is the one expected at that slot, so
+   zero-filled space and half-written records are both rejected. After a power cut the tail of the last
+   segment may hold anything (pages reach the disk in any order); open() keeps the records up to the first
+   invalid one and zeroes everything behind it. */
+
+class SampleJournal
+{
+public:
+    enum Flag : quint16 { Simulated = 0x1, Replayed = 0x2 };
+
+    struct Sample {
+        quint64 seq = 0;
+        qint64  tsUs = 0;
+        quint16 port = 0;
+        quint16 flags = 0;
+        float   value = 0;
+    };
+
+    explicit SampleJournal(const QString &dir);
+    ~SampleJournal();
+
+    void configure(QSettings &cfg);   // [journal] group, call before open()
+    bool open();
+    void close();
+    bool isOpen() const { return m_map != nullptr; }
+    QString dir() const { return m_dir; }
+
+    quint16 portId(const QString &name);   // new names are added to ports.txt
+    QString portName(quint16 id) const;    // "port<id>" if the name line was lost with a power cut
+
+    bool append(quint16 port, qint64 tsUs, float value, quint16 flags = 0);
+    void sync();                           // flush what was appended since the last call to the disk
+
+    quint64 firstSeq() const;              // oldest sample still on disk
+    quint64 nextSeq() const { return m_nextSeq; }
+    quint64 tornRecords() const { return m_torn; }   // records dropped by the last recovery
+
+    // Up to maxSamples samples with seq >= fromSeq, oldest first. Returns the seq to continue from.
+    quint64 read(quint64 fromSeq, int maxSamples, QVector<Sample> &out) const;
+
+    quint64 cursor(const QString &consumer) const;   // firstSeq() for a consumer never seen before
+    bool setCursor(const QString &consumer, quint64 seq);
+
+private:
+    struct Segment { quint64 index = 0; quint64 firstSeq = 0; quint64 count = 0; quint32 capacity = 0; QString path; };
+
+    bool createSegment(quint64 index, quint64 firstSeq);
+    bool mapSegment(Segment &seg, bool recover);
+    bool readHeader(const QString &path, Segment &seg) const;
+    void seal();
+    void applyRetention();
+    void loadPorts();
+
+    QString m_dir;
+    qint64  m_segmentBytes = 64ll << 20;
+    int     m_maxSegments = 16;           // closed segments beyond this are deleted, oldest first
+
+    QVector<Segment> m_segments;          // oldest first, the last one is being written
+    QFile   m_file;
+    uchar  *m_map = nullptr;
+    quint64 m_syncedCount = 0;            // records of the active segment already handed to msync
+    quint64 m_nextSeq = 0;
+    quint64 m_torn = 0;
+
+    QHash<QString, quint16> m_portIds;
+    QStringList m_portNames;
+    mutable QHash<QString, quint64> m_cursors;
+};
+
+#endif // SAMPLEJOURNAL_H
@@ -0,0 +1,74 @@
+#ifndef SAMPLESOURCE_H
+#define SAMPLESOURCE_H
+
+#include <QThread>
+#include <QString>
+#include <QVector>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include "boundedqueue.h"
+
+struct SourceSample
+{/* One reading as a source produced it. channel is the FrameParser channel the frame was tagged with,
+    FrameParser::kNoChannel (-1) for an untagged frame, where the port itself is the sensor. tsUs is when
+    the source got it, stamped on the source thread: the detector, journal and shared memory use it, not
+    the time the consumer drained the queue. */
+    float  distance = 0;
+    int    channel = -1;
+    qint64 tsUs = 0;     // µs since epoch UTC, see sampleClockUs(); capture time for a replay
+};
+
+inline qint64 sampleClockUs()
+{/* Wall clock at first use plus a monotonic clock since: µs resolution, cheap enough per chunk and the
+    same on every thread, so a stamp from a source thread can be compared with one from the GUI thread */
+    static const qint64 baseUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    static const QElapsedTimer clock = [] { QElapsedTimer t; t.start(); return t; }();
+    return baseUs + clock.nsecsElapsed() / 1000;
+}
+
+using SampleQueue = BoundedQueue<SourceSample>;
+
+class SampleSource : public QThread
+{/* What ComPortManager drives: a thread that "opens" something and produces distances, each tagged
+    with the channel it came in on when one port carries several sensors.
+    ComThread is the real serial port, ReplaySource plays a capture file back through the same path,
+    SimulationSource is a virtual port generating a waveform.
+
+    Distances go into the source's bounded "ingest" queue, not into queued signals: samplesReady is
+    emitted once when the queue goes from empty to non-empty, and the consumer drains queue() from its
+    own thread. When the consumer stalls, the queue's policy decides, the event loop never grows. */
+    Q_OBJECT
+
+public:
+    explicit SampleSource(QObject *parent = nullptr)
+        : QThread(parent), m_queue(QStringLiteral("ingest"), QueueConfig()) {}
+
+    virtual void stop() = 0;
+
+    void setQueueConfig(const QueueConfig &cfg) { m_queue.setConfig(cfg); }
+    SampleQueue &queue() { return m_queue; }
+
+signals:
+    void portOpened(const QString &portName);
+    void samplesReady();                 // drain queue(), oldest first
+    void parseError(const QString &line);
+    void portOpenFailed(const QString &errorString);
+
+protected:
+    void publish(const QVector<SourceSample> &batch)
+    {/* In pieces of at most the capacity, each followed by its wake: under Block a push only waits for
+        room once an earlier piece has woken the consumer, never on a queue nobody was told about */
+        const int step = m_queue.capacity();
+        for (int at = 0; at < int(batch.size()); at += step) {
+            bool wake = false;
+            m_queue.push(batch.constData() + at, qMin(step, int(batch.size()) - at), &wake);
+            if (wake) emit samplesReady();
+        }
+    }
+    void closeQueue() { m_queue.close(); }   // from stop(), releases a producer waiting under Block
+
+private:
+    SampleQueue m_queue;
+};
+
+#endif // SAMPLESOURCE_H
@@ -1,5 +1,6 @@
 #include "scatter3dwidget.h"
 #include <algorithm>
+#include "trace.h"
 #include <GL/gl.h> //OpenGL
 /* For further knowledge of the graph generation, you may also check this link out on how it will proceed:
     https://doc.qt.io/qt-6/qml-qtdatavisualization-scatter3d.html
@@ -43,6 +44,7 @@ void Scatter3DWidget::resizeGL(int w, int h)
 
 void Scatter3DWidget::paintGL()
 {
+    QTALP_TRACE_SCOPE("ui.paint.scatter");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Projection
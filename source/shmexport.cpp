@@ -0,0 +1,173 @@
+#include "shmexport.h"
+#include "qtalp_shm.h"
+#include <QDateTime>
+#include <QSettings>
+#include <QDebug>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+quint32 roundUpPow2(int n)
+{
+    quint32 v = 1;
+    while (v < quint32(qMax(1, n)) && v < (1u << 30)) v <<= 1;
+    return v;
+}
+
+template <typename Slot>
+void beginSlot(Slot &slot, quint64 n)
+{/* Odd seq first, then the release fence keeps the payload stores behind it */
+    __atomic_store_n(&slot.seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot.index = n;
+}
+
+template <typename Slot>
+void endSlot(Slot &slot, quint64 n, quint64 *head)
+{
+    __atomic_store_n(&slot.seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(head, n + 1, __ATOMIC_RELEASE);
+}
+}
+
+ShmExport::ShmExport(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_heartbeat, &QTimer::timeout, this, &ShmExport::heartbeat);
+}
+
+ShmExport::~ShmExport()
+{
+    close();
+}
+
+bool ShmExport::open(QSettings &cfg)
+{
+    return open(cfg.value("shm/name", "/qtalp").toString(),
+                cfg.value("shm/sample_slots", 65536).toInt(),
+                cfg.value("shm/warning_slots", 4096).toInt());
+}
+
+bool ShmExport::open(const QString &name, int sampleSlots, int warningSlots)
+{/* A leftover object from an earlier run is unlinked, not reused: readers still mapping it keep their
+    copy, see heartbeat_ms stop and remap by name, which gets them the new one */
+    close();
+#ifdef Q_OS_UNIX
+    const QByteArray path = name.toLocal8Bit();
+    const quint32 nSamples = roundUpPow2(sampleSlots), nWarnings = roundUpPow2(warningSlots);
+    const size_t sampleOffset  = sizeof(qtalp_shm_header);
+    const size_t warningOffset = sampleOffset + size_t(nSamples) * sizeof(qtalp_shm_sample);
+    const size_t size          = warningOffset + size_t(nWarnings) * sizeof(qtalp_shm_warning);
+
+    ::shm_unlink(path.constData());
+    const int fd = ::shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        qWarning() << "Cannot create shared memory" << name << ":" << qt_error_string(errno);
+        return false;
+    }
+    void *mem = MAP_FAILED;
+    if (::ftruncate(fd, off_t(size)) == 0)
+        mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const int err = errno;
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        qWarning() << "Cannot map shared memory" << name << ":" << qt_error_string(err);
+        ::shm_unlink(path.constData());
+        return false;
+    }
+
+    // ftruncate zero-fills, so every slot starts with seq 0 ("not written yet")
+    m_header = static_cast<qtalp_shm_header *>(mem);
+    m_header->version           = QTALP_SHM_VERSION;
+    m_header->header_size       = quint16(sizeof(qtalp_shm_header));
+    m_header->sample_slots      = nSamples;
+    m_header->warning_slots     = nWarnings;
+    m_header->sample_slot_size  = quint32(sizeof(qtalp_shm_sample));
+    m_header->warning_slot_size = quint32(sizeof(qtalp_shm_warning));
+    m_header->sample_offset     = sampleOffset;
+    m_header->warning_offset    = warningOffset;
+    m_header->created_ms        = QDateTime::currentMSecsSinceEpoch();
+    m_header->writer_pid        = quint64(::getpid());
+    m_header->heartbeat_ms      = m_header->created_ms;
+    __atomic_store_n(&m_header->magic, QTALP_SHM_MAGIC, __ATOMIC_RELEASE);   // last: the header is complete
+
+    m_samples  = reinterpret_cast<qtalp_shm_sample *>(static_cast<char *>(mem) + sampleOffset);
+    m_warnings = reinterpret_cast<qtalp_shm_warning *>(static_cast<char *>(mem) + warningOffset);
+    m_size = size;
+    m_name = name;
+    m_sampleNext = m_warningNext = 0;
+    m_ports.clear();
+    m_heartbeat.start(1000);
+    qInfo() << "Live stream exported to shared memory" << name << "(" << nSamples << "samples," << nWarnings << "warnings )";
+    return true;
+#else
+    Q_UNUSED(sampleSlots);
+    Q_UNUSED(warningSlots);
+    qWarning() << "Shared memory export" << name << "is only available on POSIX systems";
+    return false;
+#endif
+}
+
+void ShmExport::close()
+{
+    m_heartbeat.stop();
+    if (!m_header) return;
+#ifdef Q_OS_UNIX
+    ::munmap(m_header, m_size);
+    ::shm_unlink(m_name.toLocal8Bit().constData());
+#endif
+    m_header = nullptr;
+    m_samples = nullptr;
+    m_warnings = nullptr;
+}
+
+quint16 ShmExport::portIndex(const QString &name)
+{/* The name is complete before port_count (release) makes it visible */
+    const auto it = m_ports.constFind(name);
+    if (it != m_ports.cend()) return it.value();
+    if (!m_header || m_ports.size() >= QTALP_SHM_MAX_PORTS) return 0xFFFF;
+    const quint16 idx = quint16(m_ports.size());
+    const QByteArray utf8 = name.toUtf8().left(QTALP_SHM_PORT_NAME - 1);
+    std::memcpy(m_header->port_names[idx], utf8.constData(), size_t(utf8.size()));
+    __atomic_store_n(&m_header->port_count, quint32(idx + 1), __ATOMIC_RELEASE);
+    m_ports.insert(name, idx);
+    return idx;
+}
+
+void ShmExport::publishSample(quint16 port, qint64 tsUs, float value, quint16 flags)
+{
+    if (!m_samples) return;
+    const quint64 n = m_sampleNext++;
+    qtalp_shm_sample &slot = m_samples[n & (m_header->sample_slots - 1)];
+    beginSlot(slot, n);
+    slot.ts_us = tsUs;
+    slot.value = value;
+    slot.port  = port;
+    slot.flags = flags;
+    endSlot(slot, n, &m_header->sample_head);
+}
+
+void ShmExport::publishWarning(quint16 port, qint64 tsUs, int level, double distance, double xn)
+{
+    if (!m_warnings) return;
+    const quint64 n = m_warningNext++;
+    qtalp_shm_warning &slot = m_warnings[n & (m_header->warning_slots - 1)];
+    beginSlot(slot, n);
+    slot.ts_us    = tsUs;
+    slot.distance = distance;
+    slot.xn       = xn;
+    slot.level    = quint16(level);
+    slot.port     = port;
+    endSlot(slot, n, &m_header->warning_head);
+}
+
+void ShmExport::heartbeat()
+{
+    if (m_header)
+        __atomic_store_n(&m_header->heartbeat_ms, QDateTime::currentMSecsSinceEpoch(), __ATOMIC_RELEASE);
+}
@@ -0,0 +1,47 @@
+#ifndef SHMEXPORT_H
+#define SHMEXPORT_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QTimer>
+
+struct qtalp_shm_header;
+struct qtalp_shm_sample;
+struct qtalp_shm_warning;
+class QSettings;
+
+class ShmExport : public QObject
+{/* Writer side of the shared-memory live stream, the layout and the reader rules are in qtalp_shm.h.
+    Publishing is a few stores into the mapping: no lock, no syscall, nothing a reader can slow down.
+    POSIX only; on other systems open() fails with a warning and DvClient runs without it. */
+    Q_OBJECT
+
+public:
+    explicit ShmExport(QObject *parent = nullptr);
+    ~ShmExport() override;
+
+    bool open(const QString &name, int sampleSlots, int warningSlots);
+    bool open(QSettings &cfg);   // [shm] group
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    quint16 portIndex(const QString &name);   // 0xFFFF once the port table is full
+    void publishSample(quint16 port, qint64 tsUs, float value, quint16 flags);
+    void publishWarning(quint16 port, qint64 tsUs, int level, double distance, double xn);
+
+private:
+    void heartbeat();
+
+    QString m_name;
+    qtalp_shm_header  *m_header   = nullptr;
+    qtalp_shm_sample  *m_samples  = nullptr;
+    qtalp_shm_warning *m_warnings = nullptr;
+    size_t  m_size = 0;
+    quint64 m_sampleNext = 0;
+    quint64 m_warningNext = 0;
+    QHash<QString, quint16> m_ports;
+    QTimer  m_heartbeat;
+};
+
+#endif // SHMEXPORT_H
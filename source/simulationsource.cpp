@@ -0,0 +1,141 @@
+#include "simulationsource.h"
+#include "metrics.h"
+#include "trace.h"
+#include "threadscheduling.h"
+#include <QElapsedTimer>
+#include <QSettings>
+#include <cmath>
+#include <random>
+
+namespace {
+constexpr quint64 kMaxBatch = 4096;   // upper bound of one emit, ~40 ms at 100k samples/s
+constexpr quint64 kMaxSleepUs = 10000;
+}
+
+SimulationConfig SimulationConfig::fromSettings(QSettings &cfg)
+{
+    SimulationConfig c;
+    cfg.beginGroup("simulation");
+    c.ports         = cfg.value("ports", c.ports).toInt();
+    c.rateHz        = cfg.value("rate_hz", c.rateHz).toDouble();
+    c.seed          = cfg.value("seed", c.seed).toULongLong();
+    c.base          = cfg.value("base", c.base).toDouble();
+    c.noise         = cfg.value("noise", c.noise).toDouble();
+    c.stepEverySec  = cfg.value("step_every_s", c.stepEverySec).toDouble();
+    c.stepSize      = cfg.value("step_size", c.stepSize).toDouble();
+    c.driftPerSec   = cfg.value("drift_per_s", c.driftPerSec).toDouble();
+    c.dropoutPerSec = cfg.value("dropout_per_s", c.dropoutPerSec).toDouble();
+    c.dropoutMs     = cfg.value("dropout_ms", c.dropoutMs).toInt();
+    c.stuckPerSec   = cfg.value("stuck_per_s", c.stuckPerSec).toDouble();
+    c.stuckMs       = cfg.value("stuck_ms", c.stuckMs).toInt();
+    c.minCm         = cfg.value("min_cm", c.minCm).toDouble();
+    c.maxCm         = cfg.value("max_cm", c.maxCm).toDouble();
+    cfg.endGroup();
+    c.rateHz = qBound(0.0, c.rateHz, 100000.0);
+    c.ports  = qMax(0, c.ports);
+    return c;
+}
+
+/*######## SimulatedSignal ########*/
+SimulatedSignal::SimulatedSignal(const SimulationConfig &cfg, quint64 seed)
+    : m_cfg(cfg), m_rng(seed)
+{/* Rates of 0 (unpaced) still need a time base for drift and events, 10 kHz is used then */
+    const double rate = cfg.rateHz > 0 ? cfg.rateHz : 10000.0;
+    m_dt = 1.0 / rate;
+    m_level = m_last = cfg.base;
+    m_stepEvery = cfg.stepEverySec > 0 ? qMax<quint64>(1, quint64(cfg.stepEverySec * rate)) : 0;
+}
+
+bool SimulatedSignal::next(float &out)
+{
+    ++m_index;
+    m_level += m_cfg.driftPerSec * m_dt;
+    if (m_stepEvery && m_index % m_stepEvery == 0)
+        m_level += (m_rng.generate() & 1) ? m_cfg.stepSize : -m_cfg.stepSize;
+    if (m_level < m_cfg.minCm || m_level > m_cfg.maxCm) // drift/steps stop at the range ends
+        m_level = qBound(m_cfg.minCm, m_level, m_cfg.maxCm);
+
+    if (m_dropoutLeft) { --m_dropoutLeft; return false; }
+    if (m_cfg.dropoutPerSec > 0 && m_rng.generateDouble() < m_cfg.dropoutPerSec * m_dt) {
+        m_dropoutLeft = quint64(m_cfg.dropoutMs / 1000.0 / m_dt);
+        return false;
+    }
+
+    if (m_stuckLeft) { --m_stuckLeft; out = float(m_last); return true; }
+    if (m_cfg.stuckPerSec > 0 && m_rng.generateDouble() < m_cfg.stuckPerSec * m_dt)
+        m_stuckLeft = quint64(m_cfg.stuckMs / 1000.0 / m_dt);
+
+    double v = m_level;
+    if (m_cfg.noise > 0) {
+        std::normal_distribution<double> gauss(0.0, m_cfg.noise);
+        v += gauss(m_rng);
+    }
+    m_last = qBound(m_cfg.minCm, v, m_cfg.maxCm);
+    out = float(m_last);
+    return true;
+}
+
+/*######## SimulationSource ########*/
+SimulationSource::SimulationSource(const SimulationConfig &cfg, int index, QObject *parent)
+    : SampleSource(parent), m_cfg(cfg), m_name(QStringLiteral("SIM%1").arg(index))
+    , m_seed(cfg.seed * 0x9E3779B97F4A7C15ull + quint64(index)) // distinct but reproducible per port
+{
+    setObjectName(QStringLiteral("Simulation[%1]").arg(m_name));
+}
+
+SimulationSource::~SimulationSource()
+{
+    stop();
+    wait();
+}
+
+void SimulationSource::stop()
+{
+    m_running = false;
+    closeQueue();
+}
+
+void SimulationSource::run()
+{
+    ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Acquisition);
+    static Counter &samples = Metrics::counter("samples_received_total", "Frames parsed into a distance");
+    SimulatedSignal wave(m_cfg, m_seed);
+    emit portOpened(m_name);
+
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 startUs = sampleClockUs();
+    quint64 produced = 0;   // including dropped-out slots, this is the clock of the waveform
+    QVector<SourceSample> batch;
+    batch.reserve(int(kMaxBatch));
+
+    while (m_running) {
+        quint64 due = produced + kMaxBatch;
+        if (m_cfg.rateHz > 0) {
+            due = quint64(double(clock.nsecsElapsed()) * m_cfg.rateHz / 1e9);
+            if (due <= produced) {// sleep until the next sample is due, but keep stop() responsive
+                const double waitUs = double(produced + 1) * 1e6 / m_cfg.rateHz - double(clock.nsecsElapsed()) / 1000.0;
+                usleep(quint64(qBound(1.0, waitUs, double(kMaxSleepUs))));
+                continue;
+            }
+        }
+        const quint64 n = qMin(due - produced, kMaxBatch);
+        {
+            QTALP_TRACE_SCOPE("sim.generate");
+            batch.resize(0);
+            float v;
+            // paced, a sample is stamped with the slot it was due in; unpaced, the whole batch is "now"
+            const qint64 batchUs = sampleClockUs();
+            for (quint64 i = 0; i < n; ++i) {
+                if (!wave.next(v)) continue;
+                const qint64 tsUs = m_cfg.rateHz > 0 ? startUs + qint64(double(produced + i) * 1e6 / m_cfg.rateHz) : batchUs;
+                batch.append(SourceSample{ v, -1, tsUs });
+            }
+        }
+        produced += n;
+        if (batch.isEmpty()) continue;
+        samples.inc(quint64(batch.size()));
+        m_samples.fetch_add(quint64(batch.size()), std::memory_order_relaxed);
+        publish(batch);
+    }
+}
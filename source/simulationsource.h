@@ -0,0 +1,77 @@
+#ifndef SIMULATIONSOURCE_H
+#define SIMULATIONSOURCE_H
+
+#include "samplesource.h"
+#include <QRandomGenerator>
+#include <QVector>
+#include <atomic>
+
+class QSettings;
+
+struct SimulationConfig
+{/* [simulation] group of qtalp.ini. Probabilities are "per second", durations in ms, distances in cm.
+    ports = 0 keeps the old behaviour: one random value every 5 s (DvClient), no source threads. */
+    int     ports        = 1;
+    double  rateHz       = 10.0;     // per virtual port, 0 = as fast as possible
+    quint64 seed         = 1;
+    double  base         = 105.0;    // starting level
+    double  noise        = 2.0;      // gaussian standard deviation
+    double  stepEverySec = 0.0;      // 0 = no steps
+    double  stepSize     = 40.0;     // each step jumps up or down by this much
+    double  driftPerSec  = 0.0;
+    double  dropoutPerSec = 0.0;     // chance per second that the sensor goes silent ...
+    int     dropoutMs    = 500;      // ... for this long
+    double  stuckPerSec  = 0.0;      // chance per second that the reading freezes ...
+    int     stuckMs      = 2000;     // ... for this long
+    double  minCm        = 10.0;
+    double  maxCm        = 200.0;
+
+    static SimulationConfig fromSettings(QSettings &cfg);
+};
+
+class SimulatedSignal
+{/* The waveform itself, no thread, no clock: the n-th value depends only on the seed and n,
+    so two runs with the same config produce the same sequence whatever the machine load was. */
+public:
+    SimulatedSignal(const SimulationConfig &cfg, quint64 seed);
+
+    bool next(float &out);   // false while in a dropout (the sensor sends nothing)
+
+private:
+    SimulationConfig m_cfg;
+    QRandomGenerator m_rng;
+    double  m_dt;
+    double  m_level;
+    double  m_last;
+    quint64 m_index = 0;
+    quint64 m_stepEvery;
+    quint64 m_dropoutLeft = 0;
+    quint64 m_stuckLeft = 0;
+};
+
+class SimulationSource : public SampleSource
+{/* A virtual port: paces a SimulatedSignal at cfg.rateHz and hands the values out in batches
+    (one batch per wakeup) so 100k samples/s do not mean 100k queued signals. */
+    Q_OBJECT
+
+public:
+    SimulationSource(const SimulationConfig &cfg, int index, QObject *parent = nullptr);
+    ~SimulationSource() override;
+
+    void stop() override;
+
+    QString portName() const { return m_name; }
+    quint64 samplesEmitted() const { return m_samples.load(std::memory_order_relaxed); }
+
+protected:
+    void run() override;
+
+private:
+    SimulationConfig m_cfg;
+    QString m_name;
+    quint64 m_seed;
+    std::atomic<bool> m_running{true};   // true from construction, a stop() before run() must stick
+    std::atomic<quint64> m_samples{0};
+};
+
+#endif // SIMULATIONSOURCE_H
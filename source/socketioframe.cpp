@@ -0,0 +1,29 @@
+#include "socketioframe.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+
+SocketIoFrame SocketIoFrame::parse(const QString &msg)
+{
+    SocketIoFrame f;
+    if (msg.startsWith('0'))          f.type = Type::Open;
+    else if (msg == QLatin1String("2")) f.type = Type::Ping;
+    else if (msg == QLatin1String("3")) f.type = Type::Pong;
+    else if (msg.startsWith(QLatin1String("42"))) {
+        f.type  = Type::Event;
+        f.args  = QJsonDocument::fromJson(msg.mid(2).toUtf8()).array();
+        f.event = f.args.at(0).toString();
+    }
+    else if (msg.startsWith(QLatin1String("40"))) f.type = Type::Connect;
+    return f;
+}
+
+QJsonObject SocketIoFrame::commandObject() const
+{/* The message itself is in the raw data format: {"t": "<json text>"}, the inner JSON has the command in "f" */
+    const QString tStr = args.at(1).toObject().value("t").toString();
+    return QJsonDocument::fromJson(tStr.toUtf8()).object();
+}
+
+QString SocketIoFrame::command() const
+{
+    return commandObject().value("f").toString();
+}
@@ -0,0 +1,24 @@
+#ifndef SOCKETIOFRAME_H
+#define SOCKETIOFRAME_H
+
+#include <QString>
+#include <QJsonArray>
+#include <QJsonObject>
+
+struct SocketIoFrame
+{/* One decoded Engine.IO / Socket.IO text frame as the ERP sends them:
+    "0{...}" open, "2"/"3" ping/pong, "40" namespace connect, "42[ev, args...]" event. */
+    enum class Type { Open, Ping, Pong, Connect, Event, Unknown };
+
+    Type       type = Type::Unknown;
+    QString    event;   // Event only: first array element
+    QJsonArray args;    // Event only: whole array, args.at(0) == event
+
+    static SocketIoFrame parse(const QString &msg);
+
+    // "m" events carry the actual ERP command as JSON text in args[1].t
+    QString command() const;
+    QJsonObject commandObject() const;
+};
+
+#endif // SOCKETIOFRAME_H
@@ -0,0 +1,217 @@
+#include "threadscheduling.h"
+#include "metrics.h"
+#include <QSettings>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVariant>
+#include <QDebug>
+#include <atomic>
+#include <cerrno>
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr int kStages = 3;
+const char *const kStageNames[kStages] = { "acquisition", "main", "background" };
+
+struct State {
+    QMutex            mutex;
+    std::atomic<bool> enabled{false};
+    SchedProfile      profiles[kStages];
+    QString           applied[kStages];
+    bool              warned[kStages] = {};
+};
+
+State &state()
+{
+    static State s;
+    return s;
+}
+
+QString policyName(SchedProfile::Policy p)
+{
+    switch (p) {
+    case SchedProfile::Policy::Fifo:       return QStringLiteral("fifo");
+    case SchedProfile::Policy::RoundRobin: return QStringLiteral("rr");
+    case SchedProfile::Policy::Other:      break;
+    }
+    return QStringLiteral("other");
+}
+
+QString cpuList(const QVector<int> &cpus)
+{
+    QStringList parts;
+    for (int c : cpus) parts << QString::number(c);
+    return parts.join(QLatin1Char(','));
+}
+
+SchedProfile readProfile(QSettings &cfg, const QString &stage, const SchedProfile &def)
+{/* <stage>_policy, _priority, _nice, _cpus. An unquoted "0,1" comes back from QSettings as a list. */
+    SchedProfile p = def;
+    const QString policy = cfg.value(QStringLiteral("sched/%1_policy").arg(stage), policyName(def.policy)).toString().trimmed().toLower();
+    if (policy == QLatin1String("fifo"))       p.policy = SchedProfile::Policy::Fifo;
+    else if (policy == QLatin1String("rr"))    p.policy = SchedProfile::Policy::RoundRobin;
+    else if (policy == QLatin1String("other")) p.policy = SchedProfile::Policy::Other;
+    else qWarning() << "Unknown scheduling policy" << policy << "for" << stage;
+    p.priority = qBound(1, cfg.value(QStringLiteral("sched/%1_priority").arg(stage), def.priority).toInt(), 99);
+    p.nice     = qBound(-20, cfg.value(QStringLiteral("sched/%1_nice").arg(stage), def.nice).toInt(), 19);
+    const QVariant cpus = cfg.value(QStringLiteral("sched/%1_cpus").arg(stage), cpuList(def.cpus));
+    p.cpus = SchedProfile::parseCpus(cpus.typeId() == QMetaType::QStringList ? cpus.toStringList().join(QLatin1Char(','))
+                                                                             : cpus.toString());
+    return p;
+}
+}
+
+/*######## SchedProfile ########*/
+QVector<int> SchedProfile::parseCpus(const QString &list)
+{
+    QVector<int> cpus;
+    for (const QString &part : list.split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        const QStringList range = part.trimmed().split(QLatin1Char('-'));
+        bool okA = false, okB = true;
+        const int a = range.value(0).toInt(&okA);
+        const int b = range.size() > 1 ? range.at(1).toInt(&okB) : a;
+        if (!okA || !okB || a < 0 || b < a) {
+            qWarning() << "Ignoring CPU list entry" << part;
+            continue;
+        }
+        for (int c = a; c <= b; ++c)
+            if (!cpus.contains(c)) cpus.append(c);
+    }
+    return cpus;
+}
+
+QString SchedProfile::describe() const
+{
+    QString s = policy == Policy::Other ? QStringLiteral("nice %1").arg(nice)
+                                        : QStringLiteral("%1/%2").arg(policyName(policy)).arg(priority);
+    if (!cpus.isEmpty()) s += QStringLiteral(" cpus %1").arg(cpuList(cpus));
+    return s;
+}
+
+/*######## ThreadScheduling ########*/
+void ThreadScheduling::configure(QSettings &cfg)
+{/* Defaults are for the 4-core A55 this runs on: acquisition gets core 3 to itself, everything else
+    shares 0-2, background work is niced down */
+    SchedProfile acquisition;
+    acquisition.policy   = SchedProfile::Policy::Fifo;
+    acquisition.priority = 10;
+    acquisition.nice     = -10;
+    acquisition.cpus     = { 3 };
+    SchedProfile main;
+    main.cpus = { 0, 1, 2 };
+    SchedProfile background;
+    background.nice = 10;
+    background.cpus = { 0, 1, 2 };
+
+    State &st = state();
+    {
+        QMutexLocker lock(&st.mutex);
+        st.profiles[int(Stage::Acquisition)] = readProfile(cfg, QStringLiteral("acquisition"), acquisition);
+        st.profiles[int(Stage::Main)]        = readProfile(cfg, QStringLiteral("main"), main);
+        st.profiles[int(Stage::Background)]  = readProfile(cfg, QStringLiteral("background"), background);
+    }
+    setEnabled(cfg.value("sched/enabled", false).toBool());
+}
+
+void ThreadScheduling::setProfile(Stage stage, const SchedProfile &profile)
+{
+    State &st = state();
+    {
+        QMutexLocker lock(&st.mutex);
+        st.profiles[int(stage)] = profile;
+        st.warned[int(stage)] = false;
+    }
+    setEnabled(true);
+}
+
+void ThreadScheduling::setEnabled(bool enabled)
+{
+    state().enabled.store(enabled, std::memory_order_release);
+}
+
+bool ThreadScheduling::enabled()
+{
+    return state().enabled.load(std::memory_order_acquire);
+}
+
+QString ThreadScheduling::applyToCurrentThread(Stage stage)
+{/* Affinity first, then the policy; if the real-time policy is refused the nice level is tried
+    instead, and if that is refused too the thread simply keeps the default */
+    if (!enabled()) return QString();
+    State &st = state();
+    SchedProfile p;
+    {
+        QMutexLocker lock(&st.mutex);
+        p = st.profiles[int(stage)];
+    }
+    QStringList got, refused;
+#ifdef Q_OS_LINUX
+    if (!p.cpus.isEmpty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : std::as_const(p.cpus))
+            if (c < CPU_SETSIZE) CPU_SET(c, &set);
+        const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc == 0) got << QStringLiteral("cpus %1").arg(cpuList(p.cpus));
+        else refused << QStringLiteral("cpus %1 (%2)").arg(cpuList(p.cpus), qt_error_string(rc));
+    }
+    bool realtime = false;
+    if (p.policy != SchedProfile::Policy::Other) {
+        const int policy = p.policy == SchedProfile::Policy::Fifo ? SCHED_FIFO : SCHED_RR;
+        sched_param sp{};
+        sp.sched_priority = qBound(sched_get_priority_min(policy), p.priority, sched_get_priority_max(policy));
+        const int rc = pthread_setschedparam(pthread_self(), policy, &sp);
+        if (rc == 0) {
+            realtime = true;
+            got.prepend(QStringLiteral("%1/%2").arg(policyName(p.policy)).arg(sp.sched_priority));
+        } else {
+            refused << QStringLiteral("%1/%2 (%3)").arg(policyName(p.policy)).arg(p.priority).arg(qt_error_string(rc));
+        }
+    }
+    if (!realtime && p.nice != 0) {
+        // On Linux the nice value is per thread when addressed by thread id
+        const id_t tid = id_t(::syscall(SYS_gettid));
+        if (::setpriority(PRIO_PROCESS, tid, p.nice) == 0) got.prepend(QStringLiteral("nice %1").arg(p.nice));
+        else refused << QStringLiteral("nice %1 (%2)").arg(p.nice).arg(qt_error_string(errno));
+    }
+#else
+    refused << QStringLiteral("thread scheduling is only implemented for Linux");
+#endif
+    const QString result = got.isEmpty() ? QStringLiteral("default") : got.join(QLatin1Char(' '));
+    bool warn = false;
+    {
+        QMutexLocker lock(&st.mutex);
+        st.applied[int(stage)] = result;
+        if (!refused.isEmpty() && !st.warned[int(stage)])
+            warn = st.warned[int(stage)] = true;
+    }
+    if (!refused.isEmpty()) {
+        static Counter &fallbacks = Metrics::counter("sched_fallbacks_total", "Threads that did not get their full [sched] profile");
+        fallbacks.inc();
+        if (warn)
+            qWarning().noquote() << "Scheduling" << kStageNames[int(stage)] << "threads: refused" << refused.join(QStringLiteral(", "))
+                                 << "- running with" << result;
+    }
+    return result;
+}
+
+QStringList ThreadScheduling::summaryLines()
+{
+    QStringList lines;
+    if (!enabled()) {
+        lines << QStringLiteral("disabled");
+        return lines;
+    }
+    State &st = state();
+    QMutexLocker lock(&st.mutex);
+    for (int i = 0; i < kStages; ++i)
+        lines << QStringLiteral("%1: %2 -> %3").arg(QLatin1String(kStageNames[i]), st.profiles[i].describe(),
+                                                    st.applied[i].isEmpty() ? QStringLiteral("no thread yet") : st.applied[i]);
+    return lines;
+}
@@ -0,0 +1,43 @@
+#ifndef THREADSCHEDULING_H
+#define THREADSCHEDULING_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QSettings;
+
+struct SchedProfile
+{/* How one group of threads is scheduled. priority is used by fifo/rr, nice by other and as the fallback
+    when the kernel refuses a real-time policy (no CAP_SYS_NICE / RLIMIT_RTPRIO). */
+    enum class Policy { Other, Fifo, RoundRobin };
+    Policy       policy   = Policy::Other;
+    int          priority = 0;      // 1..99
+    int          nice     = 0;      // -20..19, negative needs the same permission as fifo/rr
+    QVector<int> cpus;              // empty = wherever the scheduler likes
+
+    static QVector<int> parseCpus(const QString &list);   // "3", "0,1", "0-2"
+    QString describe() const;
+};
+
+class ThreadScheduling
+{/* [sched] group of qtalp.ini. The threads of this tree fall into three groups:
+      acquisition  every SampleSource thread (serial ports, simulation, replay)
+      main         the GUI/event loop thread, which also runs SQLite, the ERP link and the UI
+      background   log file writer, port scanning and the history scan pool (warningscan.h)
+    Each thread applies its group's profile to itself when it starts. Nothing is applied unless
+    sched/enabled is set, and a refused setting is logged once per group and otherwise ignored. */
+public:
+    enum class Stage { Acquisition, Main, Background };
+
+    static void configure(QSettings &cfg);
+    static void setProfile(Stage stage, const SchedProfile &profile);   // also enables, for benchmarks
+    static void setEnabled(bool enabled);
+    static bool enabled();
+
+    // Applies the stage's profile to the calling thread; returns what the thread actually got
+    static QString applyToCurrentThread(Stage stage);
+    static QStringList summaryLines();   // configured vs. applied per stage, for get_d_parameters
+};
+
+#endif // THREADSCHEDULING_H
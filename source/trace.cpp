@@ -0,0 +1,143 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+
+namespace {
+constexpr int kEventsPerThread   = 8192; // 8192 * 24 B = 192 KiB per traced thread
+constexpr int kMaxRetiredBuffers = 16;   // finished threads (old ComThreads) kept for the next dump
+
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<qint64> start{0};
+    std::atomic<qint64> dur{0};
+};
+
+struct ThreadBuffer {
+    quint64 tid = 0;
+    QString threadName;
+    std::atomic<quint64> written{0};
+    Event events[kEventsPerThread];
+};
+
+struct TraceRegistry {
+    QMutex mutex;
+    QList<ThreadBuffer*> live;
+    QList<ThreadBuffer*> retired;
+    quint64 nextTid = 1;
+};
+
+TraceRegistry &registry()
+{
+    static TraceRegistry r;
+    return r;
+}
+
+ThreadBuffer *registerThread()
+{
+    auto *buf = new ThreadBuffer;
+    QThread *t = QThread::currentThread();
+    QCoreApplication *app = QCoreApplication::instance();
+    buf->threadName = (t && !t->objectName().isEmpty()) ? t->objectName()
+                      : ((app && t == app->thread()) ? QStringLiteral("main") : QStringLiteral("thread"));
+    TraceRegistry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    buf->tid = r.nextTid++;
+    r.live.append(buf);
+    return buf;
+}
+
+struct ThreadHandle {
+    ThreadBuffer *buf = nullptr;
+    ~ThreadHandle()
+    {/* thread exits: keep its events for a later dump, but only the last few threads */
+        if (!buf) return;
+        TraceRegistry &r = registry();
+        QMutexLocker lock(&r.mutex);
+        r.live.removeOne(buf);
+        r.retired.append(buf);
+        while (r.retired.size() > kMaxRetiredBuffers)
+            delete r.retired.takeFirst();
+    }
+};
+
+thread_local ThreadHandle t_handle;
+
+void appendEvents(QByteArray &out, const ThreadBuffer *buf, qint64 pid, int &count)
+{/* Copy under the writer's feet, then drop whatever the writer may have overwritten meanwhile */
+    const quint64 end = buf->written.load(std::memory_order_acquire);
+    const quint64 begin = end > quint64(kEventsPerThread) ? end - kEventsPerThread : 0;
+
+    struct Copy { const char *name; qint64 start; qint64 dur; };
+    QList<Copy> copies;
+    copies.reserve(int(end - begin));
+    for (quint64 i = begin; i < end; ++i) {
+        const Event &e = buf->events[i % kEventsPerThread];
+        copies.append({ e.name.load(std::memory_order_relaxed), e.start.load(std::memory_order_relaxed),
+                        e.dur.load(std::memory_order_relaxed) });
+    }
+    const quint64 end2 = buf->written.load(std::memory_order_acquire);
+    const quint64 firstValid = end2 >= quint64(kEventsPerThread) ? end2 - kEventsPerThread + 1 : 0;
+
+    out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(pid)
+           + ",\"tid\":" + QByteArray::number(buf->tid)
+           + ",\"args\":{\"name\":\"" + buf->threadName.toUtf8() + "\"}},\n";
+    for (int k = 0; k < copies.size(); ++k) {
+        if (begin + quint64(k) < firstValid || !copies[k].name) continue;
+        out += "{\"name\":\"";
+        out += copies[k].name;
+        out += "\",\"cat\":\"qtalp\",\"ph\":\"X\",\"ts\":" + QByteArray::number(copies[k].start / 1000.0, 'f', 3)
+               + ",\"dur\":" + QByteArray::number(copies[k].dur / 1000.0, 'f', 3)
+               + ",\"pid\":" + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(buf->tid) + "},\n";
+        ++count;
+    }
+}
+}
+
+bool Tracer::compiledIn()
+{
+#ifdef QTALP_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Tracer::record(const char *name, qint64 startNs, qint64 durNs)
+{/* Single writer per buffer: fill the slot, then publish it by bumping the counter */
+    ThreadBuffer *buf = t_handle.buf;
+    if (!buf) buf = t_handle.buf = registerThread();
+    const quint64 w = buf->written.load(std::memory_order_relaxed);
+    Event &e = buf->events[w % kEventsPerThread];
+    e.name.store(name, std::memory_order_relaxed);
+    e.start.store(startNs, std::memory_order_relaxed);
+    e.dur.store(durNs, std::memory_order_relaxed);
+    buf->written.store(w + 1, std::memory_order_release);
+}
+
+int Tracer::dump(const QString &path)
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QByteArray out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    int count = 0;
+    {
+        TraceRegistry &r = registry();
+        QMutexLocker lock(&r.mutex);
+        for (const ThreadBuffer *buf : std::as_const(r.retired)) appendEvents(out, buf, pid, count);
+        for (const ThreadBuffer *buf : std::as_const(r.live))    appendEvents(out, buf, pid, count);
+    }
+    if (out.endsWith(",\n")) out.chop(2);
+    out += "\n]}\n";
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return -1;
+    f.write(out);
+    return count;
+}
@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+
+/* Scoped pipeline spans written as Chrome/Perfetto trace events.
+   Compiled out unless the build sets QTALP_ENABLE_TRACING (cmake -DQTALP_ENABLE_TRACING=ON);
+   when compiled in, every thread records into its own fixed-size ring, so memory stays bounded
+   and recording never takes a lock. Names must be string literals. */
+
+class Tracer
+{
+public:
+    static bool compiledIn();
+    static qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void record(const char *name, qint64 startNs, qint64 durNs);
+
+    // Writes everything currently held in the rings as {"traceEvents":[...]}; returns the event count or -1
+    static int dump(const QString &path);
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : m_name(name), m_start(Tracer::nowNs()) {}
+    ~TraceScope() { Tracer::record(m_name, m_start, Tracer::nowNs() - m_start); }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define QTALP_TRACE_CONCAT_(a, b) a##b
+#define QTALP_TRACE_CONCAT(a, b) QTALP_TRACE_CONCAT_(a, b)
+
+#ifdef QTALP_ENABLE_TRACING
+#define QTALP_TRACE_SCOPE(name) TraceScope QTALP_TRACE_CONCAT(qtalpTraceScope_, __LINE__)(name)
+#else
+#define QTALP_TRACE_SCOPE(name) do {} while (false)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,182 @@
+#include "uploadmanifest.h"
+#include "warningstore.h"
+#include "trace.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSqlError>
+#include <QSqlQuery>
+
+void UploadManifest::setChunkRows(int rows)
+{
+    rows = qMax(256, rows);
+    if (rows == m_chunkRows) return;
+    m_chunkRows = rows;
+    m_loaded = false;
+}
+
+bool UploadManifest::load()
+{/* Entries made with another chunk size describe boundaries that no longer exist, they go */
+    m_acked.clear();
+    m_loaded = false;
+    QSqlQuery q(m_store.database());
+    if (!q.exec(QStringLiteral(R"(
+            CREATE TABLE IF NOT EXISTS upload_chunks (
+              partition  INTEGER NOT NULL,
+              chunk      INTEGER NOT NULL,
+              chunk_rows INTEGER NOT NULL,
+              rows       INTEGER NOT NULL,
+              bytes      INTEGER NOT NULL,
+              hash       TEXT    NOT NULL,
+              PRIMARY KEY (partition, chunk)
+            ))"))) {
+        qWarning() << "Upload manifest unavailable:" << q.lastError().text();
+        return false;
+    }
+    q.prepare(QStringLiteral("DELETE FROM upload_chunks WHERE chunk_rows <> ?"));
+    q.addBindValue(m_chunkRows);
+    q.exec();
+    if (!q.exec(QStringLiteral("SELECT partition, chunk, rows, bytes, hash FROM upload_chunks"))) {
+        qWarning() << "Upload manifest unreadable:" << q.lastError().text();
+        return false;
+    }
+    while (q.next())
+        m_acked.insert(slot(q.value(0).toInt(), q.value(1).toInt()),
+                       Entry{ q.value(2).toInt(), q.value(3).toLongLong(), q.value(4).toString().toLatin1() });
+    m_loaded = true;
+    return true;
+}
+
+const UploadManifest::Entry *UploadManifest::sealed(int partition, int index) const
+{
+    const auto it = m_acked.constFind(slot(partition, index));
+    return it != m_acked.cend() && it->rows == m_chunkRows ? &*it : nullptr;
+}
+
+UploadManifest::Plan UploadManifest::plan(const QVector<WarningPartition> &parts)
+{/* Sealed chunks in front are skipped without reading; a sealed chunk further in (one whose upload
+    went through while an earlier one failed) is read past but not serialized */
+    Plan plan;
+    if (!m_loaded && !load()) {
+        plan.ok = false;
+        return plan;
+    }
+    QTALP_TRACE_SCOPE("upload.plan");
+    for (const WarningPartition &p : parts) {
+        auto skip = [&plan, this](const Entry *e) {
+            plan.rows += m_chunkRows;
+            plan.bytesAcked += e->bytes;
+            ++plan.chunksAcked;
+        };
+        int index = 0;
+        while (const Entry *e = sealed(p.id, index)) {
+            skip(e);
+            ++index;
+        }
+
+        QJsonArray logs;
+        int inChunk = 0;
+        bool skipping = false;
+        auto finish = [&]() {
+            LogChunk c;
+            c.partition = p.id;
+            c.index     = index;
+            c.rows      = inChunk;
+            c.body      = QJsonDocument(logs).toJson(QJsonDocument::Compact);
+            c.hash      = QCryptographicHash::hash(c.body, QCryptographicHash::Sha256).toHex();
+            logs = QJsonArray();
+            const auto it = m_acked.constFind(slot(p.id, index));
+            if (it != m_acked.cend() && it->hash == c.hash) {
+                plan.bytesAcked += c.body.size();
+                ++plan.chunksAcked;
+            } else {
+                plan.chunks.append(std::move(c));
+            }
+        };
+        const bool ok = m_store.scanPartitionFrom(p, qint64(index) * m_chunkRows, [&](const WarningRow &r) {
+            if (inChunk == 0) {
+                const Entry *e = sealed(p.id, index);
+                skipping = e != nullptr;
+                if (skipping) skip(e);
+            }
+            if (!skipping) {
+                // Same objects as DvClient::serializeLogs, so a chunk is a valid send_logs body on its own
+                QJsonObject e;
+                e["timestamp"] = r.timestamp;
+                e["level"]     = r.level;
+                e["distance"]  = r.distance;
+                e["Xn_val"]    = r.xn;
+                logs.append(e);
+                ++plan.rows;
+                ++plan.rowsRead;
+            }
+            if (++inChunk == m_chunkRows) {
+                if (!skipping) finish();
+                inChunk = 0;
+                ++index;
+            }
+        });
+        if (inChunk > 0 && !skipping) finish();
+        if (!ok) {
+            qWarning() << "Upload plan: cannot read partition" << p.id;
+            plan.ok = false;
+        }
+    }
+    return plan;
+}
+
+bool UploadManifest::acknowledge(const LogChunk &chunk)
+{
+    QSqlQuery q(m_store.database());
+    q.prepare(QStringLiteral("INSERT OR REPLACE INTO upload_chunks (partition, chunk, chunk_rows, rows, bytes, hash) VALUES (?, ?, ?, ?, ?, ?)"));
+    q.addBindValue(chunk.partition);
+    q.addBindValue(chunk.index);
+    q.addBindValue(m_chunkRows);
+    q.addBindValue(chunk.rows);
+    q.addBindValue(qint64(chunk.body.size()));
+    q.addBindValue(QString::fromLatin1(chunk.hash));
+    if (!q.exec()) {
+        qWarning() << "Upload manifest write failed:" << q.lastError().text();
+        return false;
+    }
+    m_acked.insert(slot(chunk.partition, chunk.index), Entry{ chunk.rows, qint64(chunk.body.size()), chunk.hash });
+    return true;
+}
+
+int UploadManifest::prune()
+{
+    QSqlQuery q(m_store.database());
+    if (!q.exec(QStringLiteral("DELETE FROM upload_chunks WHERE partition NOT IN (SELECT id FROM partitions)")))
+        return 0;
+    const int n = q.numRowsAffected();
+    if (n > 0) load();
+    return n;
+}
+
+QByteArray UploadManifest::offer(const QVector<LogChunk> &chunks, int chunkRows)
+{
+    QJsonArray list;
+    for (const LogChunk &c : chunks) {
+        QJsonObject o;
+        o["key"]   = c.key();
+        o["hash"]  = QString::fromLatin1(c.hash);
+        o["rows"]  = c.rows;
+        o["bytes"] = qint64(c.body.size());
+        list.append(o);
+    }
+    QJsonObject o;
+    o["chunk_rows"] = chunkRows;
+    o["chunks"]     = list;
+    return QJsonDocument(o).toJson(QJsonDocument::Compact);
+}
+
+QSet<QByteArray> UploadManifest::parseHave(const QByteArray &reply)
+{
+    QSet<QByteArray> have;
+    const QJsonArray list = QJsonDocument::fromJson(reply).object().value(QStringLiteral("have")).toArray();
+    for (const QJsonValue &v : list)
+        have.insert(v.toString().toLatin1());
+    return have;
+}
@@ -0,0 +1,68 @@
+#ifndef UPLOADMANIFEST_H
+#define UPLOADMANIFEST_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+class WarningStore;
+struct WarningPartition;
+
+struct LogChunk
+{/* chunkRows rows of one partition in id order, starting at row index * chunkRows, as the send_logs JSON
+    array. The same rows always give the same bytes, so the hash names the content. */
+    int        partition = 0;   // WarningPartition::id
+    int        index = 0;
+    int        rows = 0;
+    QByteArray hash;            // SHA-256 of body, hex
+    QByteArray body;
+
+    QString key() const { return QStringLiteral("p%1.%2").arg(partition).arg(index); }
+};
+
+class UploadManifest
+{/* Chunked send_logs: which chunks the ERP has acknowledged, kept in the upload_chunks table next to the
+    rows they came from (a new database starts with an empty manifest, as it should).
+
+    Partitions only grow at the end, so a full chunk never changes once written: plan() does not even read
+    the full chunks that were acknowledged, and only the tail chunk of a partition that is still filling
+    up is serialized again to see whether its hash moved. What plan() returns is offered to the ERP with
+    offer(); the reply names the hashes it already holds (parseHave), the rest is posted one chunk each. */
+public:
+    struct Plan {
+        QVector<LogChunk> chunks;   // not acknowledged with this content, in upload order
+        qint64 rows = 0;            // rows in the partitions
+        qint64 rowsRead = 0;        // rows serialized and hashed for this plan
+        qint64 bytesAcked = 0;      // body bytes of acknowledged chunks, not sent again
+        int    chunksAcked = 0;
+        bool   ok = true;           // false when a partition or the manifest could not be read
+    };
+
+    explicit UploadManifest(WarningStore &store) : m_store(store) {}
+
+    void setChunkRows(int rows);    // a new size starts a new manifest: every chunk boundary moves
+    int chunkRows() const { return m_chunkRows; }
+
+    bool load();                    // again after the store reopened its database
+    Plan plan(const QVector<WarningPartition> &parts);
+    bool acknowledge(const LogChunk &chunk);
+    int  prune();                   // forgets the chunks of partitions retention has dropped
+
+    // Manifest-diff handshake, see README "[upload]"
+    static QByteArray offer(const QVector<LogChunk> &chunks, int chunkRows);
+    static QSet<QByteArray> parseHave(const QByteArray &reply);
+
+private:
+    struct Entry { int rows = 0; qint64 bytes = 0; QByteArray hash; };
+    static quint64 slot(int partition, int index) { return (quint64(quint32(partition)) << 32) | quint32(index); }
+    const Entry *sealed(int partition, int index) const;   // acknowledged and full
+
+    WarningStore &m_store;
+    QHash<quint64, Entry> m_acked;
+    int  m_chunkRows = 8192;        // ~650 KB of JSON per chunk
+    bool m_loaded = false;
+};
+
+#endif // UPLOADMANIFEST_H
@@ -0,0 +1,36 @@
+#include "warningclassifier.h"
+#include <cmath>
+
+double WarningClassifier::xn(double distance)
+{/* Xn processing: distance in cm to mm, scaled and folded into [0, 4) */
+    double t  = 7.0 * (distance * 10.0) + 3.0;
+    double xn = std::fmod(t, 4.0);
+    if (xn < 0.0) xn += 4.0;
+    return xn;
+}
+
+QString WarningClassifier::level(double xn)
+{/* Depending on the value of the Xn, we determine our warning level,
+    whether it is in the range or not. Warning values are important because, depending on their value,
+    which level they will populate their corresponding locations on the 3D Graph*/
+    if (xn <= 1.5) return QStringLiteral("WARNING-1");
+    if (xn <= 2.1) return QStringLiteral("WARNING-2");
+    if (xn <= 3.1) return QStringLiteral("WARNING-3");
+    return QStringLiteral("WARNING-4");
+}
+
+const QString &WarningClassifier::levelName(int index)
+{
+    static const QString names[5] = { QString(), QStringLiteral("WARNING-1"), QStringLiteral("WARNING-2"),
+                                      QStringLiteral("WARNING-3"), QStringLiteral("WARNING-4") };
+    return names[index >= 1 && index <= 4 ? index : 0];
+}
+
+int WarningClassifier::levelIndex(const QString &level)
+{
+    if (level == QLatin1String("WARNING-1")) return 1;
+    if (level == QLatin1String("WARNING-2")) return 2;
+    if (level == QLatin1String("WARNING-3")) return 3;
+    if (level == QLatin1String("WARNING-4")) return 4;
+    return 0;
+}
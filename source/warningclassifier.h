@@ -0,0 +1,15 @@
+#ifndef WARNINGCLASSIFIER_H
+#define WARNINGCLASSIFIER_H
+
+#include <QString>
+
+class WarningClassifier
+{/* The Xn formula and the WARNING-1..4 thresholds, shared by the heartbeat path, the benchmarks and the UI. */
+public:
+    static double xn(double distance);
+    static QString level(double xn);
+    static int levelIndex(const QString &level); // 1..4, 0 when unknown
+    static const QString &levelName(int index);  // "WARNING-1".."WARNING-4", empty for anything else; shared, never allocates
+};
+
+#endif // WARNINGCLASSIFIER_H
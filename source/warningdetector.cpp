@@ -0,0 +1,76 @@
+#include "warningdetector.h"
+#include "warningclassifier.h"
+#include "metrics.h"
+#include <QSettings>
+#include <limits>
+
+namespace {
+// Upper edge of each level's Xn band, WarningClassifier::level() uses the same values
+constexpr double kUpper[5] = { 0.0, 1.5, 2.1, 3.1, std::numeric_limits<double>::infinity() };
+
+int rawLevel(double xn)
+{
+    for (int l = 1; l < 4; ++l)
+        if (xn <= kUpper[l]) return l;
+    return 4;
+}
+}
+
+DetectorConfig DetectorConfig::fromSettings(QSettings &cfg)
+{
+    DetectorConfig c;
+    c.debounceSamples = qMax(1, cfg.value("detector/debounce_samples", c.debounceSamples).toInt());
+    c.hysteresis      = qMax(0.0, cfg.value("detector/hysteresis", c.hysteresis).toDouble());
+    c.minIntervalMs   = qMax(0, cfg.value("detector/min_interval_ms", c.minIntervalMs).toInt());
+    c.reemitMs        = qMax(0, cfg.value("detector/reemit_ms", c.reemitMs).toInt());
+    return c;
+}
+
+int WarningDetector::classify(const SensorState &s, double xn) const
+{/* Inside the confirmed level's band widened by the hysteresis, the level does not change */
+    if (s.level > 0) {
+        const double lo = s.level == 1 ? -std::numeric_limits<double>::infinity() : kUpper[s.level - 1];
+        if (xn > lo - m_cfg.hysteresis && xn <= kUpper[s.level] + m_cfg.hysteresis)
+            return s.level;
+    }
+    return rawLevel(xn);
+}
+
+bool WarningDetector::feed(const QString &sensor, qint64 msecs, double distance, Event &ev)
+{
+    SensorState &s = m_sensors[sensor];
+    const double xn = WarningClassifier::xn(distance);
+    const int level = classify(s, xn);
+
+    ev.distance = distance;
+    ev.xn = xn;
+    if (level != s.level) {
+        if (level == s.candidate) ++s.candidateCount;
+        else { s.candidate = level; s.candidateCount = 1; }
+        if (s.candidateCount >= m_cfg.debounceSamples) {
+            s.level = level;
+            s.candidateCount = 0;
+            if (s.lastLevelMs[level] == 0 || msecs - s.lastLevelMs[level] >= m_cfg.minIntervalMs) {
+                s.lastLevelMs[level] = msecs;
+                s.lastRowMs = msecs;
+                ev.level = level;
+                ev.transition = true;
+                return true;
+            }
+            static Counter &suppressed = Metrics::counter("warnings_suppressed_total", "Level changes not stored, within min_interval_ms");
+            suppressed.inc();
+            ++m_suppressed;
+        }
+    } else {
+        s.candidateCount = 0;
+    }
+
+    if (s.level > 0 && m_cfg.reemitMs > 0 && msecs - s.lastRowMs >= m_cfg.reemitMs) {
+        s.lastLevelMs[s.level] = msecs;
+        s.lastRowMs = msecs;
+        ev.level = s.level;
+        ev.transition = false;
+        return true;
+    }
+    return false;
+}
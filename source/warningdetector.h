@@ -0,0 +1,58 @@
+#ifndef WARNINGDETECTOR_H
+#define WARNINGDETECTOR_H
+
+#include <QHash>
+#include <QString>
+
+class QSettings;
+
+struct DetectorConfig
+{/* [detector] group of qtalp.ini. hysteresis is in Xn units, the level bands are 1.5 / 2.1 / 3.1 wide apart. */
+    int    debounceSamples = 3;      // a new level must be seen this many samples in a row
+    double hysteresis      = 0.05;   // a confirmed level holds until Xn leaves its band by this much
+    int    minIntervalMs   = 1000;   // per sensor per level: a level change to L within this long of the last L row is not stored
+    int    reemitMs        = 5000;   // while the level stays, one status row per sensor this often (0 = never)
+
+    static DetectorConfig fromSettings(QSettings &cfg);
+};
+
+class WarningDetector
+{/* Turns the sample stream into warnings rows as the samples arrive, per sensor:
+    classify with hysteresis around the WARNING-1..4 thresholds, debounce level changes, and rate limit
+    what gets stored. No clock of its own, every decision uses the sample's timestamp, so a replay at
+    any speed detects exactly what the live run did. */
+public:
+    struct Event {
+        int     level = 0;           // 1..4
+        double  distance = 0;
+        double  xn = 0;
+        bool    transition = false;  // level change, false for a periodic status row
+    };
+
+    explicit WarningDetector(const DetectorConfig &cfg = DetectorConfig()) : m_cfg(cfg) {}
+    void setConfig(const DetectorConfig &cfg) { m_cfg = cfg; }
+    const DetectorConfig &config() const { return m_cfg; }
+
+    // true when this sample produces a row to store
+    bool feed(const QString &sensor, qint64 msecs, double distance, Event &ev);
+    void reset() { m_sensors.clear(); }
+
+    quint64 suppressed() const { return m_suppressed; }   // level changes held back by minIntervalMs
+
+private:
+    struct SensorState {
+        int     level = 0;           // confirmed, 0 until the first one
+        int     candidate = 0;
+        int     candidateCount = 0;
+        qint64  lastLevelMs[5] = { 0, 0, 0, 0, 0 };
+        qint64  lastRowMs = 0;
+    };
+
+    int classify(const SensorState &s, double xn) const;
+
+    DetectorConfig m_cfg;
+    QHash<QString, SensorState> m_sensors;
+    quint64 m_suppressed = 0;
+};
+
+#endif // WARNINGDETECTOR_H
@@ -0,0 +1,155 @@
+#include "warningquery.h"
+#include "trace.h"
+#include "coldarchive.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDateTime>
+#include <QVariantList>
+#include <QDebug>
+
+WarningFilter WarningFilter::lastSeconds(qint64 secs, const QStringList &levels)
+{
+    WarningFilter f;
+    f.fromTs = QDateTime::currentDateTimeUtc().addSecs(-secs).toString(Qt::ISODate) + "Z";
+    f.levels = levels;
+    return f;
+}
+
+/*######## Cursor ########*/
+QString WarningQuery::encodeKey(const Key &key)
+{// "<partition>/<id>/<timestamp>", timestamps never contain a slash
+    return QStringLiteral("%1/%2/%3").arg(key.partition).arg(key.id).arg(key.timestamp);
+}
+
+bool WarningQuery::decodeKey(const QString &cursor, Key &key)
+{
+    const QStringList parts = cursor.split(QLatin1Char('/'));
+    if (parts.size() != 3) return false;
+    bool okP = false, okId = false;
+    key.partition = parts.at(0).toInt(&okP);
+    key.id        = parts.at(1).toLongLong(&okId);
+    key.timestamp = parts.at(2);
+    return okP && okId;
+}
+
+/*######## Pages ########*/
+WarningQuery::Page WarningQuery::page(const WarningFilter &filter, const QString &cursor, int limit) const
+{/* Partitions in id order are also in time order, so the first partition that starts at or after
+    toTs ends the walk */
+    QTALP_TRACE_SCOPE("db.query");
+    Page page;
+    limit = qMax(1, limit);
+    Key after;
+    const bool hasAfter = !cursor.isEmpty() && decodeKey(cursor, after);
+    if (!cursor.isEmpty() && !hasAfter)
+        qWarning() << "Ignoring malformed warnings cursor" << cursor;
+
+    Key last;
+    for (const WarningPartition &p : m_store.partitions()) {
+        if (hasAfter && p.id < after.partition) continue;
+        if (!filter.toTs.isEmpty() && p.startTs >= filter.toTs) break;
+        if (!filter.fromTs.isEmpty() && !p.endTs.isEmpty() && p.endTs <= filter.fromTs) continue;
+        const Key *from = (hasAfter && p.id == after.partition) ? &after : nullptr;
+        const int want = limit - int(page.rows.size());
+        const bool ok = p.archive.isEmpty() ? queryTable(p, filter, from, want, page.rows, last)
+                                            : queryArchive(p, filter, from, want, page.rows, last);
+        if (!ok) {
+            page.rows.clear();
+            page.ok = false;
+            return page;
+        }
+        if (page.rows.size() >= limit) {
+            page.next = encodeKey(last);
+            break;
+        }
+    }
+    return page;
+}
+
+bool WarningQuery::stream(const WarningFilter &filter, int batchSize,
+                          const std::function<bool(const QVector<WarningRow> &)> &fn) const
+{
+    QString cursor;
+    do {
+        const Page p = page(filter, cursor, batchSize);
+        if (!p.ok) return false;
+        if (p.rows.isEmpty()) return true;
+        if (!fn(p.rows)) return true;
+        cursor = p.next;
+    } while (!cursor.isEmpty());
+    return true;
+}
+
+bool WarningQuery::queryTable(const WarningPartition &p, const WarningFilter &f, const Key *after, int limit,
+                              QVector<WarningRow> &out, Key &last) const
+{/* Positional binds only, the WHERE clause depends on which filters are set */
+    QStringList where;
+    QVariantList binds;
+    if (!f.fromTs.isEmpty()) { where << QStringLiteral("timestamp >= ?"); binds << f.fromTs; }
+    if (!f.toTs.isEmpty())   { where << QStringLiteral("timestamp < ?");  binds << f.toTs; }
+    if (!f.levels.isEmpty()) {
+        QStringList marks;
+        for (const QString &l : f.levels) { marks << QStringLiteral("?"); binds << l; }
+        where << QStringLiteral("level IN (%1)").arg(marks.join(QLatin1Char(',')));
+    }
+    if (!f.sensor.isEmpty()) { where << QStringLiteral("sensor = ?"); binds << f.sensor; }
+    if (after)               { where << QStringLiteral("(timestamp, id) > (?, ?)"); binds << after->timestamp << after->id; }
+
+    QString sql = QStringLiteral("SELECT id, timestamp, level, distance, xn, sensor FROM %1").arg(p.table);
+    if (!where.isEmpty()) sql += QStringLiteral(" WHERE ") + where.join(QStringLiteral(" AND "));
+    sql += QStringLiteral(" ORDER BY timestamp, id LIMIT ?");
+    binds << limit;
+
+    QSqlQuery q(m_store.database());
+    q.setForwardOnly(true);
+    if (!q.prepare(sql)) {
+        qWarning() << "Warnings query prepare failed:" << q.lastError().text();
+        return false;
+    }
+    for (const QVariant &b : std::as_const(binds))
+        q.addBindValue(b);
+    if (!q.exec()) {
+        qWarning() << "Warnings query failed:" << q.lastError().text();
+        return false;
+    }
+    WarningRow row;
+    while (q.next()) {
+        last.partition = p.id;
+        last.id        = q.value(0).toLongLong();
+        row.timestamp  = q.value(1).toString();
+        row.level      = q.value(2).toString();
+        row.distance   = q.value(3).toDouble();
+        row.xn         = q.value(4).toDouble();
+        row.sensor     = q.value(5).toString();
+        last.timestamp = row.timestamp;
+        out.append(row);
+    }
+    return true;
+}
+
+bool WarningQuery::queryArchive(const WarningPartition &p, const WarningFilter &f, const Key *after, int limit,
+                                QVector<WarningRow> &out, Key &last) const
+{/* Archives have no ids: the key is the row's position in the file, counted over every row so it does
+    not depend on the filter. The block index skips what lies before the cursor or outside whole seconds
+    of [from, to), the string comparison below is the exact bound like in the SQL above; decoding stops
+    once the page is full. */
+    ColdArchiveReader reader;
+    if (!reader.open(m_store.archivePath(p.archive))) {
+        qWarning() << "Query: cannot read archive" << p.archive;
+        return false;
+    }
+    const qint64 fromSecs = f.fromTs.isEmpty() ? 0 : WarningStore::epochSecs(f.fromTs);
+    const qint64 toSecs   = f.toTs.isEmpty() ? 0 : WarningStore::epochSecs(f.toTs) + 1;
+    int taken = 0;
+    return reader.scanRows(fromSecs, toSecs, after ? after->id : 0, [&](qint64 index, const WarningRow &row) {
+        if (!f.fromTs.isEmpty() && row.timestamp < f.fromTs) return true;
+        if (!f.toTs.isEmpty() && row.timestamp >= f.toTs) return true;
+        if (!f.levels.isEmpty() && !f.levels.contains(row.level)) return true;
+        if (!f.sensor.isEmpty() && row.sensor != f.sensor) return true;
+        out.append(row);
+        last.partition = p.id;
+        last.id        = index + 1;   // 1 based, as the position was counted before
+        last.timestamp = row.timestamp;
+        return ++taken < limit;
+    });
+}
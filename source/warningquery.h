@@ -0,0 +1,58 @@
+#ifndef WARNINGQUERY_H
+#define WARNINGQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include "warningstore.h"
+
+struct WarningFilter
+{/* Every field is optional: empty = no restriction. Timestamps are in the stored format
+    (or any prefix of it, "2025-08-19T12" works), fromTs inclusive, toTs exclusive. */
+    QString     fromTs;
+    QString     toTs;
+    QStringList levels;   // "WARNING-1".."WARNING-4"
+    QString     sensor;
+
+    static WarningFilter lastSeconds(qint64 secs, const QStringList &levels = {});
+};
+
+class WarningQuery
+{/* Read side of the warnings store for everything that is not the rollup history: time range, level set
+    and sensor filters, answered in (timestamp, id) order with keyset pagination. Each partition table has
+    a covering index on (timestamp, id, level, sensor, distance, xn), so a page is one index range seek
+    however deep into the result it is, and never touches the table rows. Archived partitions are
+    filtered while they are decoded and keyed by row position.
+
+    A page ends with an opaque cursor; passing it back with the same filter continues right after the
+    last row, also across partition rotation and archiving in between (the key names the partition). */
+public:
+    struct Page {
+        QVector<WarningRow> rows;
+        QString next;            // cursor for the following page, empty when there is none
+        bool ok = true;          // false on a query error, rows is empty then
+    };
+
+    explicit WarningQuery(WarningStore &store) : m_store(store) {}
+
+    Page page(const WarningFilter &filter, const QString &cursor = QString(), int limit = 1000) const;
+
+    // The whole result in batches of batchSize rows; fn returns false to stop early. False on a query error.
+    bool stream(const WarningFilter &filter, int batchSize,
+                const std::function<bool(const QVector<WarningRow> &)> &fn) const;
+
+private:
+    struct Key { int partition = 0; qint64 id = 0; QString timestamp; };
+
+    static QString encodeKey(const Key &key);
+    static bool decodeKey(const QString &cursor, Key &key);
+    bool queryTable(const WarningPartition &p, const WarningFilter &f, const Key *after, int limit,
+                    QVector<WarningRow> &out, Key &last) const;
+    bool queryArchive(const WarningPartition &p, const WarningFilter &f, const Key *after, int limit,
+                      QVector<WarningRow> &out, Key &last) const;
+
+    WarningStore &m_store;
+};
+
+#endif // WARNINGQUERY_H
@@ -0,0 +1,48 @@
+#include "warningreplayer.h"
+#include <QDateTime>
+
+namespace {
+constexpr int    kFastBatch  = 1000;    // rows per event loop turn when replaying as fast as possible
+constexpr qint64 kMaxGapMs   = 60000;   // long idle gaps in the history are cut down to a minute
+}
+
+WarningReplayer::WarningReplayer(WarningStore &store, const QString &fromTs, const QString &toTs, double speed, QObject *parent)
+    : QObject(parent), m_store(store), m_from(fromTs), m_to(toTs), m_speed(speed)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &WarningReplayer::emitNext);
+}
+
+qint64 WarningReplayer::toMsecs(const QString &ts)
+{/* stored timestamps look like 2025-08-19T12:36:19Z(Z), the first 19 characters are enough */
+    return QDateTime::fromString(ts.left(19), Qt::ISODate).toMSecsSinceEpoch();
+}
+
+bool WarningReplayer::start()
+{/* An empty bound means open ended. Only the partitions overlapping the range are read,
+    archived ones included. */
+    if (!m_store.scanRange(m_from, m_to, [this](const WarningRow &row) { m_rows.append(row); }))
+        return false;
+    m_next = 0;
+    m_timer.start(0);
+    return true;
+}
+
+void WarningReplayer::emitNext()
+{
+    int budget = m_speed > 0 ? 1 : kFastBatch;
+    while (budget-- > 0 && m_next < m_rows.size()) {
+        const WarningRow &r = m_rows.at(m_next++);
+        emit warningReplayed(r.timestamp, r.level, r.distance, r.xn);
+    }
+    if (m_next >= m_rows.size()) {
+        emit finished(m_rows.size());
+        return;
+    }
+    int delayMs = 0;
+    if (m_speed > 0) {
+        const qint64 gap = qBound<qint64>(0, toMsecs(m_rows.at(m_next).timestamp) - toMsecs(m_rows.at(m_next - 1).timestamp), kMaxGapMs);
+        delayMs = int(double(gap) / m_speed);
+    }
+    m_timer.start(delayMs);
+}
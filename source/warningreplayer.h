@@ -0,0 +1,38 @@
+#ifndef WARNINGREPLAYER_H
+#define WARNINGREPLAYER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include "warningstore.h"
+
+class WarningReplayer : public QObject
+{/* Re-emits stored warnings rows with their original spacing (divided by speed), so an incident
+    can be watched again in the UI or pushed through the upload path. speed 0 = as fast as possible. */
+    Q_OBJECT
+
+public:
+    WarningReplayer(WarningStore &store, const QString &fromTs, const QString &toTs, double speed, QObject *parent = nullptr);
+
+    bool start();
+    const QVector<WarningRow> &rows() const { return m_rows; }
+
+signals:
+    void warningReplayed(const QString &timestamp, const QString &level, double distance, double xn);
+    void finished(int rowCount);
+
+private slots:
+    void emitNext();
+
+private:
+    static qint64 toMsecs(const QString &ts);
+
+    WarningStore &m_store;
+    QString m_from, m_to;
+    double  m_speed;
+    QVector<WarningRow> m_rows;
+    int     m_next = 0;
+    QTimer  m_timer;
+};
+
+#endif // WARNINGREPLAYER_H
@@ -0,0 +1,210 @@
+#include "warningscan.h"
+#include "coldarchive.h"
+#include "metrics.h"
+#include "threadscheduling.h"
+#include "trace.h"
+#include "warningclassifier.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <atomic>
+
+namespace {
+constexpr qint64 kMmapBytes = 256LL * 1024 * 1024;   // per reader connection, address space only
+
+QString nextConnectionName()
+{
+    static std::atomic<quint64> n{0};
+    return QStringLiteral("qtalp_scan_%1").arg(n.fetch_add(1, std::memory_order_relaxed));
+}
+
+bool matches(const WarningRow &row, const WarningFilter &f)
+{/* Same string comparisons as the SQL side, for rows decoded from an archive */
+    if (!f.fromTs.isEmpty() && row.timestamp < f.fromTs) return false;
+    if (!f.toTs.isEmpty() && row.timestamp >= f.toTs) return false;
+    if (!f.levels.isEmpty() && !f.levels.contains(row.level)) return false;
+    return f.sensor.isEmpty() || row.sensor == f.sensor;
+}
+
+bool readArchive(const ScanRange &range, const WarningFilter &f, const std::function<void(const WarningRow &)> &fn)
+{
+    ColdArchiveReader reader;
+    if (!reader.open(range.source)) {
+        qWarning() << "Scan: cannot read archive" << range.source;
+        return false;
+    }
+    // Whole seconds prune the blocks, the string comparison in matches() is the exact bound
+    const qint64 fromSecs = f.fromTs.isEmpty() ? 0 : WarningStore::epochSecs(f.fromTs);
+    const qint64 toSecs   = f.toTs.isEmpty() ? 0 : WarningStore::epochSecs(f.toTs) + 1;
+    return reader.scan(fromSecs, toSecs, [&](const WarningRow &row) {
+        if (matches(row, f)) fn(row);
+    });
+}
+
+bool readTable(const QSqlDatabase &db, const ScanRange &range, const WarningFilter &f,
+               const std::function<void(const WarningRow &)> &fn)
+{/* The id range is a rowid range: a seek and a sequential walk of the table b-tree */
+    QString sql = QStringLiteral("SELECT timestamp, level, distance, xn, sensor FROM %1 WHERE id >= ? AND id < ?")
+                      .arg(range.table);
+    QVariantList binds{ range.fromId, range.toId };
+    if (!f.fromTs.isEmpty()) { sql += QStringLiteral(" AND timestamp >= ?"); binds << f.fromTs; }
+    if (!f.toTs.isEmpty())   { sql += QStringLiteral(" AND timestamp < ?");  binds << f.toTs; }
+    if (!f.levels.isEmpty()) {
+        QStringList marks;
+        for (const QString &l : f.levels) { marks << QStringLiteral("?"); binds << l; }
+        sql += QStringLiteral(" AND level IN (%1)").arg(marks.join(QLatin1Char(',')));
+    }
+    if (!f.sensor.isEmpty()) { sql += QStringLiteral(" AND sensor = ?"); binds << f.sensor; }
+    sql += QStringLiteral(" ORDER BY id");
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.prepare(sql)) {
+        qWarning() << "Scan prepare failed:" << q.lastError().text();
+        return false;
+    }
+    for (const QVariant &b : std::as_const(binds))
+        q.addBindValue(b);
+    if (!q.exec()) {
+        qWarning() << "Scan query failed:" << q.lastError().text();
+        return false;
+    }
+    WarningRow row;
+    while (q.next()) {
+        row.timestamp = q.value(0).toString();
+        row.level     = q.value(1).toString();
+        row.distance  = q.value(2).toDouble();
+        row.xn        = q.value(3).toDouble();
+        row.sensor    = q.value(4).toString();
+        fn(row);
+    }
+    return true;
+}
+}
+
+/*######## HistoryStats ########*/
+void HistoryStats::add(const WarningRow &row)
+{
+    const int stored = WarningClassifier::levelIndex(row.level);
+    ++levels[stored];
+    if (stored != WarningClassifier::levelIndex(WarningClassifier::level(row.xn))) ++reclassified;
+    if (rows == 0 || row.distance < distanceMin) distanceMin = row.distance;
+    if (rows == 0 || row.distance > distanceMax) distanceMax = row.distance;
+    distanceSum += row.distance;
+    ++histogram[qBound(0, int(row.distance / kBinCm), kBins - 1)];
+    ++rows;
+}
+
+void HistoryStats::merge(const HistoryStats &o)
+{
+    if (o.rows == 0) return;
+    distanceMin = rows == 0 ? o.distanceMin : qMin(distanceMin, o.distanceMin);
+    distanceMax = rows == 0 ? o.distanceMax : qMax(distanceMax, o.distanceMax);
+    distanceSum += o.distanceSum;
+    rows += o.rows;
+    reclassified += o.reclassified;
+    for (int i = 0; i < 5; ++i) levels[i] += o.levels[i];
+    for (int i = 0; i < kBins; ++i) histogram[i] += o.histogram[i];
+}
+
+QJsonObject HistoryStats::toJson() const
+{
+    QJsonObject perLevel;
+    for (int i = 1; i <= 4; ++i) perLevel[QStringLiteral("WARNING-%1").arg(i)] = levels[i];
+    if (levels[0]) perLevel[QStringLiteral("unknown")] = levels[0];
+    QJsonArray bins;
+    for (qint64 n : histogram) bins.append(n);
+    QJsonObject o;
+    o["rows"]          = rows;
+    o["levels"]        = perLevel;
+    o["reclassified"]  = reclassified;
+    o["distance_min"]  = distanceMin;
+    o["distance_max"]  = distanceMax;
+    o["distance_mean"] = rows ? distanceSum / double(rows) : 0.0;
+    o["bin_cm"]        = kBinCm;
+    o["histogram"]     = bins;
+    return o;
+}
+
+/*######## WarningScan ########*/
+WarningScan::WarningScan(WarningStore &store, int threads)
+    : m_store(store)
+{
+    m_pool.setMaxThreadCount(threads > 0 ? threads : QThread::idealThreadCount());
+    m_pool.setObjectName(QStringLiteral("WarningScan"));
+}
+
+WarningScan::~WarningScan()
+{/* Running ranges only hold copies of their paths and filter, but they must finish before the pool goes */
+    m_pool.waitForDone();
+}
+
+QVector<ScanRange> WarningScan::plan(const WarningFilter &filter) const
+{/* min(id)/max(id) are two rowid b-tree edge lookups per partition, so planning costs nothing next to the
+    scan. Ids are AUTOINCREMENT and never reused, gaps from deleted rows only make a range shorter. */
+    QVector<ScanRange> ranges;
+    const QString dbPath = m_store.path();
+    for (const WarningPartition &p : m_store.partitions()) {
+        if (!filter.toTs.isEmpty() && p.startTs >= filter.toTs) continue;
+        if (!filter.fromTs.isEmpty() && !p.endTs.isEmpty() && p.endTs <= filter.fromTs) continue;
+        if (!p.archive.isEmpty()) {
+            ranges.append({ m_store.archivePath(p.archive), QString(), 0, 0 });
+            continue;
+        }
+        QSqlQuery q(m_store.database());
+        if (!q.exec(QStringLiteral("SELECT min(id), max(id) FROM %1").arg(p.table)) || !q.next() || q.value(0).isNull())
+            continue;
+        const qint64 first = q.value(0).toLongLong();
+        const qint64 end   = q.value(1).toLongLong() + 1;
+        for (qint64 lo = first; lo < end; lo += m_chunkRows)
+            ranges.append({ dbPath, p.table, lo, qMin(end, lo + m_chunkRows) });
+    }
+    return ranges;
+}
+
+bool WarningScan::readRange(const ScanRange &range, const WarningFilter &filter,
+                            const std::function<void(const WarningRow &)> &fn)
+{/* A connection per range: QSqlDatabase handles are bound to the thread that made them, and opening a
+    SQLite file is a few hundred microseconds against the tens of milliseconds a range takes to read */
+    static Counter &rangesRead = Metrics::counter("scan_ranges_total", "history scan ranges read");
+    static Counter &rangesFailed = Metrics::counter("scan_ranges_failed_total", "history scan ranges that could not be read");
+    static thread_local bool scheduled = false;
+    if (!scheduled) {
+        ThreadScheduling::applyToCurrentThread(ThreadScheduling::Stage::Background);
+        scheduled = true;
+    }
+    QTALP_TRACE_SCOPE("scan.range");
+    rangesRead.inc();
+    if (range.table.isEmpty()) {
+        const bool ok = readArchive(range, filter, fn);
+        if (!ok) rangesFailed.inc();
+        return ok;
+    }
+
+    const QString name = nextConnectionName();
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+        db.setDatabaseName(range.source);
+        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+        if (!db.open()) {
+            qWarning() << "Scan: cannot open" << range.source << db.lastError().text();
+        } else {
+            QSqlQuery(db).exec(QStringLiteral("PRAGMA mmap_size=%1").arg(kMmapBytes));
+            ok = readTable(db, range, filter, fn);
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    if (!ok) rangesFailed.inc();
+    return ok;
+}
+
+QFuture<ScanResult<HistoryStats>> WarningScan::statsAsync(const WarningFilter &filter)
+{
+    return mapReduce<HistoryStats>(filter,
+        [](HistoryStats &acc, const WarningRow &row) { acc.add(row); },
+        [](HistoryStats &total, const HistoryStats &part) { total.merge(part); });
+}
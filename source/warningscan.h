@@ -0,0 +1,102 @@
+#ifndef WARNINGSCAN_H
+#define WARNINGSCAN_H
+
+#include <QFuture>
+#include <QJsonObject>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <functional>
+#include "warningquery.h"
+
+struct ScanRange
+{/* One unit of work: an id range of a partition table, or a whole archived partition */
+    QString source;      // database file, or the .qaarc file when table is empty
+    QString table;
+    qint64  fromId = 0;  // [fromId, toId)
+    qint64  toId = 0;
+};
+
+template <typename Acc>
+struct ScanResult
+{
+    Acc value{};
+    int ranges = 0;
+    int failed = 0;      // ranges that could not be read, their rows are missing from value
+    bool ok() const { return failed == 0; }
+};
+
+struct HistoryStats
+{/* The built-in reduction: per-level counts as stored, a distance histogram, and how many rows the
+    classifier would put in another level today (WarningClassifier on the stored xn). */
+    static constexpr double kBinCm = 10.0;
+    static constexpr int    kBins = 41;   // 0..400 cm in 10 cm bins, the last one open ended
+
+    qint64 rows = 0;
+    qint64 levels[5] = { 0, 0, 0, 0, 0 };   // by WarningClassifier::levelIndex, [0] = unknown level
+    qint64 reclassified = 0;
+    double distanceMin = 0, distanceMax = 0, distanceSum = 0;
+    qint64 histogram[kBins] = {};
+
+    void add(const WarningRow &row);
+    void merge(const HistoryStats &o);
+    QJsonObject toJson() const;
+};
+
+class WarningScan
+{/* Parallel full scans over the stored history, for analyses that have to see every row (reclassifying,
+    distributions) rather than a page or the rollups. plan() cuts the partitions the filter touches into
+    id ranges of chunkRows ids, archived partitions are one range each; the pool's threads take ranges as
+    they get free, each reads its range on a read-only connection of its own (WAL keeps them off the
+    writer's back), folds the rows into a per-range accumulator, and the accumulators are merged as they
+    finish. The row order inside an accumulator is by id, the merge order is not defined.
+
+    plan() reads the partition catalog, so it runs on the store's thread; everything after it only
+    needs the file paths. The store keeps inserting meanwhile: rows past a range's end when it was
+    planned are not seen. */
+public:
+    explicit WarningScan(WarningStore &store, int threads = 0);   // 0 = one per core
+    ~WarningScan();
+
+    void setChunkRows(qint64 rows) { m_chunkRows = qMax<qint64>(1024, rows); }
+    qint64 chunkRows() const { return m_chunkRows; }
+    int threads() const { return m_pool.maxThreadCount(); }
+    QThreadPool &pool() { return m_pool; }
+
+    QVector<ScanRange> plan(const WarningFilter &filter) const;
+
+    // Rows of one range that match the filter, in id order. Thread safe, false on a read error.
+    static bool readRange(const ScanRange &range, const WarningFilter &filter,
+                          const std::function<void(const WarningRow &)> &fn);
+
+    // map(Acc &, const WarningRow &) per row into a fresh Acc per range, merge(Acc &total, const Acc &part)
+    // per finished range. Map and Merge are copied into the workers, they must not refer to the caller's stack.
+    template <typename Acc, typename Map, typename Merge>
+    QFuture<ScanResult<Acc>> mapReduce(const WarningFilter &filter, Map map, Merge merge)
+    {
+        return QtConcurrent::mappedReduced<ScanResult<Acc>>(&m_pool, plan(filter),
+            [filter, map](const ScanRange &range) {
+                ScanResult<Acc> part;
+                part.ranges = 1;
+                part.failed = readRange(range, filter, [&part, &map](const WarningRow &row) { map(part.value, row); }) ? 0 : 1;
+                return part;
+            },
+            [merge](ScanResult<Acc> &total, const ScanResult<Acc> &part) {
+                merge(total.value, part.value);
+                total.ranges += part.ranges;
+                total.failed += part.failed;
+            },
+            QtConcurrent::UnorderedReduce);
+    }
+
+    QFuture<ScanResult<HistoryStats>> statsAsync(const WarningFilter &filter);
+    ScanResult<HistoryStats> stats(const WarningFilter &filter) { return statsAsync(filter).result(); }
+
+private:
+    WarningStore &m_store;
+    QThreadPool m_pool;
+    qint64 m_chunkRows = 65536;     // ~150 ranges for 10M rows: enough to even out 4 threads, few enough to ignore the opens
+};
+
+#endif // WARNINGSCAN_H
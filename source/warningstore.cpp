@@ -0,0 +1,864 @@
+#include "warningstore.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include "coldarchive.h"
+#include <QMap>
+#include <iterator>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include "metrics.h"
+#include "trace.h"
+#include "warningclassifier.h"
+
+namespace {
+const char *kPartitionColumns = R"(
+          id        INTEGER PRIMARY KEY AUTOINCREMENT,
+          timestamp TEXT    NOT NULL,
+          level     TEXT    NOT NULL,
+          distance  REAL    NOT NULL,
+          xn        REAL    NOT NULL,
+          sensor    TEXT    NOT NULL DEFAULT '')";
+
+struct RollupLevel { const char *table; int secs; int keepDaysDefault; };
+const RollupLevel kRollupLevels[] = {     // finest first
+    { "rollup_1s", 1,    2  },
+    { "rollup_1m", 60,   90 },
+    { "rollup_1h", 3600, 0  },            // 0 = kept forever
+};
+
+bool createPartitionIndex(QSqlQuery &q, const QString &table)
+{/* Covering index for WarningQuery: time range + keyset order, level/sensor filtered inside the index */
+    if (q.exec(QStringLiteral("CREATE INDEX IF NOT EXISTS %1_ts ON %1 (timestamp, id, level, sensor, distance, xn)").arg(table)))
+        return true;
+    qWarning() << "Failed to index partition" << table << ":" << q.lastError().text();
+    return false;
+}
+
+QString tsDaysAgo(int days)
+{
+    return QDateTime::currentDateTimeUtc().addDays(-days).toString(Qt::ISODate) + "Z";
+}
+
+// Proleptic Gregorian day <-> civil date (H. Hinnant's algorithms), for the stored timestamp format
+qint64 daysFromCivil(qint64 y, int m, int d)
+{
+    y -= m <= 2;
+    const qint64 era = (y >= 0 ? y : y - 399) / 400;
+    const qint64 yoe = y - era * 400;
+    const qint64 doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+void civilFromDays(qint64 z, int &y, int &m, int &d)
+{
+    z += 719468;
+    const qint64 era = (z >= 0 ? z : z - 146096) / 146097;
+    const qint64 doe = z - era * 146097;
+    const qint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const qint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const qint64 mp = (5 * doy + 2) / 153;
+    d = int(doy - (153 * mp + 2) / 5 + 1);
+    m = int(mp < 10 ? mp + 3 : mp - 9);
+    y = int(yoe + era * 400 + (m <= 2));
+}
+
+void stepRows(QSqlQuery &q, const std::function<void(const WarningRow &)> &fn)
+{/* timestamp, level, distance, xn, sensor */
+    WarningRow row;
+    while (q.next()) {
+        row.timestamp = q.value(0).toString();
+        row.level     = q.value(1).toString();
+        row.distance  = q.value(2).toDouble();
+        row.xn        = q.value(3).toDouble();
+        row.sensor    = q.value(4).toString();
+        fn(row);
+    }
+}
+
+bool sameRow(const WarningRow &a, const WarningRow &b)
+{/* Bit for bit on the doubles: the archive stores them losslessly */
+    return a.timestamp == b.timestamp && a.level == b.level && a.sensor == b.sensor
+           && std::memcmp(&a.distance, &b.distance, sizeof(double)) == 0
+           && std::memcmp(&a.xn, &b.xn, sizeof(double)) == 0;
+}
+
+int digits(const QChar *p, int n)
+{
+    int v = 0;
+    for (int i = 0; i < n; ++i) {
+        const char16_t c = p[i].unicode();
+        if (c < u'0' || c > u'9') return -1;
+        v = v * 10 + (c - u'0');
+    }
+    return v;
+}
+}
+
+WarningStore::WarningStore(const QString &connectionName)
+    : m_connectionName(connectionName)
+{
+    for (int i = 0; i < int(std::size(kRollupLevels)); ++i)
+        m_rollupKeepDays[i] = kRollupLevels[i].keepDaysDefault;
+}
+
+WarningStore::~WarningStore()
+{
+    close();
+}
+
+QString WarningStore::nowTs()
+{
+    return tsFromMSecs(QDateTime::currentMSecsSinceEpoch());
+}
+
+QString WarningStore::tsFromMSecs(qint64 msecs)
+{/* What QDateTime(UTC).toString(Qt::ISODate) + "Z" gives, "2025-08-19T12:00:00ZZ", written straight into
+    the string. Rows of the same second share the last result. */
+    static thread_local qint64 lastSecs = std::numeric_limits<qint64>::min();
+    static thread_local QString last;
+    const qint64 secs = msecs >= 0 ? msecs / 1000 : -((-msecs + 999) / 1000);
+    if (secs == lastSecs) return last;
+    const qint64 days = secs >= 0 ? secs / 86400 : -((-secs + 86399) / 86400);
+    const int sod = int(secs - days * 86400);
+    int y, m, d;
+    civilFromDays(days, y, m, d);
+    char16_t buf[21];
+    auto put = [&buf](int at, int v, int width) {
+        for (int i = width - 1; i >= 0; --i, v /= 10) buf[at + i] = char16_t(u'0' + v % 10);
+    };
+    put(0, y, 4);
+    buf[4] = u'-';  put(5, m, 2);
+    buf[7] = u'-';  put(8, d, 2);
+    buf[10] = u'T'; put(11, sod / 3600, 2);
+    buf[13] = u':'; put(14, sod / 60 % 60, 2);
+    buf[16] = u':'; put(17, sod % 60, 2);
+    buf[19] = u'Z'; buf[20] = u'Z';
+    lastSecs = secs;
+    last = QString(reinterpret_cast<const QChar *>(buf), 21);
+    return last;
+}
+
+void WarningStore::configure(QSettings &cfg)
+{
+    m_wal              = cfg.value("storage/wal", m_wal).toBool();
+    m_rotateDaily      = cfg.value("storage/rotate_daily", m_rotateDaily).toBool();
+    m_retentionDays    = cfg.value("storage/retention_days", m_retentionDays).toInt();
+    m_retentionMaxDays = qMax(m_retentionDays, cfg.value("storage/retention_max_days", m_retentionMaxDays).toInt());
+    m_rollupKeepDays[0] = cfg.value("storage/rollup_1s_days", m_rollupKeepDays[0]).toInt();
+    m_rollupKeepDays[1] = cfg.value("storage/rollup_1m_days", m_rollupKeepDays[1]).toInt();
+    m_rollupKeepDays[2] = cfg.value("storage/rollup_1h_days", m_rollupKeepDays[2]).toInt();
+    m_archiveAfterDays  = cfg.value("storage/archive_after_days", m_archiveAfterDays).toInt();
+}
+
+bool WarningStore::open(const QString &path)
+{/* Here we are initializing the SQL database for warnings, to make local storage of our values. */
+    resetStatements();
+    if (m_db.isOpen()) m_db.close();
+    m_db = QSqlDatabase::contains(m_connectionName)
+               ? QSqlDatabase::database(m_connectionName, false)
+               : QSqlDatabase::addDatabase("QSQLITE", m_connectionName); // "QSQLite" is the Qt version of SQLite
+    m_db.setDatabaseName(path);
+    if (!m_db.open()) {// if not open handle
+        qWarning() << "Cannot open SQLite:" << m_db.lastError().text();
+        return false;
+    }
+    if (m_wal && !setWal(true)) qWarning() << "Cannot enable WAL:" << m_db.lastError().text();
+    if (!createSchema()) return false;
+    applyRetention();
+    return true;
+}
+
+void WarningStore::close()
+{
+    resetStatements();
+    if (m_db.isOpen()) m_db.close();
+    m_active = WarningPartition();
+}
+
+void WarningStore::resetStatements()
+{/* Prepared statements belong to the connection, they go before it closes */
+    m_insert = QSqlQuery();
+    m_insertTable.clear();
+    for (QSqlQuery &q : m_upsert) q = QSqlQuery();
+}
+
+bool WarningStore::createSchema()
+{/* Partition catalog first. A database from before partitioning has a plain "warnings" table,
+    it becomes the first partition as it is (rename only, no copy). */
+    QSqlQuery q(m_db);
+    if (!q.exec(R"(
+        CREATE TABLE IF NOT EXISTS partitions (
+          id       INTEGER PRIMARY KEY AUTOINCREMENT,
+          tbl      TEXT    NOT NULL DEFAULT '',
+          start_ts TEXT    NOT NULL,
+          end_ts   TEXT,
+          reason   TEXT    NOT NULL DEFAULT '',
+          uploaded INTEGER NOT NULL DEFAULT 0,
+          archive  TEXT    NOT NULL DEFAULT ''
+        )
+    )")) {
+        qWarning() << "Failed to create table:" << q.lastError().text();
+        return false;
+    }
+
+    q.exec("SELECT 1 FROM pragma_table_info('partitions') WHERE name = 'archive'");
+    const bool hasArchive = q.next();
+    q.finish();
+    if (!hasArchive && !q.exec("ALTER TABLE partitions ADD COLUMN archive TEXT NOT NULL DEFAULT ''")) {
+        qWarning() << "Failed to add archive column:" << q.lastError().text();
+        return false;
+    }
+
+    q.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'warnings'");
+    if (q.next()) {
+        q.finish();
+        QString start = nowTs();
+        if (q.exec("SELECT MIN(timestamp) FROM warnings") && q.next() && !q.value(0).isNull())
+            start = q.value(0).toString();
+        q.finish();
+        if (!m_db.transaction()) return false;
+        QSqlQuery ins(m_db);
+        ins.prepare("INSERT INTO partitions (start_ts) VALUES (:start)");
+        ins.bindValue(":start", start);
+        const bool ok = ins.exec();
+        const QString table = QStringLiteral("warnings_p%1").arg(ins.lastInsertId().toInt());
+        if (!ok || !q.exec(QStringLiteral("UPDATE partitions SET tbl = '%1' WHERE id = %2").arg(table).arg(ins.lastInsertId().toInt()))
+            || !q.exec(QStringLiteral("ALTER TABLE warnings RENAME TO %1").arg(table))) {
+            qWarning() << "Failed to migrate warnings table:" << q.lastError().text();
+            m_db.rollback();
+            return false;
+        }
+        m_db.commit();
+        qInfo() << "Migrated warnings table into partition" << table;
+    }
+
+    // Partitions from before per-sensor rollups have no sensor column, adding one is a schema-only change
+    for (const WarningPartition &p : partitions()) {
+        if (!p.archive.isEmpty()) continue;
+        q.exec(QStringLiteral("SELECT 1 FROM pragma_table_info('%1') WHERE name = 'sensor'").arg(p.table));
+        const bool hasSensor = q.next();
+        q.finish();
+        if (!hasSensor && !q.exec(QStringLiteral("ALTER TABLE %1 ADD COLUMN sensor TEXT NOT NULL DEFAULT ''").arg(p.table)))
+            qWarning() << "Failed to add sensor column to" << p.table << ":" << q.lastError().text();
+        createPartitionIndex(q, p.table);
+    }
+
+    if (q.exec("SELECT id, tbl, start_ts FROM partitions WHERE end_ts IS NULL ORDER BY id DESC LIMIT 1") && q.next()) {
+        m_active = WarningPartition();
+        m_active.id      = q.value(0).toInt();
+        m_active.table   = q.value(1).toString();
+        m_active.startTs = q.value(2).toString();
+        q.finish();
+        return pointView() && createRollups();
+    }
+    q.finish();
+    if (!m_db.transaction()) return false;
+    if (!createPartition(nowTs()) || !pointView()) {
+        m_db.rollback();
+        return false;
+    }
+    return m_db.commit() && createRollups();
+}
+
+bool WarningStore::createPartition(const QString &startTs)
+{/* Caller holds the transaction */
+    QSqlQuery q(m_db);
+    q.prepare("INSERT INTO partitions (start_ts) VALUES (:start)");
+    q.bindValue(":start", startTs);
+    if (!q.exec()) return false;
+    const int id = q.lastInsertId().toInt();
+    const QString table = QStringLiteral("warnings_p%1").arg(id);
+    if (!q.exec(QStringLiteral("UPDATE partitions SET tbl = '%1' WHERE id = %2").arg(table).arg(id))
+        || !q.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS %1 (%2)").arg(table, QLatin1String(kPartitionColumns)))) {
+        qWarning() << "Failed to create partition:" << q.lastError().text();
+        return false;
+    }
+    if (!createPartitionIndex(q, table)) return false;
+    m_active = WarningPartition();
+    m_active.id      = id;
+    m_active.table   = table;
+    m_active.startTs = startTs;
+    return true;
+}
+
+bool WarningStore::pointView()
+{/* "warnings" always shows the active partition */
+    QSqlQuery q(m_db);
+    if (!q.exec("DROP VIEW IF EXISTS warnings")
+        || !q.exec(QStringLiteral("CREATE VIEW warnings AS SELECT * FROM %1").arg(m_active.table))) {
+        qWarning() << "Failed to create warnings view:" << q.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool WarningStore::rotate(const QString &reason, const QString &startTs)
+{/* Closes the active partition and starts an empty one. Nothing is deleted here: the closed partition
+    waits for an upload (or the hard retention limit) before applyRetention() drops it. */
+    QTALP_TRACE_SCOPE("db.rotate");
+    const QString start = startTs.isEmpty() ? nowTs() : startTs;
+    const WarningPartition previous = m_active;
+    if (!m_db.transaction()) return false;
+    QSqlQuery q(m_db);
+    q.prepare("UPDATE partitions SET end_ts = :end, reason = :reason WHERE id = :id");
+    q.bindValue(":end", start);
+    q.bindValue(":reason", reason);
+    q.bindValue(":id", previous.id);
+    if (!q.exec() || !createPartition(start) || !pointView()) {
+        m_db.rollback();
+        m_active = previous;
+        Metrics::counter("db_rotate_failures_total").inc();
+        return false;
+    }
+    if (!m_db.commit()) {
+        m_active = previous;
+        return false;
+    }
+    qInfo() << "Warnings partition" << previous.table << "closed (" << reason << "), now writing" << m_active.table;
+    applyRetention();
+    return true;
+}
+
+QVector<WarningPartition> WarningStore::partitions() const
+{
+    QVector<WarningPartition> out;
+    QSqlQuery q(m_db);
+    q.exec("SELECT id, tbl, start_ts, end_ts, reason, uploaded, archive FROM partitions ORDER BY id");
+    while (q.next()) {
+        WarningPartition p;
+        p.id       = q.value(0).toInt();
+        p.table    = q.value(1).toString();
+        p.startTs  = q.value(2).toString();
+        p.endTs    = q.value(3).toString();
+        p.reason   = q.value(4).toString();
+        p.uploaded = q.value(5).toBool();
+        p.archive  = q.value(6).toString();
+        out.append(p);
+    }
+    return out;
+}
+
+QStringList WarningStore::partitionsFor(const QString &fromTs, const QString &toTs) const
+{/* A partition covers [start_ts, end_ts), the active one is open ended. Archived ones have no table. */
+    QString sql = QStringLiteral("SELECT tbl FROM partitions WHERE archive = ''");
+    if (!toTs.isEmpty())   sql += QStringLiteral(" AND start_ts < :to");
+    if (!fromTs.isEmpty()) sql += QStringLiteral(" AND (end_ts IS NULL OR end_ts > :from)");
+    sql += QStringLiteral(" ORDER BY id");
+    QSqlQuery q(m_db);
+    q.prepare(sql);
+    if (!toTs.isEmpty())   q.bindValue(":to", toTs);
+    if (!fromTs.isEmpty()) q.bindValue(":from", fromTs);
+    QStringList tables;
+    if (q.exec())
+        while (q.next()) tables.append(q.value(0).toString());
+    return tables;
+}
+
+QString WarningStore::rangeSource(const QString &fromTs, const QString &toTs, QVariantList &binds) const
+{/* A parenthesized sub-select over just the partitions the range touches, for "SELECT ... FROM <this>".
+    Placeholders are positional, the values are appended to binds in order. SQLite-resident rows only,
+    scanRange() also covers the cold archive. */
+    QString where;
+    if (!fromTs.isEmpty()) where += QStringLiteral(" AND timestamp >= ?");
+    if (!toTs.isEmpty())   where += QStringLiteral(" AND timestamp < ?");
+    QStringList parts;
+    for (const QString &table : partitionsFor(fromTs, toTs)) {
+        parts.append(QStringLiteral("SELECT * FROM %1 WHERE 1=1%2").arg(table, where));
+        if (!fromTs.isEmpty()) binds.append(fromTs);
+        if (!toTs.isEmpty())   binds.append(toTs);
+    }
+    if (parts.isEmpty())
+        return QStringLiteral("(SELECT * FROM %1 WHERE 0)").arg(m_active.table);
+    return QLatin1Char('(') + parts.join(QStringLiteral(" UNION ALL ")) + QLatin1Char(')');
+}
+
+QVector<WarningPartition> WarningStore::pendingUploads() const
+{
+    QVector<WarningPartition> out;
+    for (const WarningPartition &p : partitions())
+        if (!p.endTs.isEmpty() && !p.uploaded) out.append(p);
+    return out;
+}
+
+bool WarningStore::markUploaded(const QVector<int> &ids)
+{
+    QSqlQuery q(m_db);
+    q.prepare("UPDATE partitions SET uploaded = 1 WHERE id = :id");
+    for (int id : ids) {
+        q.bindValue(":id", id);
+        if (!q.exec()) return false;
+    }
+    return true;
+}
+
+int WarningStore::applyRetention()
+{/* Reset partitions go as soon as they are uploaded, day partitions after retention_days once uploaded,
+    everything closed after retention_max_days. DROP TABLE frees pages, it does not scan rows.
+    SQLite refuses a DROP while another statement on this connection is still stepping (e.g. the UI model's
+    lazy fetch); such a partition is simply kept and retried on the next open, rotation or upload. */
+    QSqlQuery q(m_db);
+    q.prepare(R"(SELECT id, tbl, archive FROM partitions WHERE end_ts IS NOT NULL AND
+                 ((uploaded = 1 AND (reason = 'reset' OR end_ts < :soft)) OR end_ts < :hard))");
+    q.bindValue(":soft", tsDaysAgo(m_retentionDays));
+    q.bindValue(":hard", tsDaysAgo(m_retentionMaxDays));
+    if (!q.exec()) return 0;
+    struct Doomed { int id; QString table, archive; };
+    QVector<Doomed> doomed;
+    while (q.next()) doomed.append({ q.value(0).toInt(), q.value(1).toString(), q.value(2).toString() });
+    q.finish();
+
+    int dropped = 0;
+    for (const Doomed &p : std::as_const(doomed)) {
+        if (p.id == m_active.id) continue;
+        if ((p.archive.isEmpty() && !q.exec(QStringLiteral("DROP TABLE IF EXISTS %1").arg(p.table)))
+            || !q.exec(QStringLiteral("DELETE FROM partitions WHERE id = %1").arg(p.id))) {
+            qWarning() << "Failed to drop partition" << p.table << ":" << q.lastError().text();
+            continue;
+        }
+        if (!p.archive.isEmpty()) QFile::remove(archivePath(p.archive));
+        ++dropped;
+    }
+    if (dropped) {
+        Metrics::counter("db_partitions_dropped_total").inc(quint64(dropped));
+        qInfo() << "Retention dropped" << dropped << "warnings partition(s)";
+    }
+
+    // Rollups outlive the raw rows; the fine ones are trimmed on their own schedule (bucket is the key prefix)
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    for (int i = 0; i < int(std::size(kRollupLevels)); ++i) {
+        const int keepDays = m_rollupKeepDays[i];
+        if (keepDays <= 0) continue;
+        q.prepare(QStringLiteral("DELETE FROM %1 WHERE bucket < :cutoff").arg(QLatin1String(kRollupLevels[i].table)));
+        q.bindValue(":cutoff", now - qint64(keepDays) * 86400);
+        q.exec();
+    }
+    return dropped;
+}
+
+/*######## Cold archive ########*/
+QString WarningStore::archivePath(const QString &fileName) const
+{/* Archives sit in archive/ next to the database file, the catalog only keeps the file name */
+    return QFileInfo(path()).absoluteDir().filePath(QStringLiteral("archive/") + fileName);
+}
+
+int WarningStore::archiveClosed()
+{/* Everything archiveCandidates() names, built and committed on this thread */
+    int archived = 0;
+    for (const WarningPartition &p : archiveCandidates()) {
+        const QString file = archiveFileFor(p);
+        QString error;
+        if (!buildArchive(path(), p, file, &error)) {
+            qWarning() << "Partition" << p.table << "not archived:" << error;
+            continue;
+        }
+        if (commitArchive(p, file)) ++archived;
+    }
+    return archived;
+}
+
+QVector<WarningPartition> WarningStore::archiveCandidates() const
+{
+    QVector<WarningPartition> out;
+    if (m_archiveAfterDays < 0 || !m_db.isOpen()) return out;
+    const QString cutoff = tsDaysAgo(m_archiveAfterDays);
+    for (const WarningPartition &p : partitions())
+        if (!p.endTs.isEmpty() && p.archive.isEmpty() && p.endTs < cutoff && p.id != m_active.id)
+            out.append(p);
+    return out;
+}
+
+bool WarningStore::buildArchive(const QString &dbPath, const WarningPartition &p, const QString &file, QString *error)
+{/* The file is written, then read back and compared with the rows field by field; a partition that cannot
+    be archived losslessly (odd timestamp text, unknown level, long sensor name) stays in SQLite. A closed
+    partition gets no more rows, and WAL keeps this reader off the writer's back. */
+    static std::atomic<quint64> connections{0};
+    QTALP_TRACE_SCOPE("db.archive");
+    auto fail = [error](const QString &why) {
+        if (error) *error = why;
+        return false;
+    };
+    const QString name = QStringLiteral("qtalp_archive_%1").arg(connections.fetch_add(1, std::memory_order_relaxed));
+    QVector<WarningRow> rows;
+    QString readError;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+        db.setDatabaseName(dbPath);
+        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+        if (!db.open()) {
+            readError = db.lastError().text();
+        } else {
+            QSqlQuery q(db);
+            q.setForwardOnly(true);
+            if (q.exec(QStringLiteral("SELECT timestamp, level, distance, xn, sensor FROM %1 ORDER BY id").arg(p.table)))
+                stepRows(q, [&rows](const WarningRow &r) { rows.append(r); });
+            else
+                readError = q.lastError().text();
+            q.finish();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    if (!readError.isEmpty()) return fail(readError);
+
+    QDir().mkpath(QFileInfo(file).absolutePath());
+    if (!ColdArchiveWriter::write(file, rows, error)) return false;
+    ColdArchiveReader check;
+    qint64 i = 0;
+    bool same = true;
+    const bool read = check.open(file) && check.scan(0, 0, [&](const WarningRow &r) {
+        if (i >= rows.size() || !sameRow(r, rows.at(i))) same = false;
+        ++i;
+    });
+    if (!read || !same || i != rows.size()) {
+        QFile::remove(file);
+        return fail(QStringLiteral("read back differs from the table"));
+    }
+    return true;
+}
+
+bool WarningStore::commitArchive(const WarningPartition &p, const QString &file)
+{/* One transaction. The partition may have been dropped or archived meanwhile: then the file goes. */
+    const QString fileName = QFileInfo(file).fileName();
+    QSqlQuery q(m_db);
+    bool ok = m_db.transaction();
+    if (ok) {
+        q.prepare("UPDATE partitions SET archive = :file WHERE id = :id AND archive = ''");
+        q.bindValue(":file", fileName);
+        q.bindValue(":id", p.id);
+        ok = q.exec() && q.numRowsAffected() == 1
+             && q.exec(QStringLiteral("DROP TABLE IF EXISTS %1").arg(p.table)) && m_db.commit();
+        if (!ok) {
+            qWarning() << "Failed to archive" << p.table << ":" << q.lastError().text();
+            m_db.rollback();
+        }
+    }
+    if (!ok) {
+        QFile::remove(file);
+        return false;
+    }
+    Metrics::counter("db_partitions_archived_total").inc();
+    qInfo() << "Archived" << p.table << "(" << QFileInfo(file).size() << "bytes)";
+    return true;
+}
+
+bool WarningStore::scanPartition(const WarningPartition &p, const QString &fromTs, const QString &toTs,
+                                 const std::function<void(const WarningRow &)> &fn) const
+{/* One partition, from its table or from its archive file, the caller cannot tell which */
+    if (!p.archive.isEmpty()) {
+        ColdArchiveReader reader;
+        if (!reader.open(archivePath(p.archive))) {
+            qWarning() << "Cannot read archive" << p.archive;
+            return false;
+        }
+        return reader.scan(fromTs.isEmpty() ? 0 : epochSecs(fromTs), toTs.isEmpty() ? 0 : epochSecs(toTs), fn);
+    }
+    QString sql = QStringLiteral("SELECT timestamp, level, distance, xn, sensor FROM %1 WHERE 1=1").arg(p.table);
+    if (!fromTs.isEmpty()) sql += QStringLiteral(" AND timestamp >= :from");
+    if (!toTs.isEmpty())   sql += QStringLiteral(" AND timestamp < :to");
+    sql += QStringLiteral(" ORDER BY id");
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    q.prepare(sql);
+    if (!fromTs.isEmpty()) q.bindValue(":from", fromTs);
+    if (!toTs.isEmpty())   q.bindValue(":to", toTs);
+    if (!q.exec()) return false;
+    stepRows(q, fn);
+    return true;
+}
+
+bool WarningStore::scanPartitionFrom(const WarningPartition &p, qint64 firstRow,
+                                     const std::function<void(const WarningRow &)> &fn) const
+{/* OFFSET walks the rowid b-tree without decoding the rows it passes. An archive has no ids, its
+    rows are in the same order and the blocks before firstRow are not read. */
+    if (!p.archive.isEmpty()) {
+        ColdArchiveReader reader;
+        if (!reader.open(archivePath(p.archive))) {
+            qWarning() << "Cannot read archive" << p.archive;
+            return false;
+        }
+        return reader.scanRows(0, 0, qMax<qint64>(0, firstRow), [&fn](qint64, const WarningRow &row) {
+            fn(row);
+            return true;
+        });
+    }
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    q.prepare(QStringLiteral("SELECT timestamp, level, distance, xn, sensor FROM %1 ORDER BY id LIMIT -1 OFFSET ?").arg(p.table));
+    q.addBindValue(qMax<qint64>(0, firstRow));
+    if (!q.exec()) return false;
+    stepRows(q, fn);
+    return true;
+}
+
+bool WarningStore::scanRange(const QString &fromTs, const QString &toTs,
+                             const std::function<void(const WarningRow &)> &fn) const
+{/* Every partition overlapping [from, to), SQLite or archive, oldest first */
+    bool ok = true;
+    for (const WarningPartition &p : partitions()) {
+        if (!toTs.isEmpty() && p.startTs >= toTs) continue;
+        if (!fromTs.isEmpty() && !p.endTs.isEmpty() && p.endTs <= fromTs) continue;
+        ok = scanPartition(p, fromTs, toTs, fn) && ok;
+    }
+    return ok;
+}
+
+bool WarningStore::setWal(bool enable)
+{/* WAL lets readers (UI, uploads) run next to the writer; NORMAL sync is durable across app crashes */
+    QSqlQuery q(m_db);
+    if (!q.exec(enable ? "PRAGMA journal_mode=WAL" : "PRAGMA journal_mode=DELETE"))
+        return false;
+    return q.exec(enable ? "PRAGMA synchronous=NORMAL" : "PRAGMA synchronous=FULL");
+}
+
+bool WarningStore::insert(const WarningRow &row)
+{/* This SQL condition handles to sets our calculated and read values to store in our local Database.
+    The row and its three rollup buckets are one transaction, so they never disagree. */
+    QTALP_TRACE_SCOPE("db.insert");
+    if (m_rotateDaily && QStringView(row.timestamp).left(10) != QStringView(m_active.startTs).left(10))
+        rotate(QStringLiteral("day"), row.timestamp);
+    static Histogram &latency = Metrics::histogram("db_insert_latency_ns", "Single row insert, prepare to commit");
+    QElapsedTimer timer;
+    timer.start();
+    if (!m_db.transaction()) return false;
+    if (!insertRows(&row, 1) || !m_db.commit()) {
+        qWarning() << "DB insert failed:" << m_db.lastError().text();
+        m_db.rollback();
+        Metrics::counter("db_insert_failures_total").inc();
+        return false;
+    }
+    latency.record(quint64(timer.nsecsElapsed()));
+    return true;
+}
+
+bool WarningStore::insertBatch(const QVector<WarningRow> &rows)
+{/* One transaction and one prepared statement for the whole batch, one fsync instead of one per row */
+    QTALP_TRACE_SCOPE("db.insert_batch");
+    static Histogram &latency = Metrics::histogram("db_batch_insert_latency_ns", "Batched insert, begin to commit");
+    if (rows.isEmpty()) return true;
+    if (m_rotateDaily && QStringView(rows.constFirst().timestamp).left(10) != QStringView(m_active.startTs).left(10))
+        rotate(QStringLiteral("day"), rows.constFirst().timestamp);
+    QElapsedTimer timer;
+    timer.start();
+    if (!m_db.transaction()) return false;
+    if (!insertRows(rows.constData(), int(rows.size())) || !m_db.commit()) {
+        qWarning() << "DB batch insert failed:" << m_db.lastError().text();
+        m_db.rollback();
+        Metrics::counter("db_insert_failures_total").inc();
+        return false;
+    }
+    latency.record(quint64(timer.nsecsElapsed()));
+    return true;
+}
+
+bool WarningStore::insertRows(const WarningRow *rows, int count)
+{/* Caller holds the transaction. Raw rows into the active partition, then the rollups.
+    The statement stays prepared until the partition rotates; values are bound by position, a named
+    placeholder would build a QString per bind. */
+    if (m_insertTable != m_active.table) {
+        m_insert = QSqlQuery(m_db);
+        if (!m_insert.prepare(QStringLiteral("INSERT INTO %1 (timestamp, level, distance, xn, sensor) VALUES (?, ?, ?, ?, ?)").arg(m_active.table))) {
+            qWarning() << "DB insert prepare failed:" << m_insert.lastError().text();
+            m_insertTable.clear();
+            return false;
+        }
+        m_insertTable = m_active.table;
+    }
+    for (int i = 0; i < count; ++i) {
+        const WarningRow &row = rows[i];
+        m_insert.bindValue(0, row.timestamp);
+        m_insert.bindValue(1, row.level);
+        m_insert.bindValue(2, row.distance);
+        m_insert.bindValue(3, row.xn);
+        m_insert.bindValue(4, row.sensor);
+        if (!m_insert.exec()) {
+            qWarning() << "DB insert failed:" << m_insert.lastError().text();
+            m_insert.finish();
+            return false;
+        }
+    }
+    m_insert.finish();
+    if (!m_rollupsFromInserts) return true;
+    m_rollupScratch.resize(count);
+    for (int i = 0; i < count; ++i) {
+        RollupSample &smp = m_rollupScratch[i];
+        smp.secs     = epochSecs(rows[i].timestamp);
+        smp.sensor   = rows[i].sensor;
+        smp.distance = rows[i].distance;
+        smp.level    = WarningClassifier::levelIndex(rows[i].level);
+    }
+    return upsertRollups(m_rollupScratch.constData(), count);
+}
+
+bool WarningStore::addRollupSamples(const QVector<RollupSample> &samples)
+{
+    if (samples.isEmpty()) return true;
+    if (!m_db.transaction()) {
+        qWarning() << "Rollup transaction failed:" << m_db.lastError().text();
+        return false;
+    }
+    if (!upsertRollups(samples.constData(), int(samples.size())) || !m_db.commit()) {
+        m_db.rollback();
+        return false;
+    }
+    return true;
+}
+
+/*######## Rollups ########*/
+qint64 WarningStore::epochSecs(const QString &ts)
+{/* Stored timestamps are UTC with a doubled Z, the first 19 characters are the wall time. That layout is
+    read in place; anything else (a prefix like "2025-08-19T12") goes through QDateTime as before. */
+    const QChar *p = ts.constData();
+    if (ts.size() >= 19 && p[4] == u'-' && p[7] == u'-' && p[10] == u'T' && p[13] == u':' && p[16] == u':') {
+        const int y = digits(p, 4), mo = digits(p + 5, 2), d = digits(p + 8, 2);
+        const int h = digits(p + 11, 2), mi = digits(p + 14, 2), s = digits(p + 17, 2);
+        if (y >= 0 && mo >= 1 && mo <= 12 && d >= 1 && d <= 31 && h >= 0 && h < 24 && mi >= 0 && mi < 60 && s >= 0 && s < 60)
+            return daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+    }
+    return QDateTime::fromString(ts.left(19) + QLatin1Char('Z'), Qt::ISODate).toSecsSinceEpoch();
+}
+
+bool WarningStore::upsertRollups(const RollupSample *samples, int count)
+{/* Rows are folded per (bucket, sensor) in memory first, so a batch of N rows costs one UPSERT per
+    distinct bucket, not N. The UPSERT merges into whatever an earlier insert already left there. */
+    struct Agg { qint64 n = 0; double lo = 0, hi = 0, sum = 0; qint64 lv[4] = {0, 0, 0, 0}; };
+    for (int level = 0; level < int(std::size(kRollupLevels)); ++level) {
+        const RollupLevel &r = kRollupLevels[level];
+        QMap<QPair<qint64, QString>, Agg> buckets;
+        for (int i = 0; i < count; ++i) {
+            const RollupSample &smp = samples[i];
+            Agg &a = buckets[{ smp.secs - smp.secs % r.secs, smp.sensor }];
+            if (a.n == 0) a.lo = a.hi = smp.distance;
+            a.lo = std::min(a.lo, smp.distance);
+            a.hi = std::max(a.hi, smp.distance);
+            a.sum += smp.distance;
+            ++a.n;
+            if (smp.level > 0) ++a.lv[smp.level - 1];
+        }
+        QSqlQuery &up = m_upsert[level];
+        if (up.lastQuery().isEmpty()) {   // not prepared yet on this connection
+            up = QSqlQuery(m_db);
+            if (!up.prepare(QStringLiteral(R"(
+                INSERT INTO %1 (bucket, sensor, n, dmin, dmax, dsum, l1, l2, l3, l4)
+                VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+                ON CONFLICT (bucket, sensor) DO UPDATE SET
+                  n = n + excluded.n, dmin = MIN(dmin, excluded.dmin), dmax = MAX(dmax, excluded.dmax),
+                  dsum = dsum + excluded.dsum, l1 = l1 + excluded.l1, l2 = l2 + excluded.l2,
+                  l3 = l3 + excluded.l3, l4 = l4 + excluded.l4
+            )").arg(QLatin1String(r.table)))) {
+                qWarning() << "Rollup prepare failed:" << up.lastError().text();
+                up = QSqlQuery();
+                return false;
+            }
+        }
+        for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+            const Agg &a = it.value();
+            up.bindValue(0, it.key().first);
+            up.bindValue(1, it.key().second);
+            up.bindValue(2, a.n);
+            up.bindValue(3, a.lo);
+            up.bindValue(4, a.hi);
+            up.bindValue(5, a.sum);
+            up.bindValue(6, a.lv[0]);
+            up.bindValue(7, a.lv[1]);
+            up.bindValue(8, a.lv[2]);
+            up.bindValue(9, a.lv[3]);
+            if (!up.exec()) {
+                qWarning() << "Rollup update failed:" << up.lastError().text();
+                up.finish();
+                return false;
+            }
+        }
+        up.finish();
+    }
+    return true;
+}
+
+bool WarningStore::createRollups()
+{/* A database that has no rollups yet gets them backfilled once from every partition it holds */
+    QSqlQuery q(m_db);
+    for (const RollupLevel &r : kRollupLevels) {
+        q.exec(QStringLiteral("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = '%1'").arg(QLatin1String(r.table)));
+        const bool existed = q.next();
+        q.finish();
+        if (existed) continue;
+        if (!q.exec(QStringLiteral(R"(
+            CREATE TABLE %1 (
+              bucket INTEGER NOT NULL,          -- epoch seconds of the bucket start
+              sensor TEXT    NOT NULL,
+              n      INTEGER NOT NULL,
+              dmin   REAL    NOT NULL,
+              dmax   REAL    NOT NULL,
+              dsum   REAL    NOT NULL,
+              l1 INTEGER NOT NULL, l2 INTEGER NOT NULL, l3 INTEGER NOT NULL, l4 INTEGER NOT NULL,
+              PRIMARY KEY (bucket, sensor)
+            ) WITHOUT ROWID
+        )").arg(QLatin1String(r.table)))) {
+            qWarning() << "Failed to create rollup table:" << q.lastError().text();
+            return false;
+        }
+        QStringList parts;
+        for (const WarningPartition &p : partitions())
+            if (p.archive.isEmpty())
+                parts.append(QStringLiteral("SELECT timestamp, level, distance, sensor FROM %1").arg(p.table));
+        if (parts.isEmpty()) continue;
+        if (!q.exec(QStringLiteral(R"(
+            INSERT INTO %1 (bucket, sensor, n, dmin, dmax, dsum, l1, l2, l3, l4)
+            SELECT (CAST(strftime('%s', substr(timestamp, 1, 19)) AS INTEGER) / %2) * %2, sensor,
+                   COUNT(*), MIN(distance), MAX(distance), SUM(distance),
+                   SUM(level = 'WARNING-1'), SUM(level = 'WARNING-2'), SUM(level = 'WARNING-3'), SUM(level = 'WARNING-4')
+            FROM (%3) GROUP BY 1, 2
+        )").arg(QLatin1String(r.table)).arg(r.secs).arg(parts.join(QStringLiteral(" UNION ALL ")))))
+            qWarning() << "Rollup backfill failed:" << q.lastError().text();
+    }
+    return true;
+}
+
+QVector<RollupPoint> WarningStore::history(qint64 fromSecs, qint64 toSecs, int maxPoints,
+                                           const QString &sensor, int *resolutionSecs) const
+{/* Finest rollup whose bucket count over [from, to) stays within maxPoints (per sensor), the 1 h one
+    when even that is too fine. 30 days at 1 h is 720 rows per sensor, whatever the sample rate was.
+    A level retention has already trimmed past fromSecs is skipped: a short window a few days back
+    comes from rollup_1m rather than from an empty rollup_1s. */
+    const qint64 span = qMax<qint64>(1, toSecs - fromSecs);
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const RollupLevel *level = &kRollupLevels[std::size(kRollupLevels) - 1];
+    for (int i = 0; i < int(std::size(kRollupLevels)); ++i) {
+        const int keepDays = m_rollupKeepDays[i];
+        if (keepDays > 0 && now - qint64(keepDays) * 86400 > fromSecs) continue;
+        if (span / kRollupLevels[i].secs <= qMax(1, maxPoints)) { level = &kRollupLevels[i]; break; }
+    }
+    if (resolutionSecs) *resolutionSecs = level->secs;
+
+    QString sql = QStringLiteral("SELECT bucket, sensor, n, dmin, dmax, dsum, l1, l2, l3, l4 FROM %1 "
+                                 "WHERE bucket >= :from AND bucket < :to").arg(QLatin1String(level->table));
+    if (!sensor.isEmpty()) sql += QStringLiteral(" AND sensor = :sensor");
+    sql += QStringLiteral(" ORDER BY bucket");
+    QSqlQuery q(m_db);
+    q.prepare(sql);
+    q.bindValue(":from", fromSecs - fromSecs % level->secs);
+    q.bindValue(":to", toSecs);
+    if (!sensor.isEmpty()) q.bindValue(":sensor", sensor);
+
+    QVector<RollupPoint> out;
+    if (!q.exec()) return out;
+    while (q.next()) {
+        RollupPoint p;
+        p.bucketSecs = q.value(0).toLongLong();
+        p.sensor     = q.value(1).toString();
+        p.count      = q.value(2).toLongLong();
+        p.min        = q.value(3).toDouble();
+        p.max        = q.value(4).toDouble();
+        p.sum        = q.value(5).toDouble();
+        for (int i = 0; i < 4; ++i) p.levels[i] = q.value(6 + i).toLongLong();
+        out.append(p);
+    }
+    return out;
+}
@@ -0,0 +1,147 @@
+#ifndef WARNINGSTORE_H
+#define WARNINGSTORE_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
+#include <functional>
+
+class QSettings;
+
+struct WarningRow {
+    QString timestamp;
+    QString level;
+    double  distance = 0;
+    double  xn       = 0;
+    QString sensor;      // port the reading came from, "Simulation" for generated values
+    qint64  tsUs     = 0; // sample time in µs, not stored (timestamp keeps whole seconds); 0 when read back
+};
+
+struct RollupPoint {
+    qint64  bucketSecs = 0;   // bucket start, seconds since epoch (UTC)
+    QString sensor;
+    qint64  count = 0;
+    double  min = 0, max = 0, sum = 0;
+    qint64  levels[4] = {0, 0, 0, 0};   // WARNING-1..4
+    double  mean() const { return count ? sum / double(count) : 0.0; }
+};
+
+struct RollupSample {
+    qint64  secs = 0;    // seconds since epoch (UTC)
+    QString sensor;
+    double  distance = 0;
+    int     level = 0;   // WarningClassifier::levelIndex, 0 = none
+};
+
+struct WarningPartition {
+    int     id = 0;
+    QString table;       // warnings_p<id>
+    QString startTs;
+    QString endTs;       // empty while active
+    QString reason;      // why it was closed: "day" or "reset"
+    bool    uploaded = false;
+    QString archive;     // .qaarc file name once moved to the cold archive (the table is gone then)
+};
+
+class WarningStore
+{/* SQLite side of the warnings table: schema, inserts and pragmas. DvClient owns one on the default
+    connection; benchmarks and tools open their own with a distinct connection name.
+
+    Rows live in time partitions (one table per UTC day, plus one per reset) listed in the "partitions"
+    table. "warnings" is a view over the active partition, so the UI model and today's queries are unchanged.
+    Closing a partition is a metadata update, dropping one is a DROP TABLE: neither touches the rows.
+    Filtered reads (time range, levels, sensor) go through WarningQuery, which pages over a covering
+    index every partition table carries.
+
+    Closed partitions older than archive_after_days are moved into compressed columnar files (coldarchive.h);
+    scanPartition()/scanRange() read either form. Nothing on the insert path archives: the owner runs
+    buildArchive() on a thread of its own and commits the result here (DvClient does it on a timer), or
+    calls archiveClosed() to do all of it synchronously.
+
+    Every insert also folds into 1 s / 1 min / 1 h rollup tables (count, min, max, sum, per-level counts
+    per sensor per bucket), which is what history() reads instead of the raw rows. With the raw sample
+    journal enabled the rollups are fed from every sample through addRollupSamples() instead, and the
+    warnings rows are only the derived heartbeat events. */
+public:
+    explicit WarningStore(const QString &connectionName = QLatin1String(QSqlDatabase::defaultConnection));
+    ~WarningStore();
+
+    void configure(QSettings &cfg);   // [storage] group, call before open()
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return m_db.isOpen(); }
+    QSqlDatabase &database() { return m_db; }
+    QString path() const { return m_db.databaseName(); }
+
+    bool setWal(bool enable);
+    bool insert(const WarningRow &row);
+    bool insertBatch(const QVector<WarningRow> &rows);   // the whole batch lands in one partition
+
+    // Partitions
+    bool rotate(const QString &reason, const QString &startTs = QString());
+    QString activeTable() const { return m_active.table; }
+    const WarningPartition &activePartition() const { return m_active; }
+    QString activeStartTs() const { return m_active.startTs; }
+    QVector<WarningPartition> partitions() const;
+    QStringList partitionsFor(const QString &fromTs, const QString &toTs) const;   // empty bound = open
+    QString rangeSource(const QString &fromTs, const QString &toTs, QVariantList &binds) const;
+    QVector<WarningPartition> pendingUploads() const;     // closed and not uploaded yet, oldest first
+    bool markUploaded(const QVector<int> &ids);
+    int  applyRetention();                                // returns the number of partitions dropped
+
+    // Cold archive: closed partitions move to columnar .qaarc files, reads below cover both transparently
+    int  archiveClosed();                                 // returns the number of partitions archived
+    QString archivePath(const QString &fileName) const;   // full path of an archive file named in the catalog
+    QString archiveFileFor(const WarningPartition &p) const { return archivePath(p.table + QStringLiteral(".qaarc")); }
+    QVector<WarningPartition> archiveCandidates() const;  // closed, still in SQLite, older than archive_after_days
+    // Writes and verifies the archive of p on a read-only connection of its own: thread safe, the store untouched
+    static bool buildArchive(const QString &dbPath, const WarningPartition &p, const QString &file, QString *error = nullptr);
+    bool commitArchive(const WarningPartition &p, const QString &file);   // catalog to the file, table dropped
+    bool scanPartition(const WarningPartition &p, const QString &fromTs, const QString &toTs,
+                       const std::function<void(const WarningRow &)> &fn) const;
+    // Rows of one partition in id order from the firstRow-th on (0 based), to read it in fixed-size pieces
+    bool scanPartitionFrom(const WarningPartition &p, qint64 firstRow,
+                           const std::function<void(const WarningRow &)> &fn) const;
+    bool scanRange(const QString &fromTs, const QString &toTs,
+                   const std::function<void(const WarningRow &)> &fn) const;
+
+    // Downsampled history: the finest rollup that gives at most maxPoints buckets per sensor over the range
+    QVector<RollupPoint> history(qint64 fromSecs, qint64 toSecs, int maxPoints,
+                                 const QString &sensor = QString(), int *resolutionSecs = nullptr) const;
+
+    void setRollupsFromInserts(bool on) { m_rollupsFromInserts = on; }
+    bool addRollupSamples(const QVector<RollupSample> &samples);   // one transaction
+
+    static QString nowTs();   // same format as the stored rows
+    static QString tsFromMSecs(qint64 msecs);   // UTC, same format; one allocation, none within the same second
+    static qint64 epochSecs(const QString &ts);
+
+private:
+    bool createSchema();
+    bool createPartition(const QString &startTs);
+    bool pointView();
+    bool createRollups();
+    void resetStatements();
+    bool insertRows(const WarningRow *rows, int count);
+    bool upsertRollups(const RollupSample *samples, int count);
+
+    QString m_connectionName;
+    QSqlDatabase m_db;
+    QSqlQuery m_insert;             // prepared for m_insertTable, kept across inserts
+    QString m_insertTable;
+    QSqlQuery m_upsert[3];          // per rollup level, prepared on first use
+    QVector<RollupSample> m_rollupScratch;
+    WarningPartition m_active;
+    bool m_wal = true;              // set on open(), so readers on other connections (WarningScan) run next to the writer
+    bool m_rotateDaily = true;
+    int  m_retentionDays = 7;       // uploaded day partitions older than this are dropped
+    int  m_retentionMaxDays = 30;   // anything older than this is dropped, uploaded or not
+    int  m_rollupKeepDays[3];       // per rollup level, 0 = forever
+    int  m_archiveAfterDays = 1;    // closed partitions older than this go to the cold archive, -1 = never
+    bool m_rollupsFromInserts = true;
+};
+
+#endif // WARNINGSTORE_H